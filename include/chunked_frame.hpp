@@ -0,0 +1,499 @@
+#pragma once
+
+#include "columnar_file.hpp"
+#include "data_frame.hpp"
+#include "group_by.hpp"
+#include "sort.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace framework {
+
+    namespace detail {
+        using frame_schema = std::vector<std::pair<std::string, data_type>>;
+
+        inline frame_schema schema_of(const data_frame& df) {
+            frame_schema schema;
+            auto names = df.column_names();
+            for (size_t c = 0; c < names.size(); ++c) schema.emplace_back(names[c], df.column_at(c).type());
+            return schema;
+        }
+
+        inline std::shared_ptr<IColumn> make_column(data_type type, const std::string& name, size_t capacity) {
+            auto make = [&]<typename T>() -> std::shared_ptr<IColumn> {
+                auto col = std::make_shared<data_column<T>>(name);
+                col->data.reserve(capacity);
+                return col;
+            };
+            switch (type) {
+            case data_type::int32: return make.template operator()<int>();
+            case data_type::float64: return make.template operator()<double>();
+            case data_type::string: return make.template operator()<std::string>();
+            case data_type::int64: return make.template operator()<std::int64_t>();
+            case data_type::timestamp: return make.template operator()<timestamp>();
+            case data_type::boolean: break;
+            }
+            return make.template operator()<bool>();
+        }
+
+        // String at row without decoding the whole column (dictionary and mapped columns)
+        inline std::string_view string_at(const IColumn& col, size_t row) {
+            if (auto* d = dynamic_cast<const dictionary_column*>(&col)) return d->view(row);
+            if (auto* m = dynamic_cast<const mapped_string_column*>(&col)) return m->view(row);
+            if (auto* s = dynamic_cast<const slice_column<std::string>*>(&col)) return string_at(*s->source(), s->offset() + row);
+            return static_cast<const typed_column<std::string>&>(col).values()[row];
+        }
+
+        // Appends rows of frames with one schema into data_columns reserved up front, so a
+        // batch never reallocates while it fills
+        class frame_builder {
+            frame_schema schema_;
+            size_t capacity_;
+            std::vector<std::shared_ptr<IColumn>> columns_;
+
+            void reset() {
+                columns_.clear();
+                for (const auto& [name, type] : schema_) columns_.push_back(make_column(type, name, capacity_));
+            }
+
+        public:
+            frame_builder(frame_schema schema, size_t capacity) : schema_(std::move(schema)), capacity_(capacity) { reset(); }
+
+            size_t size() const { return columns_.empty() ? 0 : columns_[0]->size(); }
+
+            void append(const data_frame& src, size_t begin, size_t end) {
+                for (size_t c = 0; c < columns_.size(); ++c) {
+                    const IColumn& from = src.column_at(c);
+                    visit_column(*columns_[c], [&](const auto& typed) {
+                        using T = typename std::decay_t<decltype(typed)>::value_type;
+                        auto& out = static_cast<data_column<T>&>(*columns_[c]);
+                        if (from.type() != out.type()) throw std::runtime_error("Schema mismatch");
+                        for (size_t r = begin; r < end; ++r) {
+                            if (from.is_null(r)) out.push_null();
+                            else if constexpr (std::is_same_v<T, bool>) out.push_valid(std::get<bool>(from.get(r)));
+                            else if constexpr (std::is_same_v<T, std::string>) out.push_valid(std::string(string_at(from, r)));
+                            else out.push_valid(static_cast<const typed_column<T>&>(from).values()[r]);
+                        }
+                    });
+                }
+            }
+
+            void append_row(const std::vector<data_value>& row) {
+                if (row.size() != columns_.size()) throw std::runtime_error("Row size mismatch");
+                for (size_t c = 0; c < row.size(); ++c) columns_[c]->push_back(row[c]);
+            }
+
+            data_frame take() {
+                data_frame out;
+                for (size_t c = 0; c < columns_.size(); ++c) out.add_column(schema_[c].first, std::move(columns_[c]));
+                reset();
+                return out;
+            }
+        };
+
+        // Spilled batch files, removed when the last frame using them goes away
+        struct spill_files {
+            std::filesystem::path dir;
+            std::vector<std::filesystem::path> files;
+
+            std::filesystem::path next() {
+                static std::atomic<std::uint64_t> counter{ 0 };
+                return files.emplace_back(dir / ("spill-" + std::to_string(counter.fetch_add(1)) + ".fwc"));
+            }
+
+            ~spill_files() {
+                std::error_code ec;
+                for (const auto& f : files) std::filesystem::remove(f, ec);
+            }
+        };
+
+        // Order word of an int64 or timestamp value
+        inline std::uint64_t int64_bits(const IColumn& col, size_t row) {
+            if (col.type() == data_type::timestamp) return order_bits(static_cast<const typed_column<timestamp>&>(col).values()[row]);
+            return order_bits(static_cast<const typed_column<std::int64_t>&>(col).values()[row]);
+        }
+
+        inline std::uint64_t key_hash(const data_frame& df, const std::vector<size_t>& keys, size_t row) {
+            std::uint64_t h = 0;
+            for (size_t k : keys) {
+                const IColumn& col = df.column_at(k);
+                std::uint64_t v = 0x6e756c6c;
+                if (!col.is_null(row)) {
+                    switch (col.type()) {
+                    case data_type::int32: v = std::hash<int>{}(static_cast<const typed_column<int>&>(col).values()[row]); break;
+                    case data_type::float64: v = std::hash<double>{}(static_cast<const typed_column<double>&>(col).values()[row]); break;
+                    case data_type::string: v = std::hash<std::string_view>{}(string_at(col, row)); break;
+                    case data_type::boolean: v = std::get<bool>(col.get(row)); break;
+                    case data_type::int64:
+                    case data_type::timestamp: v = std::hash<std::uint64_t>{}(int64_bits(col, row)); break;
+                    }
+                }
+                h = (h ^ v) * 0x9e3779b97f4a7c15ull;
+            }
+            return h ^ (h >> 29);
+        }
+
+        // Compares rows of different frames with one schema by sort keys, ordering like
+        // data_frame::sort_by()
+        inline int compare_rows(const data_frame& a, size_t ra, const data_frame& b, size_t rb,
+            const std::vector<std::pair<size_t, bool>>& keys) {
+            for (auto [k, descending] : keys) {
+                const IColumn &ca = a.column_at(k), &cb = b.column_at(k);
+                bool na = ca.is_null(ra), nb = cb.is_null(rb);
+                if (na || nb) {
+                    if (na != nb) return na ? 1 : -1;
+                    continue;
+                }
+                int c = 0;
+                switch (ca.type()) {
+                case data_type::int32: {
+                    int x = static_cast<const typed_column<int>&>(ca).values()[ra], y = static_cast<const typed_column<int>&>(cb).values()[rb];
+                    c = x < y ? -1 : x > y;
+                    break;
+                }
+                case data_type::float64: {
+                    auto x = order_bits(static_cast<const typed_column<double>&>(ca).values()[ra]);
+                    auto y = order_bits(static_cast<const typed_column<double>&>(cb).values()[rb]);
+                    c = x < y ? -1 : x > y;
+                    break;
+                }
+                case data_type::string: c = string_at(ca, ra).compare(string_at(cb, rb)); break;
+                case data_type::boolean: c = int(std::get<bool>(ca.get(ra))) - int(std::get<bool>(cb.get(rb))); break;
+                case data_type::int64:
+                case data_type::timestamp: {
+                    auto x = int64_bits(ca, ra), y = int64_bits(cb, rb);
+                    c = x < y ? -1 : x > y;
+                    break;
+                }
+                }
+                if (c) return descending ? -c : c;
+            }
+            return 0;
+        }
+
+        inline std::shared_ptr<IColumn> to_double(const IColumn& col, const std::string& name) {
+            auto out = std::make_shared<data_column<double>>(name);
+            auto values = static_cast<const typed_column<int>&>(col).values();
+            for (size_t r = 0; r < values.size(); ++r) {
+                if (col.is_null(r)) out->push_null();
+                else out->push_valid(values[r]);
+            }
+            return out;
+        }
+    }
+
+    // A frame kept as a list of record batches of at most batch_rows rows each. Appending
+    // never moves existing rows: append() adds slices of the given frame and append_row()
+    // fills a batch reserved to batch_rows. Iterating yields one batch (a data_frame) at a
+    // time. With a spill directory every sealed batch is written there as a columnar file
+    // and served from its mapping, so resident memory is one open batch plus whatever the
+    // OS keeps cached; sort_by() and group_by() spill their intermediate data there too.
+    class chunked_frame {
+        size_t batch_rows_;
+        std::shared_ptr<detail::spill_files> spill_;
+        detail::frame_schema schema_;
+        std::vector<data_frame> batches_;
+        std::unique_ptr<detail::frame_builder> open_; // batch being filled by append_row
+
+        void seal(data_frame batch) {
+            if (batch.rowCount() == 0) return;
+            if (spill_) {
+                auto path = spill_->next();
+                batch.save(path);
+                batch = data_frame::open_mmap(path);
+            }
+            batches_.push_back(std::move(batch));
+        }
+
+        void seal_open() {
+            if (open_ && open_->size()) seal(open_->take());
+        }
+
+        detail::frame_builder& open_batch() {
+            if (!open_) open_ = std::make_unique<detail::frame_builder>(schema_, batch_rows_);
+            return *open_;
+        }
+
+        void check_schema(const data_frame& df) {
+            auto schema = detail::schema_of(df);
+            if (schema_.empty()) schema_ = std::move(schema);
+            else if (schema != schema_) throw std::runtime_error("Schema mismatch");
+        }
+
+        // Same batch size, spill directory and schema, no rows
+        chunked_frame empty_like() const {
+            chunked_frame out(batch_rows_, spill_ ? spill_->dir : std::filesystem::path{});
+            out.schema_ = schema_;
+            return out;
+        }
+
+    public:
+        // Partitions group_by() hashes its partial results into when spilling
+        static constexpr size_t spill_partitions = 64;
+
+        explicit chunked_frame(size_t batch_rows = 65536, std::filesystem::path spill_dir = {}) : batch_rows_(batch_rows) {
+            if (batch_rows_ == 0) throw std::runtime_error("batch_rows must be positive");
+            if (!spill_dir.empty()) {
+                spill_ = std::make_shared<detail::spill_files>();
+                spill_->dir = std::move(spill_dir);
+            }
+        }
+
+        chunked_frame(chunked_frame&&) noexcept = default;
+        chunked_frame& operator=(chunked_frame&&) noexcept = default;
+
+        // Batches sharing df's column buffers (see data_frame::slice)
+        static chunked_frame from(const data_frame& df, size_t batch_rows = 65536) {
+            chunked_frame out(batch_rows);
+            out.append(df);
+            return out;
+        }
+
+        template<typename T>
+        void addColumn(const std::string& name) {
+            if (rowCount()) throw std::runtime_error("Columns must be added before rows");
+            for (const auto& [n, type] : schema_)
+                if (n == name) throw std::runtime_error("Column exists");
+            schema_.emplace_back(name, data_type_of<T>::value);
+            open_.reset();
+        }
+
+        // A frame of at least batch_rows rows is added as slices of it; smaller ones are
+        // copied into the open batch so that many small appends do not make small batches
+        void append(const data_frame& df) {
+            check_schema(df);
+            const size_t rows = df.rowCount();
+            if (rows >= batch_rows_) {
+                seal_open();
+                for (size_t offset = 0; offset < rows; offset += batch_rows_) seal(df.slice(offset, batch_rows_));
+                return;
+            }
+            for (size_t offset = 0; offset < rows;) {
+                auto& open = open_batch();
+                size_t n = std::min(rows - offset, batch_rows_ - open.size());
+                open.append(df, offset, offset + n);
+                offset += n;
+                if (open.size() == batch_rows_) seal(open.take());
+            }
+        }
+
+        void append_row(const std::vector<data_value>& row) {
+            if (schema_.empty()) throw std::runtime_error("Row size mismatch");
+            auto& open = open_batch();
+            open.append_row(row);
+            if (open.size() == batch_rows_) seal(open.take());
+        }
+
+        // Seals the batch being filled by small appends; to_frame() and the operators do it first
+        void flush() { seal_open(); }
+
+        size_t batch_rows() const { return batch_rows_; }
+        size_t batch_count() const { return batches_.size(); }
+        const data_frame& batch(size_t i) const { return batches_.at(i); }
+        auto begin() const { return batches_.begin(); }
+        auto end() const { return batches_.end(); }
+
+        size_t rowCount() const {
+            size_t rows = open_ ? open_->size() : 0;
+            for (const auto& b : batches_) rows += b.rowCount();
+            return rows;
+        }
+
+        std::vector<std::string> column_names() const {
+            std::vector<std::string> names;
+            for (const auto& [name, type] : schema_) names.push_back(name);
+            return names;
+        }
+
+        // Every batch copied into one frame
+        data_frame to_frame() {
+            flush();
+            detail::frame_builder out(schema_, rowCount());
+            for (const auto& b : batches_) out.append(b, 0, b.rowCount());
+            return out.take();
+        }
+
+        // External merge sort: each batch is sorted into a run (spilled when spilling), then
+        // the runs are merged k-way into a new chunked_frame with the same batch size and
+        // spill directory. Stable, and ordered exactly like data_frame::sort_by().
+        chunked_frame sort_by(const std::vector<sort_key>& keys, thread_pool* pool = nullptr) {
+            flush();
+            chunked_frame runs = empty_like(), out = empty_like();
+            for (const auto& b : batches_) runs.seal(b.sort_by(keys, pool));
+            if (runs.batches_.empty()) return out;
+
+            std::vector<std::pair<size_t, bool>> key_index;
+            const auto& first = runs.batches_.front();
+            for (const auto& k : keys) key_index.emplace_back(first.column_position(k.column), k.order == desc);
+
+            // Heap of (run, row) cursors; ties go to the earlier run to keep the sort stable
+            const auto& r = runs.batches_;
+            std::vector<size_t> pos(r.size(), 0);
+            auto after = [&](size_t a, size_t b) {
+                int c = detail::compare_rows(r[a], pos[a], r[b], pos[b], key_index);
+                return c ? c > 0 : a > b;
+            };
+            std::priority_queue<size_t, std::vector<size_t>, decltype(after)> heap(after);
+            for (size_t i = 0; i < r.size(); ++i) heap.push(i);
+
+            detail::frame_builder batch(schema_, batch_rows_);
+            while (!heap.empty()) {
+                size_t run = heap.top();
+                heap.pop();
+                // Copy the run's rows up to the next cursor's row, or to the batch's end
+                size_t begin = pos[run], end = begin + 1, limit = std::min(r[run].rowCount(), begin + batch_rows_ - batch.size());
+                if (!heap.empty())
+                    for (size_t other = heap.top(); end < limit; ++end) {
+                        int c = detail::compare_rows(r[run], end, r[other], pos[other], key_index);
+                        if (c > 0 || (c == 0 && run > other)) break;
+                    }
+                else end = limit;
+                batch.append(r[run], begin, end);
+                pos[run] = end;
+                if (end < r[run].rowCount()) heap.push(run);
+                if (batch.size() == batch_rows_) out.seal(batch.take());
+            }
+            out.seal(batch.take());
+            return out;
+        }
+
+        // Hash aggregation one batch at a time: each batch is aggregated into partial results
+        // (sums, counts, mins, maxes) that are combined at the end. Without spilling, groups
+        // come out in order of first appearance, like data_frame::group_by(). With spilling,
+        // partials are hash-partitioned to disk first and each partition is combined on its
+        // own, so memory holds one partition's groups; groups then come out partition by
+        // partition.
+        data_frame group_by(const std::vector<std::string>& keys, const std::vector<aggregate>& specs, thread_pool* pool = nullptr) {
+            flush();
+            // Partial and combining aggregates; a mean is kept as a sum and a count of values
+            std::vector<aggregate> partial, combine;
+            std::vector<std::vector<std::string>> parts(specs.size());
+            for (size_t i = 0; i < specs.size(); ++i) {
+                auto add = [&](aggregate a, aggregate_kind combined) {
+                    auto name = "__part" + std::to_string(partial.size());
+                    parts[i].push_back(name);
+                    partial.push_back(a.as(name));
+                    combine.push_back(aggregate{ combined, name, name, 0 });
+                };
+                const auto& s = specs[i];
+                switch (s.kind) {
+                case aggregate_kind::sum: add(s, aggregate_kind::sum); break;
+                case aggregate_kind::min: add(s, aggregate_kind::min); break;
+                case aggregate_kind::max: add(s, aggregate_kind::max); break;
+                case aggregate_kind::count: add(s, aggregate_kind::sum); break;
+                case aggregate_kind::mean:
+                    add(sum(s.column), aggregate_kind::sum);
+                    add(count(s.column), aggregate_kind::sum);
+                    break;
+                case aggregate_kind::approx_count_distinct:
+                case aggregate_kind::approx_quantile:
+                    throw std::runtime_error("Approximate aggregates are not supported on chunked frames: " + s.output_name());
+                }
+            }
+
+            // Counts are summed into float64 when combining, so partials hold them as float64
+            auto partial_of = [&](const data_frame& batch) {
+                auto p = batch.group_by(keys).agg(partial, pool);
+                data_frame out = p.select(keys);
+                for (size_t j = 0; j < partial.size(); ++j) {
+                    auto col = p.column_ptr(keys.size() + j);
+                    if (partial[j].kind == aggregate_kind::count) col = detail::to_double(*col, partial[j].alias);
+                    out.add_column(partial[j].alias, std::move(col));
+                }
+                return out;
+            };
+            auto combine_all = [&](chunked_frame& partials) {
+                auto all = partials.to_frame();
+                return all.rowCount() ? all.group_by(keys).agg(combine, pool) : all;
+            };
+            auto finish = [&](const data_frame& combined) {
+                data_frame out = combined.select(keys);
+                for (size_t i = 0; i < specs.size(); ++i) {
+                    auto name = specs[i].output_name();
+                    auto values = combined.column_ptr(combined.column_position(parts[i][0]));
+                    if (specs[i].kind == aggregate_kind::mean) {
+                        auto sums = combined.column<double>(parts[i][0]), counts = combined.column<double>(parts[i][1]);
+                        auto col = std::make_shared<data_column<double>>(name);
+                        for (size_t g = 0; g < sums.size(); ++g) {
+                            if (counts[g] == 0) col->push_null();
+                            else col->push_valid(sums[g] / counts[g]);
+                        }
+                        values = col;
+                    }
+                    else if (specs[i].kind == aggregate_kind::count) {
+                        auto col = std::make_shared<data_column<int>>(name);
+                        for (double n : combined.column<double>(parts[i][0])) col->push_valid(static_cast<int>(n));
+                        values = col;
+                    }
+                    out.add_column(name, std::move(values));
+                }
+                return out;
+            };
+            // Empty partial frames fix the partials' schema even when there are no rows
+            auto new_partials = [&](std::filesystem::path dir) {
+                chunked_frame p(batch_rows_, std::move(dir));
+                p.append(partial_of(empty_batch()));
+                return p;
+            };
+
+            if (!spill_) {
+                auto partials = new_partials({});
+                for (const auto& b : batches_) {
+                    partials.append(partial_of(b));
+                    if (partials.rowCount() > 4 * batch_rows_) {
+                        auto combined = combine_all(partials);
+                        partials = new_partials({});
+                        partials.append(combined);
+                    }
+                }
+                return finish(combine_all(partials));
+            }
+
+            std::vector<chunked_frame> partitions;
+            for (size_t i = 0; i < spill_partitions; ++i) partitions.push_back(new_partials(spill_->dir));
+            std::vector<size_t> key_index(keys.size());
+            std::iota(key_index.begin(), key_index.end(), size_t{ 0 });
+            for (const auto& b : batches_) {
+                auto p = partial_of(b);
+                std::vector<std::vector<size_t>> rows(spill_partitions);
+                for (size_t r = 0; r < p.rowCount(); ++r) rows[detail::key_hash(p, key_index, r) % spill_partitions].push_back(r);
+                auto names = p.column_names();
+                for (size_t i = 0; i < spill_partitions; ++i) {
+                    if (rows[i].empty()) continue;
+                    data_frame part;
+                    for (size_t c = 0; c < names.size(); ++c) part.add_column(names[c], p.column_at(c).gather(rows[i]));
+                    partitions[i].append(part);
+                }
+            }
+
+            std::optional<detail::frame_builder> out;
+            for (auto& part : partitions) {
+                auto done = finish(combine_all(part));
+                if (!out) out.emplace(detail::schema_of(done), 0);
+                out->append(done, 0, done.rowCount());
+            }
+            return out->take();
+        }
+
+    private:
+        data_frame empty_batch() const {
+            data_frame out;
+            for (const auto& [name, type] : schema_) out.add_column(name, detail::make_column(type, name, 0));
+            return out;
+        }
+    };
+
+} // namespace framework
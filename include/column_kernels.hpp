@@ -0,0 +1,630 @@
+#pragma once
+
+#include "simd.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+// Aggregation and predicate kernels over contiguous column values. Aggregations optionally
+// take an Arrow-style validity bitmap (bit i of word i / 64, LSB first, 1 = valid); the
+// bitmap is decomposed into runs of valid rows so all-null words are skipped 64 rows at a
+// time and fully valid stretches go through the dense SIMD loops unchanged. Comparisons
+// produce bitmasks in the same layout, so a filter result can be fed straight back in.
+namespace framework::kernels {
+
+    namespace detail {
+
+        template<typename T>
+        using sum_t = std::conditional_t<std::is_floating_point_v<T>, double, std::int64_t>;
+
+        // ---- scalar ----
+
+        inline double sum_f64_scalar(const double* p, std::size_t n) {
+            double a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+            std::size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                a0 += p[i]; a1 += p[i + 1]; a2 += p[i + 2]; a3 += p[i + 3];
+            }
+            for (; i < n; ++i) a0 += p[i];
+            return (a0 + a1) + (a2 + a3);
+        }
+
+        inline double min_f64_scalar(const double* p, std::size_t n) {
+            double m = p[0];
+            for (std::size_t i = 1; i < n; ++i) m = p[i] < m ? p[i] : m;
+            return m;
+        }
+
+        inline double max_f64_scalar(const double* p, std::size_t n) {
+            double m = p[0];
+            for (std::size_t i = 1; i < n; ++i) m = p[i] > m ? p[i] : m;
+            return m;
+        }
+
+        inline double sqdev_f64_scalar(const double* p, std::size_t n, double mean) {
+            double a0 = 0, a1 = 0;
+            std::size_t i = 0;
+            for (; i + 2 <= n; i += 2) {
+                double d0 = p[i] - mean, d1 = p[i + 1] - mean;
+                a0 += d0 * d0; a1 += d1 * d1;
+            }
+            for (; i < n; ++i) a0 += (p[i] - mean) * (p[i] - mean);
+            return a0 + a1;
+        }
+
+        inline std::int64_t sum_i32_scalar(const int* p, std::size_t n) {
+            std::int64_t s = 0;
+            for (std::size_t i = 0; i < n; ++i) s += p[i];
+            return s;
+        }
+
+        inline int min_i32_scalar(const int* p, std::size_t n) {
+            int m = p[0];
+            for (std::size_t i = 1; i < n; ++i) m = p[i] < m ? p[i] : m;
+            return m;
+        }
+
+        inline int max_i32_scalar(const int* p, std::size_t n) {
+            int m = p[0];
+            for (std::size_t i = 1; i < n; ++i) m = p[i] > m ? p[i] : m;
+            return m;
+        }
+
+#ifdef FRAMEWORK_SIMD_X86
+        // ---- SSE2 ----
+
+        FRAMEWORK_TARGET_SSE2 inline double hsum_sse2(__m128d v) {
+            return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+        }
+
+        FRAMEWORK_TARGET_SSE2 inline double sum_f64_sse2(const double* p, std::size_t n) {
+            __m128d a0 = _mm_setzero_pd(), a1 = _mm_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                a0 = _mm_add_pd(a0, _mm_loadu_pd(p + i));
+                a1 = _mm_add_pd(a1, _mm_loadu_pd(p + i + 2));
+            }
+            double s = hsum_sse2(_mm_add_pd(a0, a1));
+            for (; i < n; ++i) s += p[i];
+            return s;
+        }
+
+        FRAMEWORK_TARGET_SSE2 inline double min_f64_sse2(const double* p, std::size_t n) {
+            if (n < 2) return p[0];
+            __m128d m = _mm_loadu_pd(p);
+            std::size_t i = 2;
+            for (; i + 2 <= n; i += 2) m = _mm_min_pd(m, _mm_loadu_pd(p + i));
+            m = _mm_min_sd(m, _mm_unpackhi_pd(m, m));
+            double r = _mm_cvtsd_f64(m);
+            for (; i < n; ++i) r = p[i] < r ? p[i] : r;
+            return r;
+        }
+
+        FRAMEWORK_TARGET_SSE2 inline double max_f64_sse2(const double* p, std::size_t n) {
+            if (n < 2) return p[0];
+            __m128d m = _mm_loadu_pd(p);
+            std::size_t i = 2;
+            for (; i + 2 <= n; i += 2) m = _mm_max_pd(m, _mm_loadu_pd(p + i));
+            m = _mm_max_sd(m, _mm_unpackhi_pd(m, m));
+            double r = _mm_cvtsd_f64(m);
+            for (; i < n; ++i) r = p[i] > r ? p[i] : r;
+            return r;
+        }
+
+        FRAMEWORK_TARGET_SSE2 inline double sqdev_f64_sse2(const double* p, std::size_t n, double mean) {
+            const __m128d mu = _mm_set1_pd(mean);
+            __m128d a0 = _mm_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 2 <= n; i += 2) {
+                __m128d d = _mm_sub_pd(_mm_loadu_pd(p + i), mu);
+                a0 = _mm_add_pd(a0, _mm_mul_pd(d, d));
+            }
+            double s = hsum_sse2(a0);
+            for (; i < n; ++i) s += (p[i] - mean) * (p[i] - mean);
+            return s;
+        }
+
+        FRAMEWORK_TARGET_SSE2 inline std::int64_t sum_i32_sse2(const int* p, std::size_t n) {
+            __m128i acc = _mm_setzero_si128();
+            std::size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                __m128i sign = _mm_srai_epi32(v, 31);
+                acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, sign));
+                acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, sign));
+            }
+            alignas(16) std::int64_t lanes[2];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+            std::int64_t s = lanes[0] + lanes[1];
+            for (; i < n; ++i) s += p[i];
+            return s;
+        }
+
+        // SSE2 has no packed 32-bit min/max; blend on a compare mask instead
+        FRAMEWORK_TARGET_SSE2 inline int min_i32_sse2(const int* p, std::size_t n) {
+            if (n < 4) return min_i32_scalar(p, n);
+            __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            std::size_t i = 4;
+            for (; i + 4 <= n; i += 4) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                __m128i lt = _mm_cmplt_epi32(v, m);
+                m = _mm_or_si128(_mm_and_si128(lt, v), _mm_andnot_si128(lt, m));
+            }
+            alignas(16) int lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), m);
+            int r = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+            for (; i < n; ++i) r = p[i] < r ? p[i] : r;
+            return r;
+        }
+
+        FRAMEWORK_TARGET_SSE2 inline int max_i32_sse2(const int* p, std::size_t n) {
+            if (n < 4) return max_i32_scalar(p, n);
+            __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            std::size_t i = 4;
+            for (; i + 4 <= n; i += 4) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                __m128i gt = _mm_cmpgt_epi32(v, m);
+                m = _mm_or_si128(_mm_and_si128(gt, v), _mm_andnot_si128(gt, m));
+            }
+            alignas(16) int lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), m);
+            int r = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+            for (; i < n; ++i) r = p[i] > r ? p[i] : r;
+            return r;
+        }
+
+        // ---- AVX2 ----
+
+        FRAMEWORK_TARGET_AVX2 inline double hsum_avx2(__m256d v) {
+            __m128d lo = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+            return _mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo)));
+        }
+
+        FRAMEWORK_TARGET_AVX2 inline double sum_f64_avx2(const double* p, std::size_t n) {
+            __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+            __m256d a2 = _mm256_setzero_pd(), a3 = _mm256_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 16 <= n; i += 16) {
+                a0 = _mm256_add_pd(a0, _mm256_loadu_pd(p + i));
+                a1 = _mm256_add_pd(a1, _mm256_loadu_pd(p + i + 4));
+                a2 = _mm256_add_pd(a2, _mm256_loadu_pd(p + i + 8));
+                a3 = _mm256_add_pd(a3, _mm256_loadu_pd(p + i + 12));
+            }
+            for (; i + 4 <= n; i += 4) a0 = _mm256_add_pd(a0, _mm256_loadu_pd(p + i));
+            double s = hsum_avx2(_mm256_add_pd(_mm256_add_pd(a0, a1), _mm256_add_pd(a2, a3)));
+            for (; i < n; ++i) s += p[i];
+            return s;
+        }
+
+        FRAMEWORK_TARGET_AVX2 inline double min_f64_avx2(const double* p, std::size_t n) {
+            if (n < 4) return min_f64_scalar(p, n);
+            __m256d m0 = _mm256_loadu_pd(p), m1 = m0;
+            std::size_t i = 4;
+            for (; i + 8 <= n; i += 8) {
+                m0 = _mm256_min_pd(m0, _mm256_loadu_pd(p + i));
+                m1 = _mm256_min_pd(m1, _mm256_loadu_pd(p + i + 4));
+            }
+            for (; i + 4 <= n; i += 4) m0 = _mm256_min_pd(m0, _mm256_loadu_pd(p + i));
+            alignas(32) double lanes[4];
+            _mm256_store_pd(lanes, _mm256_min_pd(m0, m1));
+            double r = std::min(std::min(lanes[0], lanes[1]), std::min(lanes[2], lanes[3]));
+            for (; i < n; ++i) r = p[i] < r ? p[i] : r;
+            return r;
+        }
+
+        FRAMEWORK_TARGET_AVX2 inline double max_f64_avx2(const double* p, std::size_t n) {
+            if (n < 4) return max_f64_scalar(p, n);
+            __m256d m0 = _mm256_loadu_pd(p), m1 = m0;
+            std::size_t i = 4;
+            for (; i + 8 <= n; i += 8) {
+                m0 = _mm256_max_pd(m0, _mm256_loadu_pd(p + i));
+                m1 = _mm256_max_pd(m1, _mm256_loadu_pd(p + i + 4));
+            }
+            for (; i + 4 <= n; i += 4) m0 = _mm256_max_pd(m0, _mm256_loadu_pd(p + i));
+            alignas(32) double lanes[4];
+            _mm256_store_pd(lanes, _mm256_max_pd(m0, m1));
+            double r = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+            for (; i < n; ++i) r = p[i] > r ? p[i] : r;
+            return r;
+        }
+
+        FRAMEWORK_TARGET_AVX2 inline double sqdev_f64_avx2(const double* p, std::size_t n, double mean) {
+            const __m256d mu = _mm256_set1_pd(mean);
+            __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+            std::size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(p + i), mu);
+                __m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(p + i + 4), mu);
+                a0 = _mm256_add_pd(a0, _mm256_mul_pd(d0, d0));
+                a1 = _mm256_add_pd(a1, _mm256_mul_pd(d1, d1));
+            }
+            double s = hsum_avx2(_mm256_add_pd(a0, a1));
+            for (; i < n; ++i) s += (p[i] - mean) * (p[i] - mean);
+            return s;
+        }
+
+        FRAMEWORK_TARGET_AVX2 inline std::int64_t sum_i32_avx2(const int* p, std::size_t n) {
+            __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+            std::size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                a0 = _mm256_add_epi64(a0, _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i))));
+                a1 = _mm256_add_epi64(a1, _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 4))));
+            }
+            alignas(32) std::int64_t lanes[4];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(a0, a1));
+            std::int64_t s = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            for (; i < n; ++i) s += p[i];
+            return s;
+        }
+
+        FRAMEWORK_TARGET_AVX2 inline int min_i32_avx2(const int* p, std::size_t n) {
+            if (n < 8) return min_i32_scalar(p, n);
+            __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            std::size_t i = 8;
+            for (; i + 8 <= n; i += 8) m = _mm256_min_epi32(m, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)));
+            alignas(32) int lanes[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), m);
+            int r = *std::min_element(lanes, lanes + 8);
+            for (; i < n; ++i) r = p[i] < r ? p[i] : r;
+            return r;
+        }
+
+        FRAMEWORK_TARGET_AVX2 inline int max_i32_avx2(const int* p, std::size_t n) {
+            if (n < 8) return max_i32_scalar(p, n);
+            __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            std::size_t i = 8;
+            for (; i + 8 <= n; i += 8) m = _mm256_max_epi32(m, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)));
+            alignas(32) int lanes[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), m);
+            int r = *std::max_element(lanes, lanes + 8);
+            for (; i < n; ++i) r = p[i] > r ? p[i] : r;
+            return r;
+        }
+#endif
+
+        // ---- dispatch; other arithmetic types use plain loops ----
+
+        template<typename T>
+        sum_t<T> dense_sum(const T* p, std::size_t n) {
+            if constexpr (std::is_same_v<T, double>)
+                return simd::select<double(*)(const double*, std::size_t)>(FRAMEWORK_SIMD_VARIANTS(sum_f64))(p, n);
+            else if constexpr (std::is_same_v<T, int>)
+                return simd::select<std::int64_t(*)(const int*, std::size_t)>(FRAMEWORK_SIMD_VARIANTS(sum_i32))(p, n);
+            else {
+                sum_t<T> s{};
+                for (std::size_t i = 0; i < n; ++i) s += static_cast<sum_t<T>>(p[i]);
+                return s;
+            }
+        }
+
+        // Precondition: n > 0
+        template<typename T>
+        T dense_min(const T* p, std::size_t n) {
+            if constexpr (std::is_same_v<T, double>)
+                return simd::select<double(*)(const double*, std::size_t)>(FRAMEWORK_SIMD_VARIANTS(min_f64))(p, n);
+            else if constexpr (std::is_same_v<T, int>)
+                return simd::select<int(*)(const int*, std::size_t)>(FRAMEWORK_SIMD_VARIANTS(min_i32))(p, n);
+            else
+                return *std::min_element(p, p + n);
+        }
+
+        template<typename T>
+        T dense_max(const T* p, std::size_t n) {
+            if constexpr (std::is_same_v<T, double>)
+                return simd::select<double(*)(const double*, std::size_t)>(FRAMEWORK_SIMD_VARIANTS(max_f64))(p, n);
+            else if constexpr (std::is_same_v<T, int>)
+                return simd::select<int(*)(const int*, std::size_t)>(FRAMEWORK_SIMD_VARIANTS(max_i32))(p, n);
+            else
+                return *std::max_element(p, p + n);
+        }
+
+        template<typename T>
+        double dense_sqdev(const T* p, std::size_t n, double mean) {
+            if constexpr (std::is_same_v<T, double>)
+                return simd::select<double(*)(const double*, std::size_t, double)>(FRAMEWORK_SIMD_VARIANTS(sqdev_f64))(p, n, mean);
+            else {
+                double s = 0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    double d = static_cast<double>(p[i]) - mean;
+                    s += d * d;
+                }
+                return s;
+            }
+        }
+
+        // ---- comparisons into bitmasks ----
+
+        template<typename Op> struct compare_traits;
+        template<> struct compare_traits<std::equal_to<>> { static constexpr int avx_pred = 0x00; };      // _CMP_EQ_OQ
+        template<> struct compare_traits<std::not_equal_to<>> { static constexpr int avx_pred = 0x04; };  // _CMP_NEQ_UQ
+        template<> struct compare_traits<std::less<>> { static constexpr int avx_pred = 0x11; };          // _CMP_LT_OQ
+        template<> struct compare_traits<std::less_equal<>> { static constexpr int avx_pred = 0x12; };    // _CMP_LE_OQ
+        template<> struct compare_traits<std::greater<>> { static constexpr int avx_pred = 0x1e; };       // _CMP_GT_OQ
+        template<> struct compare_traits<std::greater_equal<>> { static constexpr int avx_pred = 0x1d; }; // _CMP_GE_OQ
+
+        template<typename Cmp, typename T, typename U>
+        void compare_tail(const T* p, std::size_t begin, std::size_t n, const U& rhs, std::uint64_t* out) {
+            Cmp cmp;
+            for (std::size_t base = begin; base < n; base += 64) {
+                const std::size_t limit = std::min<std::size_t>(64, n - base);
+                std::uint64_t bits = 0;
+                for (std::size_t j = 0; j < limit; ++j) bits |= static_cast<std::uint64_t>(cmp(p[base + j], rhs)) << j;
+                out[base / 64] = bits;
+            }
+        }
+
+        template<typename Cmp>
+        void compare_f64_scalar(const double* p, std::size_t n, double rhs, std::uint64_t* out) {
+            compare_tail<Cmp>(p, 0, n, rhs, out);
+        }
+
+        template<typename Cmp>
+        void compare_i32_scalar(const int* p, std::size_t n, int rhs, std::uint64_t* out) {
+            compare_tail<Cmp>(p, 0, n, rhs, out);
+        }
+
+#ifdef FRAMEWORK_SIMD_X86
+        template<typename Cmp>
+        FRAMEWORK_TARGET_AVX2 void compare_f64_avx2(const double* p, std::size_t n, double rhs, std::uint64_t* out) {
+            const __m256d c = _mm256_set1_pd(rhs);
+            std::size_t base = 0;
+            for (; base + 64 <= n; base += 64) {
+                std::uint64_t bits = 0;
+                for (std::size_t j = 0; j < 64; j += 4) {
+                    __m256d m = _mm256_cmp_pd(_mm256_loadu_pd(p + base + j), c, compare_traits<Cmp>::avx_pred);
+                    bits |= static_cast<std::uint64_t>(_mm256_movemask_pd(m)) << j;
+                }
+                out[base / 64] = bits;
+            }
+            compare_tail<Cmp>(p, base, n, rhs, out);
+        }
+
+        template<typename Cmp>
+        FRAMEWORK_TARGET_AVX2 void compare_i32_avx2(const int* p, std::size_t n, int rhs, std::uint64_t* out) {
+            const __m256i c = _mm256_set1_epi32(rhs);
+            const __m256i ones = _mm256_set1_epi32(-1);
+            std::size_t base = 0;
+            for (; base + 64 <= n; base += 64) {
+                std::uint64_t bits = 0;
+                for (std::size_t j = 0; j < 64; j += 8) {
+                    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + base + j));
+                    __m256i r;
+                    if constexpr (std::is_same_v<Cmp, std::equal_to<>>) r = _mm256_cmpeq_epi32(v, c);
+                    else if constexpr (std::is_same_v<Cmp, std::not_equal_to<>>) r = _mm256_xor_si256(_mm256_cmpeq_epi32(v, c), ones);
+                    else if constexpr (std::is_same_v<Cmp, std::less<>>) r = _mm256_cmpgt_epi32(c, v);
+                    else if constexpr (std::is_same_v<Cmp, std::less_equal<>>) r = _mm256_xor_si256(_mm256_cmpgt_epi32(v, c), ones);
+                    else if constexpr (std::is_same_v<Cmp, std::greater<>>) r = _mm256_cmpgt_epi32(v, c);
+                    else r = _mm256_xor_si256(_mm256_cmpgt_epi32(c, v), ones);
+                    bits |= static_cast<std::uint64_t>(static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(r)))) << j;
+                }
+                out[base / 64] = bits;
+            }
+            compare_tail<Cmp>(p, base, n, rhs, out);
+        }
+#endif
+
+        template<typename Cmp, typename T, typename U>
+        void compare_with(std::span<const T> values, const U& rhs, std::uint64_t* out) {
+            if constexpr (std::is_same_v<T, double> && std::is_arithmetic_v<U>) {
+#ifdef FRAMEWORK_SIMD_X86
+                auto fn = simd::select<void(*)(const double*, std::size_t, double, std::uint64_t*)>(
+                    compare_f64_avx2<Cmp>, nullptr, compare_f64_scalar<Cmp>);
+#else
+                auto fn = compare_f64_scalar<Cmp>;
+#endif
+                fn(values.data(), values.size(), static_cast<double>(rhs), out);
+            }
+            else if constexpr (std::is_same_v<T, int> && std::is_same_v<U, int>) {
+#ifdef FRAMEWORK_SIMD_X86
+                auto fn = simd::select<void(*)(const int*, std::size_t, int, std::uint64_t*)>(
+                    compare_i32_avx2<Cmp>, nullptr, compare_i32_scalar<Cmp>);
+#else
+                auto fn = compare_i32_scalar<Cmp>;
+#endif
+                fn(values.data(), values.size(), rhs, out);
+            }
+            else {
+                compare_tail<Cmp>(values.data(), 0, values.size(), rhs, out);
+            }
+        }
+
+    } // namespace detail
+
+    // Calls f(begin, end) for every maximal run of valid rows; a null bitmap means all valid
+    template<typename F>
+    void for_each_valid_run(const std::uint64_t* validity, std::size_t n, F&& f) {
+        if (!validity) {
+            if (n) f(std::size_t{ 0 }, n);
+            return;
+        }
+        constexpr std::size_t none = static_cast<std::size_t>(-1);
+        std::size_t run = none;
+        for (std::size_t base = 0; base < n; base += 64) {
+            const std::size_t limit = std::min<std::size_t>(64, n - base);
+            std::uint64_t word = validity[base / 64];
+            if (limit < 64) word &= (std::uint64_t{ 1 } << limit) - 1;
+
+            if (word == ~std::uint64_t{ 0 }) {
+                if (run == none) run = base;
+                continue;
+            }
+            std::size_t pos = 0;
+            while (pos < limit) {
+                std::uint64_t rest = word >> pos;
+                if (rest & 1) {
+                    if (run == none) run = base + pos;
+                    pos += static_cast<std::size_t>(std::countr_one(rest));
+                }
+                else {
+                    if (run != none) {
+                        f(run, base + pos);
+                        run = none;
+                    }
+                    if (rest == 0) break;
+                    pos += static_cast<std::size_t>(std::countr_zero(rest));
+                }
+            }
+        }
+        if (run != none) f(run, n);
+    }
+
+    // Number of valid rows among the first n
+    inline std::size_t count_valid(const std::uint64_t* validity, std::size_t n) {
+        if (!validity) return n;
+        std::size_t c = 0;
+        for (std::size_t w = 0; w < n / 64; ++w) c += static_cast<std::size_t>(std::popcount(validity[w]));
+        if (n % 64) c += static_cast<std::size_t>(std::popcount(validity[n / 64] & ((std::uint64_t{ 1 } << (n % 64)) - 1)));
+        return c;
+    }
+
+    // Sum widened to double (floating) or int64 (integral)
+    template<typename T>
+    detail::sum_t<T> sum(std::span<const T> values, const std::uint64_t* validity = nullptr) {
+        detail::sum_t<T> total{};
+        for_each_valid_run(validity, values.size(), [&](std::size_t b, std::size_t e) {
+            total += detail::dense_sum(values.data() + b, e - b);
+        });
+        return total;
+    }
+
+    // Empty when there are no valid rows. NaN inputs give unspecified results
+    template<typename T>
+    std::optional<T> min(std::span<const T> values, const std::uint64_t* validity = nullptr) {
+        std::optional<T> m;
+        for_each_valid_run(validity, values.size(), [&](std::size_t b, std::size_t e) {
+            T v = detail::dense_min(values.data() + b, e - b);
+            if (!m || v < *m) m = v;
+        });
+        return m;
+    }
+
+    template<typename T>
+    std::optional<T> max(std::span<const T> values, const std::uint64_t* validity = nullptr) {
+        std::optional<T> m;
+        for_each_valid_run(validity, values.size(), [&](std::size_t b, std::size_t e) {
+            T v = detail::dense_max(values.data() + b, e - b);
+            if (!m || v > *m) m = v;
+        });
+        return m;
+    }
+
+    template<typename T>
+    std::size_t count(std::span<const T> values, const std::uint64_t* validity = nullptr) {
+        return count_valid(validity, values.size());
+    }
+
+    // NaN when there are no valid rows
+    template<typename T>
+    double mean(std::span<const T> values, const std::uint64_t* validity = nullptr) {
+        std::size_t n = count_valid(validity, values.size());
+        if (n == 0) return std::numeric_limits<double>::quiet_NaN();
+        return static_cast<double>(sum(values, validity)) / static_cast<double>(n);
+    }
+
+    // Two-pass variance (mean first, then squared deviations); ddof = 1 gives the sample variance
+    template<typename T>
+    double var(std::span<const T> values, const std::uint64_t* validity = nullptr, std::size_t ddof = 1) {
+        std::size_t n = count_valid(validity, values.size());
+        if (n <= ddof) return std::numeric_limits<double>::quiet_NaN();
+        double mu = static_cast<double>(sum(values, validity)) / static_cast<double>(n);
+        double ss = 0;
+        for_each_valid_run(validity, values.size(), [&](std::size_t b, std::size_t e) {
+            ss += detail::dense_sqdev(values.data() + b, e - b, mu);
+        });
+        return ss / static_cast<double>(n - ddof);
+    }
+
+    // Row of the first minimum: vectorized min, then a scan for its first occurrence
+    template<typename T>
+    std::optional<std::size_t> argmin(std::span<const T> values, const std::uint64_t* validity = nullptr) {
+        auto m = min(values, validity);
+        if (!m) return std::nullopt;
+        std::optional<std::size_t> at;
+        for_each_valid_run(validity, values.size(), [&](std::size_t b, std::size_t e) {
+            if (at) return;
+            auto it = std::find(values.begin() + static_cast<std::ptrdiff_t>(b), values.begin() + static_cast<std::ptrdiff_t>(e), *m);
+            if (it != values.begin() + static_cast<std::ptrdiff_t>(e)) at = static_cast<std::size_t>(it - values.begin());
+        });
+        return at;
+    }
+
+    template<typename T>
+    std::optional<std::size_t> argmax(std::span<const T> values, const std::uint64_t* validity = nullptr) {
+        auto m = max(values, validity);
+        if (!m) return std::nullopt;
+        std::optional<std::size_t> at;
+        for_each_valid_run(validity, values.size(), [&](std::size_t b, std::size_t e) {
+            if (at) return;
+            auto it = std::find(values.begin() + static_cast<std::ptrdiff_t>(b), values.begin() + static_cast<std::ptrdiff_t>(e), *m);
+            if (it != values.begin() + static_cast<std::ptrdiff_t>(e)) at = static_cast<std::size_t>(it - values.begin());
+        });
+        return at;
+    }
+
+    // Branch-free counting loop; simple predicates auto-vectorize
+    template<typename T, typename Pred>
+    std::size_t count_if(std::span<const T> values, Pred pred, const std::uint64_t* validity = nullptr) {
+        std::size_t c = 0;
+        for_each_valid_run(validity, values.size(), [&](std::size_t b, std::size_t e) {
+            const T* p = values.data();
+            for (std::size_t i = b; i < e; ++i) c += pred(p[i]) ? 1 : 0;
+        });
+        return c;
+    }
+
+    enum class compare_op { eq, ne, lt, le, gt, ge };
+
+    // Words needed for a bitmask over n rows
+    inline std::size_t mask_words(std::size_t n) { return (n + 63) / 64; }
+
+    // out (mask_words(n) words) gets bit i = values[i] op rhs; double and int columns use AVX2
+    template<typename T, typename U>
+    void compare(std::span<const T> values, compare_op op, const U& rhs, std::uint64_t* out) {
+        switch (op) {
+        case compare_op::eq: return detail::compare_with<std::equal_to<>>(values, rhs, out);
+        case compare_op::ne: return detail::compare_with<std::not_equal_to<>>(values, rhs, out);
+        case compare_op::lt: return detail::compare_with<std::less<>>(values, rhs, out);
+        case compare_op::le: return detail::compare_with<std::less_equal<>>(values, rhs, out);
+        case compare_op::gt: return detail::compare_with<std::greater<>>(values, rhs, out);
+        case compare_op::ge: return detail::compare_with<std::greater_equal<>>(values, rhs, out);
+        }
+    }
+
+    inline void mask_and(std::uint64_t* dst, const std::uint64_t* src, std::size_t words) {
+        for (std::size_t i = 0; i < words; ++i) dst[i] &= src[i];
+    }
+
+    inline void mask_or(std::uint64_t* dst, const std::uint64_t* src, std::size_t words) {
+        for (std::size_t i = 0; i < words; ++i) dst[i] |= src[i];
+    }
+
+    // Flips the first n bits and keeps the bits past n cleared
+    inline void mask_not(std::uint64_t* dst, std::size_t n) {
+        for (std::size_t i = 0; i < n / 64; ++i) dst[i] = ~dst[i];
+        if (n % 64) dst[n / 64] = ~dst[n / 64] & ((std::uint64_t{ 1 } << (n % 64)) - 1);
+    }
+
+    // Selection vector: indices of the set bits, in order
+    inline std::vector<std::size_t> mask_to_indices(const std::uint64_t* mask, std::size_t n) {
+        std::vector<std::size_t> rows;
+        rows.reserve(count_valid(mask, n));
+        for (std::size_t w = 0; w < mask_words(n); ++w) {
+            std::uint64_t bits = mask[w];
+            if (w == n / 64 && n % 64) bits &= (std::uint64_t{ 1 } << (n % 64)) - 1;
+            while (bits) {
+                rows.push_back(w * 64 + static_cast<std::size_t>(std::countr_zero(bits)));
+                bits &= bits - 1;
+            }
+        }
+        return rows;
+    }
+
+} // namespace framework::kernels
@@ -0,0 +1,340 @@
+#pragma once
+
+#include "data_frame.hpp"
+#include "mapped_file.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace framework {
+
+    // Native columnar file, little-endian, every block 64-byte aligned:
+    //   [columnar_header][columnar_entry x columns][names]
+    //   then per column: values (int32 / f64 / int64 / one byte per bool, timestamps as int64
+    //   nanoseconds, or for strings u64 offsets
+    //   x (rows + 1) followed by the character bytes), then optional per-block min/max and,
+    //   for columns with nulls, the validity bitmap (validity_bitmap layout).
+    // data_frame::open_mmap() maps it and serves numeric columns straight from the mapping.
+    namespace columnar {
+        inline constexpr char magic[8] = { 'F', 'W', 'C', 'O', 'L', 'S', '0', '1' };
+        inline constexpr std::uint32_t version = 1;
+        inline constexpr std::size_t alignment = 64;
+        inline constexpr std::size_t default_block_rows = 65536;
+
+        struct header {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t column_count;
+            std::uint64_t row_count;
+            std::uint64_t block_rows;
+            std::uint8_t reserved[32];
+        };
+        static_assert(sizeof(header) == 64);
+
+        struct entry {
+            std::uint8_t type; // data_type
+            std::uint8_t pad[3];
+            std::uint32_t name_size;
+            std::uint64_t name_offset;
+            std::uint64_t data_offset;
+            std::uint64_t bytes_offset; // strings: character data
+            std::uint64_t bytes_size;
+            std::uint64_t stats_offset; // 0 when the column has no block statistics
+            std::uint64_t stats_count;
+            std::uint64_t validity_offset; // 0 when the column has no nulls
+        };
+        static_assert(sizeof(entry) == 64);
+
+        // Value range of one block of block_rows rows of a numeric column; NaN for both when
+        // the block holds a NaN, whose rows no range describes
+        struct block_stats {
+            double min;
+            double max;
+        };
+    }
+
+    // Numeric column served from a mapping; read-only, values() is zero-copy
+    template<typename T>
+    class mapped_column : public typed_column<T> {
+        std::shared_ptr<const mapped_file> file_;
+        std::span<const T> values_;
+        std::span<const columnar::block_stats> stats_;
+        std::size_t block_rows_;
+        const std::uint64_t* validity_;
+
+    public:
+        mapped_column(std::shared_ptr<const mapped_file> file, std::span<const T> values,
+            std::span<const columnar::block_stats> stats, std::size_t block_rows, const std::uint64_t* validity = nullptr)
+            : file_(std::move(file)), values_(values), stats_(stats), block_rows_(block_rows), validity_(validity) {
+        }
+
+        data_value get(size_t row) const override { return values_[row]; }
+        void set(size_t, const data_value&) override { throw std::runtime_error("Mapped column is read-only"); }
+        void push_back(const data_value&) override { throw std::runtime_error("Mapped column is read-only"); }
+        size_t size() const override { return values_.size(); }
+        data_type type() const override { return data_type_of<T>::value; }
+        const std::uint64_t* validity() const override { return validity_; }
+        bool shares_storage() const override { return true; }
+
+        std::shared_ptr<IColumn> gather(std::span<const size_t> rows) const override {
+            auto out = std::make_shared<data_column<T>>("");
+            out->data.reserve(rows.size());
+            for (size_t r : rows) {
+                if (r == no_row || this->is_null(r)) out->push_null();
+                else out->push_valid(values_[r]);
+            }
+            return out;
+        }
+
+        std::span<const T> values() const override { return values_; }
+
+        // Min/max of rows [i * block_rows(), (i + 1) * block_rows())
+        std::span<const columnar::block_stats> block_stats() const { return stats_; }
+        std::size_t block_rows() const { return block_rows_; }
+    };
+
+    // String column over offsets + bytes in a mapping. view() is zero-copy; values() needs
+    // std::string objects and decodes the whole column once, on first use.
+    class mapped_string_column : public typed_column<std::string> {
+        std::shared_ptr<const mapped_file> file_;
+        const std::uint64_t* offsets_;
+        const char* bytes_;
+        std::size_t rows_;
+        const std::uint64_t* validity_;
+        mutable std::once_flag decoded_once_;
+        mutable std::vector<std::string> decoded_;
+
+    public:
+        mapped_string_column(std::shared_ptr<const mapped_file> file, const std::uint64_t* offsets, const char* bytes,
+            std::size_t rows, const std::uint64_t* validity = nullptr)
+            : file_(std::move(file)), offsets_(offsets), bytes_(bytes), rows_(rows), validity_(validity) {
+        }
+
+        std::string_view view(size_t row) const {
+            return std::string_view(bytes_ + offsets_[row], static_cast<size_t>(offsets_[row + 1] - offsets_[row]));
+        }
+
+        data_value get(size_t row) const override { return std::string(view(row)); }
+        void set(size_t, const data_value&) override { throw std::runtime_error("Mapped column is read-only"); }
+        void push_back(const data_value&) override { throw std::runtime_error("Mapped column is read-only"); }
+        size_t size() const override { return rows_; }
+        data_type type() const override { return data_type::string; }
+        const std::uint64_t* validity() const override { return validity_; }
+        bool shares_storage() const override { return true; }
+
+        std::shared_ptr<IColumn> gather(std::span<const size_t> rows) const override {
+            auto out = std::make_shared<data_column<std::string>>("");
+            out->data.reserve(rows.size());
+            for (size_t r : rows) {
+                if (r == no_row || is_null(r)) out->push_null();
+                else out->push_valid(std::string(view(r)));
+            }
+            return out;
+        }
+
+        std::span<const std::string> values() const override {
+            std::call_once(decoded_once_, [this] {
+                decoded_.reserve(rows_);
+                for (size_t r = 0; r < rows_; ++r) decoded_.emplace_back(view(r));
+            });
+            return decoded_;
+        }
+    };
+
+    namespace detail {
+        inline void write_padding(std::ofstream& out) {
+            static constexpr char zeros[columnar::alignment] = {};
+            auto at = static_cast<std::size_t>(out.tellp());
+            if (at % columnar::alignment) out.write(zeros, columnar::alignment - at % columnar::alignment);
+        }
+
+        template<typename T>
+        void write_raw(std::ofstream& out, const T* data, std::size_t count) {
+            out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(count * sizeof(T)));
+        }
+
+        template<typename T>
+        std::vector<columnar::block_stats> compute_block_stats(std::span<const T> values, std::size_t block_rows) {
+            std::vector<columnar::block_stats> stats;
+            for (std::size_t b = 0; b < values.size(); b += block_rows) {
+                auto block = values.subspan(b, std::min(block_rows, values.size() - b));
+                if constexpr (std::is_floating_point_v<T>) {
+                    if (std::any_of(block.begin(), block.end(), [](T v) { return v != v; })) {
+                        stats.push_back({ std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN() });
+                        continue;
+                    }
+                }
+                auto [lo, hi] = std::minmax_element(block.begin(), block.end());
+                if constexpr (std::is_same_v<T, timestamp>)
+                    stats.push_back({ static_cast<double>(lo->time_since_epoch().count()), static_cast<double>(hi->time_since_epoch().count()) });
+                else
+                    stats.push_back({ static_cast<double>(*lo), static_cast<double>(*hi) });
+            }
+            return stats;
+        }
+
+        // Bounds-checked view of count T's at offset in the mapping
+        template<typename T>
+        const T* mapped_array(const mapped_file& file, std::uint64_t offset, std::uint64_t count) {
+            if (offset % alignof(T) || offset > file.size() || count > (file.size() - offset) / sizeof(T))
+                throw std::runtime_error("Corrupt columnar file");
+            return reinterpret_cast<const T*>(file.data() + offset);
+        }
+    }
+
+    inline void data_frame::save(const std::filesystem::path& path, size_t block_rows) const {
+        if (block_rows == 0) throw std::runtime_error("block_rows must be positive");
+        const auto names = column_names();
+        const size_t rows = rowCount();
+        auto tmp = path;
+        tmp += ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            if (!out) throw std::runtime_error("Cannot write " + tmp.string());
+
+            columnar::header head{};
+            std::memcpy(head.magic, columnar::magic, sizeof(head.magic));
+            head.version = columnar::version;
+            head.column_count = static_cast<std::uint32_t>(columns_.size());
+            head.row_count = rows;
+            head.block_rows = block_rows;
+
+            // Entries are patched once the data offsets are known
+            std::vector<columnar::entry> entries(columns_.size());
+            out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+            detail::write_raw(out, entries.data(), entries.size());
+            for (size_t c = 0; c < columns_.size(); ++c) {
+                entries[c].type = static_cast<std::uint8_t>(columns_[c]->type());
+                entries[c].name_size = static_cast<std::uint32_t>(names[c].size());
+                entries[c].name_offset = static_cast<std::uint64_t>(out.tellp());
+                out.write(names[c].data(), static_cast<std::streamsize>(names[c].size()));
+            }
+
+            for (size_t c = 0; c < columns_.size(); ++c) {
+                auto& e = entries[c];
+                detail::write_padding(out);
+                e.data_offset = static_cast<std::uint64_t>(out.tellp());
+                visit_column(*columns_[c], [&](const auto& typed) {
+                    using T = typename std::decay_t<decltype(typed)>::value_type;
+                    if constexpr (std::is_same_v<T, bool>) {
+                        std::vector<std::uint8_t> bytes(rows);
+                        for (size_t r = 0; r < rows; ++r) bytes[r] = std::get<bool>(typed.get(r)) ? 1 : 0;
+                        detail::write_raw(out, bytes.data(), rows);
+                    }
+                    else if constexpr (std::is_same_v<T, std::string>) {
+                        std::vector<std::uint64_t> offsets(rows + 1, 0);
+                        std::vector<std::string> held; // only for columns without a zero-copy view
+                        auto* mapped = dynamic_cast<const mapped_string_column*>(&typed);
+                        auto* dict = dynamic_cast<const dictionary_column*>(&typed);
+                        std::span<const std::string> strings = mapped || dict ? std::span<const std::string>() : typed.values();
+                        auto text = [&](size_t r) {
+                            return mapped ? mapped->view(r) : dict ? dict->view(r) : std::string_view(strings[r]);
+                        };
+                        for (size_t r = 0; r < rows; ++r) offsets[r + 1] = offsets[r] + text(r).size();
+                        detail::write_raw(out, offsets.data(), offsets.size());
+                        detail::write_padding(out);
+                        e.bytes_offset = static_cast<std::uint64_t>(out.tellp());
+                        e.bytes_size = offsets[rows];
+                        for (size_t r = 0; r < rows; ++r) out.write(text(r).data(), static_cast<std::streamsize>(text(r).size()));
+                    }
+                    else {
+                        auto values = typed.values();
+                        detail::write_raw(out, values.data(), values.size());
+                        auto stats = detail::compute_block_stats(values, block_rows);
+                        detail::write_padding(out);
+                        e.stats_offset = static_cast<std::uint64_t>(out.tellp());
+                        e.stats_count = stats.size();
+                        detail::write_raw(out, stats.data(), stats.size());
+                    }
+                });
+                if (auto* valid = columns_[c]->validity()) {
+                    detail::write_padding(out);
+                    e.validity_offset = static_cast<std::uint64_t>(out.tellp());
+                    detail::write_raw(out, valid, kernels::mask_words(rows));
+                }
+            }
+
+            out.seekp(sizeof(head));
+            detail::write_raw(out, entries.data(), entries.size());
+            out.flush();
+            if (!out) throw std::runtime_error("Write failed: " + tmp.string());
+        }
+        std::filesystem::rename(tmp, path);
+    }
+
+    // O(1) in the data size: only the header and column directory are read; int and double
+    // columns (and string bytes) stay in the mapping and fault in as they are touched. bool
+    // columns are small and unpacked into an ordinary data_column<bool>.
+    inline data_frame data_frame::open_mmap(const std::filesystem::path& path) {
+        auto file = std::make_shared<const mapped_file>(path);
+        auto& head = *detail::mapped_array<columnar::header>(*file, 0, 1);
+        if (std::memcmp(head.magic, columnar::magic, sizeof(head.magic)) != 0)
+            throw std::runtime_error("Not a columnar file: " + path.string());
+        if (head.version != columnar::version) throw std::runtime_error("Unsupported columnar file version");
+
+        const size_t rows = static_cast<size_t>(head.row_count);
+        const auto* entries = detail::mapped_array<columnar::entry>(*file, sizeof(head), head.column_count);
+        data_frame df;
+        for (std::uint32_t c = 0; c < head.column_count; ++c) {
+            const auto& e = entries[c];
+            std::string name(detail::mapped_array<char>(*file, e.name_offset, e.name_size), e.name_size);
+            const std::uint64_t* validity = e.validity_offset
+                ? detail::mapped_array<std::uint64_t>(*file, e.validity_offset, kernels::mask_words(rows)) : nullptr;
+            std::span<const columnar::block_stats> stats;
+            if (e.stats_offset)
+                stats = { detail::mapped_array<columnar::block_stats>(*file, e.stats_offset, e.stats_count), static_cast<size_t>(e.stats_count) };
+
+            switch (static_cast<data_type>(e.type)) {
+            case data_type::int32:
+                df.add_column(name, std::make_shared<mapped_column<int>>(file,
+                    std::span<const int>(detail::mapped_array<int>(*file, e.data_offset, rows), rows), stats, head.block_rows, validity));
+                break;
+            case data_type::float64:
+                df.add_column(name, std::make_shared<mapped_column<double>>(file,
+                    std::span<const double>(detail::mapped_array<double>(*file, e.data_offset, rows), rows), stats, head.block_rows, validity));
+                break;
+            case data_type::int64:
+                df.add_column(name, std::make_shared<mapped_column<std::int64_t>>(file,
+                    std::span<const std::int64_t>(detail::mapped_array<std::int64_t>(*file, e.data_offset, rows), rows), stats, head.block_rows, validity));
+                break;
+            case data_type::timestamp:
+                df.add_column(name, std::make_shared<mapped_column<timestamp>>(file,
+                    std::span<const timestamp>(detail::mapped_array<timestamp>(*file, e.data_offset, rows), rows), stats, head.block_rows, validity));
+                break;
+            case data_type::string: {
+                const auto* offsets = detail::mapped_array<std::uint64_t>(*file, e.data_offset, rows + 1);
+                const char* bytes = detail::mapped_array<char>(*file, e.bytes_offset, e.bytes_size);
+                if (offsets[rows] > e.bytes_size) throw std::runtime_error("Corrupt columnar file");
+                df.add_column(name, std::make_shared<mapped_string_column>(file, offsets, bytes, rows, validity));
+                break;
+            }
+            case data_type::boolean: {
+                const auto* bytes = detail::mapped_array<std::uint8_t>(*file, e.data_offset, rows);
+                auto col = std::make_shared<data_column<bool>>(name);
+                col->data.assign(bytes, bytes + rows);
+                if (validity) {
+                    for (size_t r = 0; r < rows; ++r)
+                        if (!((validity[r / 64] >> (r % 64)) & 1)) col->set_null(r);
+                }
+                df.add_column(name, col);
+                break;
+            }
+            default:
+                throw std::runtime_error("Corrupt columnar file");
+            }
+        }
+        return df;
+    }
+
+} // namespace framework
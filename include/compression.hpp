@@ -0,0 +1,501 @@
+#pragma once
+
+#include "column_kernels.hpp"
+#include "data_frame.hpp"
+#include "simd.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace framework {
+
+    namespace detail {
+        // Integer image of a value for the integer encodings; differences are taken in
+        // uint64 so they wrap instead of overflowing and decode back exactly
+        template<typename T>
+        std::int64_t to_bits(T v) {
+            if constexpr (std::is_same_v<T, timestamp>) return v.time_since_epoch().count();
+            else return static_cast<std::int64_t>(v);
+        }
+
+        template<typename T>
+        T from_bits(std::int64_t v) {
+            if constexpr (std::is_same_v<T, timestamp>) return timestamp(std::chrono::nanoseconds(v));
+            else return static_cast<T>(v);
+        }
+
+        // Equal representations, so rle keeps -0.0 apart from 0.0 and NaN payloads intact
+        template<typename T>
+        bool same_value(const T& a, const T& b) {
+            if constexpr (std::is_same_v<T, double>) return std::bit_cast<std::uint64_t>(a) == std::bit_cast<std::uint64_t>(b);
+            else return a == b;
+        }
+
+        // Offset i of width bits, packed LSB first from words; a word past the last one
+        // holding bits must be readable
+        inline std::uint64_t packed_at(const std::uint64_t* words, unsigned width, std::size_t i) {
+            if (width == 0) return 0;
+            std::size_t bit = i * width;
+            const std::uint64_t* w = words + bit / 64;
+            unsigned shift = bit % 64;
+            std::uint64_t v = w[0] >> shift;
+            if (shift + width > 64) v |= w[1] << (64 - shift);
+            return width == 64 ? v : v & ((std::uint64_t{ 1 } << width) - 1);
+        }
+
+        inline void unpack_scalar(const std::uint64_t* words, unsigned width, std::size_t n, std::uint64_t base, std::uint64_t* out) {
+            for (std::size_t i = 0; i < n; ++i) out[i] = base + packed_at(words, width, i);
+        }
+
+#ifdef FRAMEWORK_SIMD_X86
+        // Four values per step: gather the two words each straddles, shift them into place
+        // with per-lane variable shifts (a shift by 64 yields 0), mask and add the base
+        FRAMEWORK_TARGET_AVX2 inline void unpack_avx2(const std::uint64_t* words, unsigned width, std::size_t n, std::uint64_t base, std::uint64_t* out) {
+            if (width == 0) return unpack_scalar(words, width, n, base, out);
+            const std::uint64_t mask = width == 64 ? ~std::uint64_t{ 0 } : (std::uint64_t{ 1 } << width) - 1;
+            const __m256i vmask = _mm256_set1_epi64x(static_cast<long long>(mask));
+            const __m256i vbase = _mm256_set1_epi64x(static_cast<long long>(base));
+            const __m256i v64 = _mm256_set1_epi64x(64), v63 = _mm256_set1_epi64x(63), one = _mm256_set1_epi64x(1);
+            const __m256i step = _mm256_set1_epi64x(static_cast<long long>(4 * width));
+            __m256i bit = _mm256_set_epi64x(3ll * width, 2ll * width, width, 0);
+            const auto* base_ptr = reinterpret_cast<const long long*>(words);
+            std::size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                __m256i w = _mm256_srli_epi64(bit, 6);
+                __m256i shift = _mm256_and_si256(bit, v63);
+                __m256i lo = _mm256_i64gather_epi64(base_ptr, w, 8);
+                __m256i hi = _mm256_i64gather_epi64(base_ptr, _mm256_add_epi64(w, one), 8);
+                __m256i v = _mm256_or_si256(_mm256_srlv_epi64(lo, shift), _mm256_sllv_epi64(hi, _mm256_sub_epi64(v64, shift)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_add_epi64(_mm256_and_si256(v, vmask), vbase));
+                bit = _mm256_add_epi64(bit, step);
+            }
+            for (; i < n; ++i) out[i] = base + packed_at(words, width, i);
+        }
+#endif
+
+        inline void unpack(const std::uint64_t* words, unsigned width, std::size_t n, std::uint64_t base, std::uint64_t* out) {
+#ifdef FRAMEWORK_SIMD_X86
+            auto fn = simd::select<void(*)(const std::uint64_t*, unsigned, std::size_t, std::uint64_t, std::uint64_t*)>(
+                unpack_avx2, nullptr, unpack_scalar);
+#else
+            auto fn = unpack_scalar;
+#endif
+            fn(words, width, n, base, out);
+        }
+
+        inline void pack(const std::uint64_t* offsets, std::size_t n, unsigned width, std::vector<std::uint64_t>& words) {
+            std::size_t first = words.size();
+            words.resize(first + (n * width + 63) / 64, 0);
+            if (width == 0) return;
+            for (std::size_t i = 0; i < n; ++i) {
+                std::size_t bit = i * width, w = first + bit / 64;
+                unsigned shift = bit % 64;
+                words[w] |= offsets[i] << shift;
+                if (shift + width > 64) words[w + 1] |= offsets[i] >> (64 - shift);
+            }
+        }
+
+        // Sets bits [begin, end) of a mask
+        inline void set_bits(std::uint64_t* out, std::size_t begin, std::size_t end) {
+            for (; begin < end && begin % 64; ++begin) out[begin / 64] |= std::uint64_t{ 1 } << (begin % 64);
+            for (; begin + 64 <= end; begin += 64) out[begin / 64] = ~std::uint64_t{ 0 };
+            for (; begin < end; ++begin) out[begin / 64] |= std::uint64_t{ 1 } << (begin % 64);
+        }
+
+        inline std::size_t count_valid_range(const std::uint64_t* validity, std::size_t begin, std::size_t end) {
+            if (!validity) return end - begin;
+            std::size_t c = 0;
+            for (; begin < end && begin % 64; ++begin) c += (validity[begin / 64] >> (begin % 64)) & 1;
+            c += kernels::count_valid(validity + begin / 64, end - begin);
+            return c;
+        }
+
+        // Whether every / no value in [lo, hi] satisfies v op rhs; neither when it depends
+        template<typename T>
+        std::optional<bool> zone_verdict(const T& lo, const T& hi, kernels::compare_op op, const T& rhs) {
+            switch (op) {
+            case kernels::compare_op::eq:
+                if (rhs < lo || hi < rhs) return false;
+                if (lo == rhs && hi == rhs) return true;
+                break;
+            case kernels::compare_op::ne:
+                if (rhs < lo || hi < rhs) return true;
+                if (lo == rhs && hi == rhs) return false;
+                break;
+            case kernels::compare_op::lt:
+                if (hi < rhs) return true;
+                if (!(lo < rhs)) return false;
+                break;
+            case kernels::compare_op::le:
+                if (!(rhs < hi)) return true;
+                if (rhs < lo) return false;
+                break;
+            case kernels::compare_op::gt:
+                if (rhs < lo) return true;
+                if (!(rhs < hi)) return false;
+                break;
+            case kernels::compare_op::ge:
+                if (!(lo < rhs)) return true;
+                if (hi < rhs) return false;
+                break;
+            }
+            return std::nullopt;
+        }
+
+        template<typename T>
+        bool compare_one(const T& v, kernels::compare_op op, const T& rhs) {
+            switch (op) {
+            case kernels::compare_op::eq: return v == rhs;
+            case kernels::compare_op::ne: return v != rhs;
+            case kernels::compare_op::lt: return v < rhs;
+            case kernels::compare_op::le: return v <= rhs;
+            case kernels::compare_op::gt: return v > rhs;
+            case kernels::compare_op::ge: return v >= rhs;
+            }
+            return false;
+        }
+    }
+
+    // Read-only column of int, int64, double (rle only) or timestamp values in one of
+    // three encodings:
+    //   rle                 runs of one value, each stored once with the row it ends at
+    //   frame_of_reference  blocks of block_rows values stored as bit-packed offsets from
+    //                       the block minimum, at the width of the block's largest offset
+    //   delta               the same packing applied to the differences between neighbours,
+    //                       so a sorted column costs the bits of its largest step
+    // Blocks keep their min and max, so min/max read only those and comparisons settle whole
+    // blocks without unpacking them; sums add run lengths or unpack a block at a time into
+    // a buffer (AVX2 gathers). Null rows repeat the previous valid value, keeping runs and
+    // block ranges intact, and read as T{}. values() decodes the whole column once.
+    template<typename T>
+    class compressed_column : public encoded_column<T> {
+        static constexpr bool integral = !std::is_same_v<T, double>;
+
+        struct block {
+            T lo, hi;
+            std::int64_t first;  // delta: the block's first value
+            std::uint64_t base;  // the offsets' reference (minimum value or difference)
+            std::size_t word;    // first word of the packed offsets
+            unsigned width;
+        };
+
+        column_encoding encoding_;
+        std::size_t rows_ = 0;
+        validity_bitmap validity_;
+        std::vector<block> blocks_;
+        std::vector<std::uint64_t> words_;
+        std::vector<T> run_values_;
+        std::vector<std::size_t> run_ends_;
+        mutable std::once_flag decoded_once_;
+        mutable std::vector<T> decoded_;
+
+        void encode_blocks(std::span<const T> filled) {
+            std::uint64_t offsets[block_rows];
+            for (std::size_t b = 0; b < filled.size(); b += block_rows) {
+                std::size_t n = std::min(block_rows, filled.size() - b);
+                block blk{ filled[b], filled[b], detail::to_bits(filled[b]), 0, words_.size(), 0 };
+                for (std::size_t i = 0; i < n; ++i) {
+                    blk.lo = std::min(blk.lo, filled[b + i]);
+                    blk.hi = std::max(blk.hi, filled[b + i]);
+                    std::uint64_t v = static_cast<std::uint64_t>(detail::to_bits(filled[b + i]));
+                    offsets[i] = encoding_ == column_encoding::delta
+                        ? (i ? v - static_cast<std::uint64_t>(detail::to_bits(filled[b + i - 1])) : 0)
+                        : v;
+                }
+                // Reference: the smallest offset read as a signed value
+                blk.base = *std::min_element(offsets, offsets + n, [](std::uint64_t a, std::uint64_t c) {
+                    return static_cast<std::int64_t>(a) < static_cast<std::int64_t>(c);
+                });
+                std::uint64_t range = 0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    offsets[i] -= blk.base;
+                    range |= offsets[i];
+                }
+                blk.width = static_cast<unsigned>(std::bit_width(range));
+                detail::pack(offsets, n, blk.width, words_);
+                blocks_.push_back(blk);
+            }
+            words_.push_back(0); // readable word past the end for the unpacker
+        }
+
+    public:
+        static constexpr std::size_t block_rows = 1024; // a multiple of 64, so blocks start on validity words
+
+        std::string name;
+
+        compressed_column(const std::string& n, std::span<const T> values, const std::uint64_t* validity, column_encoding encoding)
+            : encoding_(encoding), rows_(values.size()), name(n) {
+            if (encoding != column_encoding::rle && encoding != column_encoding::delta && encoding != column_encoding::frame_of_reference)
+                throw std::runtime_error("Unsupported column encoding");
+            if (!integral && encoding != column_encoding::rle)
+                throw std::runtime_error("Only rle applies to float64 columns");
+            validity_.append(validity, values.size(), 0);
+
+            // Null rows take the previous valid value (the first one for leading nulls)
+            std::vector<T> filled;
+            std::span<const T> src = values;
+            if (validity && kernels::count_valid(validity, values.size()) != values.size()) {
+                filled.assign(values.begin(), values.end());
+                T last{};
+                for (std::size_t r = 0; r < filled.size(); ++r)
+                    if (validity_.valid(r)) { last = filled[r]; break; }
+                for (std::size_t r = 0; r < filled.size(); ++r) {
+                    if (validity_.valid(r)) last = filled[r];
+                    else filled[r] = last;
+                }
+                src = filled;
+            }
+
+            if (encoding == column_encoding::rle) {
+                for (std::size_t r = 0; r < src.size(); ++r) {
+                    if (!run_values_.empty() && detail::same_value(run_values_.back(), src[r])) run_ends_.back() = r + 1;
+                    else {
+                        run_values_.push_back(src[r]);
+                        run_ends_.push_back(r + 1);
+                    }
+                }
+            }
+            else if constexpr (integral) {
+                encode_blocks(src);
+            }
+        }
+
+        column_encoding encoding() const { return encoding_; }
+
+        // Bytes held by the encoding and validity, against size() * sizeof(T) plain
+        std::size_t encoded_bytes() const {
+            return blocks_.size() * sizeof(block) + words_.size() * sizeof(std::uint64_t)
+                + run_values_.size() * (sizeof(T) + sizeof(std::size_t)) + (validity() ? kernels::mask_words(rows_) * 8 : 0);
+        }
+
+        // The rows of block index (from index * block_rows, at most block_rows of them) into
+        // out; null rows get the values they are encoded with
+        void decode_block(std::size_t index, T* out) const {
+            const std::size_t begin = index * block_rows, n = std::min(block_rows, rows_ - begin);
+            if (encoding_ == column_encoding::rle) {
+                auto run = std::upper_bound(run_ends_.begin(), run_ends_.end(), begin) - run_ends_.begin();
+                for (std::size_t r = begin; r < begin + n; ++run) {
+                    std::size_t end = std::min(run_ends_[run], begin + n);
+                    std::fill(out + (r - begin), out + (end - begin), run_values_[run]);
+                    r = end;
+                }
+                return;
+            }
+            if constexpr (integral) {
+                const block& blk = blocks_[index];
+                std::uint64_t buffer[block_rows];
+                detail::unpack(words_.data() + blk.word, blk.width, n, blk.base, buffer);
+                if (encoding_ == column_encoding::delta) {
+                    std::uint64_t v = static_cast<std::uint64_t>(blk.first);
+                    for (std::size_t i = 0; i < n; ++i) {
+                        v += buffer[i];
+                        out[i] = detail::from_bits<T>(static_cast<std::int64_t>(v));
+                    }
+                }
+                else {
+                    for (std::size_t i = 0; i < n; ++i) out[i] = detail::from_bits<T>(static_cast<std::int64_t>(buffer[i]));
+                }
+            }
+        }
+
+        std::size_t block_count() const { return (rows_ + block_rows - 1) / block_rows; }
+
+        // Value of one row: a run found by binary search, a single offset, or (delta) the
+        // block decoded up to it
+        T value(std::size_t row) const {
+            if (row >= rows_) throw std::out_of_range("Row out of range");
+            if (!validity_.valid(row)) return T{};
+            if (encoding_ == column_encoding::rle)
+                return run_values_[std::upper_bound(run_ends_.begin(), run_ends_.end(), row) - run_ends_.begin()];
+            if constexpr (integral) {
+                const block& blk = blocks_[row / block_rows];
+                std::size_t i = row % block_rows;
+                if (encoding_ == column_encoding::frame_of_reference)
+                    return detail::from_bits<T>(static_cast<std::int64_t>(blk.base + detail::packed_at(words_.data() + blk.word, blk.width, i)));
+                T out[block_rows];
+                decode_block(row / block_rows, out);
+                return out[i];
+            }
+            return T{};
+        }
+
+        data_value get(size_t row) const override { return value(row); }
+        void set(size_t, const data_value&) override { throw std::runtime_error("Compressed column is read-only"); }
+        void push_back(const data_value&) override { throw std::runtime_error("Compressed column is read-only"); }
+        size_t size() const override { return rows_; }
+        data_type type() const override { return data_type_of<T>::value; }
+        const std::uint64_t* validity() const override { return validity_.data(rows_); }
+        // Read-only: data_frame writes to a decoded copy (clone()) instead
+        bool shares_storage() const override { return true; }
+
+        std::shared_ptr<IColumn> clone() const override {
+            auto out = std::make_shared<data_column<T>>(name);
+            out->append(values(), validity());
+            return out;
+        }
+
+        // Decodes each block a gathered row falls in once while consecutive rows stay in it
+        std::shared_ptr<IColumn> gather(std::span<const size_t> rows) const override {
+            auto out = std::make_shared<data_column<T>>(name);
+            out->data.reserve(rows.size());
+            std::vector<T> buffer(block_rows);
+            std::size_t cached = no_row;
+            for (size_t r : rows) {
+                if (r == no_row || !validity_.valid(r)) {
+                    out->push_null();
+                    continue;
+                }
+                if (encoding_ == column_encoding::frame_of_reference) {
+                    out->push_valid(value(r));
+                    continue;
+                }
+                if (r / block_rows != cached) {
+                    cached = r / block_rows;
+                    decode_block(cached, buffer.data());
+                }
+                out->push_valid(buffer[r % block_rows]);
+            }
+            return out;
+        }
+
+        std::span<const T> values() const override {
+            std::call_once(decoded_once_, [&] {
+                decoded_.resize(rows_);
+                for (std::size_t b = 0; b < block_count(); ++b) decode_block(b, decoded_.data() + b * block_rows);
+                if (validity())
+                    for (std::size_t r = 0; r < rows_; ++r)
+                        if (!validity_.valid(r)) decoded_[r] = T{};
+            });
+            return decoded_;
+        }
+
+        kernels::detail::sum_t<T> sum() const override {
+            if constexpr (std::is_same_v<T, timestamp>) {
+                throw std::runtime_error("Timestamps do not sum");
+            }
+            else {
+                kernels::detail::sum_t<T> total{};
+                const auto* valid = validity();
+                if (encoding_ == column_encoding::rle) {
+                    for (std::size_t run = 0, begin = 0; run < run_values_.size(); begin = run_ends_[run++]) {
+                        auto n = detail::count_valid_range(valid, begin, run_ends_[run]);
+                        total += static_cast<kernels::detail::sum_t<T>>(run_values_[run]) * static_cast<kernels::detail::sum_t<T>>(n);
+                    }
+                    return total;
+                }
+                std::vector<T> buffer(block_rows);
+                for (std::size_t b = 0; b < block_count(); ++b) {
+                    decode_block(b, buffer.data());
+                    std::size_t n = std::min(block_rows, rows_ - b * block_rows);
+                    total += kernels::sum(std::span<const T>(buffer.data(), n), valid ? valid + b * block_rows / 64 : nullptr);
+                }
+                return total;
+            }
+        }
+
+        // Null rows hold copies of valid values, so the extremes of runs and blocks are exact
+        std::optional<T> min() const override { return extreme(false); }
+        std::optional<T> max() const override { return extreme(true); }
+
+        void compare(kernels::compare_op op, const T& rhs, std::size_t begin, std::size_t end, std::uint64_t* out) const override {
+            std::fill_n(out, kernels::mask_words(end - begin), 0);
+            if (encoding_ == column_encoding::rle) {
+                std::size_t run = std::upper_bound(run_ends_.begin(), run_ends_.end(), begin) - run_ends_.begin();
+                for (std::size_t start = run ? run_ends_[run - 1] : 0; run < run_values_.size() && start < end; start = run_ends_[run++])
+                    if (detail::compare_one(run_values_[run], op, rhs))
+                        detail::set_bits(out, std::max(start, begin) - begin, std::min(run_ends_[run], end) - begin);
+                return;
+            }
+            std::vector<T> buffer(block_rows);
+            for (std::size_t b = begin / block_rows; b * block_rows < end; ++b) {
+                const std::size_t first = b * block_rows, n = std::min(block_rows, rows_ - first);
+                const std::size_t lo = std::max(first, begin), hi = std::min(first + n, end);
+                auto verdict = detail::zone_verdict(blocks_[b].lo, blocks_[b].hi, op, rhs);
+                if (verdict) {
+                    if (*verdict) detail::set_bits(out, lo - begin, hi - begin);
+                    continue;
+                }
+                decode_block(b, buffer.data());
+                kernels::compare(std::span<const T>(buffer.data() + (lo - first), hi - lo), op, rhs, out + (lo - begin) / 64);
+            }
+        }
+
+    private:
+        std::optional<T> extreme(bool highest) const {
+            if (rows_ == 0 || kernels::count_valid(validity(), rows_) == 0) return std::nullopt;
+            std::optional<T> m;
+            auto take = [&](const T& v) {
+                if (!m || (highest ? *m < v : v < *m)) m = v;
+            };
+            if (encoding_ == column_encoding::rle) for (const auto& v : run_values_) take(v);
+            else for (const auto& blk : blocks_) take(highest ? blk.hi : blk.lo);
+            return m;
+        }
+    };
+
+    namespace detail {
+        template<typename T>
+        std::shared_ptr<compressed_column<T>> compress_column(const std::string& name, const typed_column<T>& col, column_encoding encoding) {
+            auto values = col.values();
+            if (encoding != column_encoding::automatic)
+                return std::make_shared<compressed_column<T>>(name, values, col.validity(), encoding);
+            std::shared_ptr<compressed_column<T>> best;
+            for (auto e : { column_encoding::rle, column_encoding::delta, column_encoding::frame_of_reference }) {
+                if (std::is_same_v<T, double> && e != column_encoding::rle) continue;
+                auto c = std::make_shared<compressed_column<T>>(name, values, col.validity(), e);
+                if (!best || c->encoded_bytes() < best->encoded_bytes()) best = std::move(c);
+            }
+            if (best->encoded_bytes() >= values.size() * sizeof(T)) return nullptr;
+            return best;
+        }
+    }
+
+    inline bool data_frame::compress(const std::string& name, column_encoding encoding) {
+        size_t index = column_position(name);
+        const IColumn& col = *columns_[index];
+        if (col.type() == data_type::string) {
+            if (encoding != column_encoding::automatic && encoding != column_encoding::dictionary)
+                throw std::runtime_error("Strings compress by dictionary: " + name);
+            return dictionary_encode(name, encoding == column_encoding::dictionary ? 1.0 : 0.5);
+        }
+        if (encoding == column_encoding::dictionary) throw std::runtime_error("Dictionary encoding applies to strings: " + name);
+        std::shared_ptr<IColumn> compressed;
+        visit_column(col, [&](const auto& typed) {
+            using T = typename std::decay_t<decltype(typed)>::value_type;
+            if constexpr (std::is_same_v<T, bool> || std::is_same_v<T, std::string>) {
+                throw std::runtime_error("Unsupported column for compression: " + name);
+            }
+            else {
+                compressed = detail::compress_column(name, typed, encoding);
+            }
+        });
+        if (!compressed) return false;
+        columns_[index] = std::move(compressed);
+        return true;
+    }
+
+    inline void data_frame::decompress(const std::string& name) {
+        size_t index = column_position(name);
+        const IColumn& col = *columns_[index];
+        if (dynamic_cast<const dictionary_column*>(&col)) {
+            auto plain = std::make_shared<data_column<std::string>>(name);
+            plain->append(static_cast<const typed_column<std::string>&>(col).values(), col.validity());
+            columns_[index] = std::move(plain);
+        }
+        else if (col.type() != data_type::boolean) {
+            visit_column(col, [&](const auto& typed) {
+                using T = typename std::decay_t<decltype(typed)>::value_type;
+                if (dynamic_cast<const compressed_column<T>*>(&col)) columns_[index] = col.clone();
+            });
+        }
+    }
+
+} // namespace framework
@@ -0,0 +1,438 @@
+#pragma once
+
+#include "data_frame.hpp"
+#include "mapped_file.hpp"
+#include "simd.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+namespace framework {
+
+    struct csv_options {
+        char delimiter = ',';
+        char quote = '"';
+        bool header = true;                                // first line holds the column names
+        std::vector<std::string> names;                    // used when header is false (default c0, c1, ...)
+        std::unordered_map<std::string, data_type> types;  // fixed column types; the rest are inferred
+        std::vector<std::string> columns;                  // parse only these (default all); others are skipped
+        size_t infer_rows = 1000;                          // rows sampled for type inference
+        thread_pool* pool = nullptr;                       // parse chunks in parallel
+        size_t min_chunk_bytes = size_t{ 1 } << 20;
+        double dictionary_ratio = 0.5;                     // dictionary-encode string columns with at most
+                                                           // this share of distinct values (0 disables)
+    };
+
+    namespace detail {
+        // Positions of delimiter, quote and '\n' bytes in a 64-byte block, one bit per byte
+        struct csv_masks {
+            std::uint64_t delim;
+            std::uint64_t quote;
+            std::uint64_t newline;
+        };
+
+        inline csv_masks csv_classify_scalar(const char* p, char delim, char quote) {
+            csv_masks m{ 0, 0, 0 };
+            for (unsigned i = 0; i < 64; ++i) {
+                m.delim |= static_cast<std::uint64_t>(p[i] == delim) << i;
+                m.quote |= static_cast<std::uint64_t>(p[i] == quote) << i;
+                m.newline |= static_cast<std::uint64_t>(p[i] == '\n') << i;
+            }
+            return m;
+        }
+
+#ifdef FRAMEWORK_SIMD_X86
+        FRAMEWORK_TARGET_SSE2 inline csv_masks csv_classify_sse2(const char* p, char delim, char quote) {
+            const __m128i d = _mm_set1_epi8(delim), q = _mm_set1_epi8(quote), n = _mm_set1_epi8('\n');
+            csv_masks m{ 0, 0, 0 };
+            for (unsigned i = 0; i < 64; i += 16) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+                m.delim |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, d)))) << i;
+                m.quote |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, q)))) << i;
+                m.newline |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, n)))) << i;
+            }
+            return m;
+        }
+
+        FRAMEWORK_TARGET_AVX2 inline std::uint64_t eq_mask_avx2(__m256i lo, __m256i hi, __m256i c) {
+            return static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, c))))
+                | static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, c)))) << 32;
+        }
+
+        FRAMEWORK_TARGET_AVX2 inline csv_masks csv_classify_avx2(const char* p, char delim, char quote) {
+            const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+            return csv_masks{
+                eq_mask_avx2(lo, hi, _mm256_set1_epi8(delim)),
+                eq_mask_avx2(lo, hi, _mm256_set1_epi8(quote)),
+                eq_mask_avx2(lo, hi, _mm256_set1_epi8('\n')) };
+        }
+#endif
+
+        using csv_classify_fn = csv_masks(*)(const char*, char, char);
+
+        inline csv_classify_fn csv_classifier() {
+            return simd::select<csv_classify_fn>(FRAMEWORK_SIMD_VARIANTS(csv_classify));
+        }
+
+        // Calls on_field(begin, end, end_of_row) for every field of [begin, end), which must start
+        // outside quotes. Structural bytes are located 64 at a time; only set bits are visited.
+        // Returns false if on_field asked to stop.
+        template<typename F>
+        bool csv_scan(const char* begin, const char* end, char delim, char quote, F&& on_field) {
+            const csv_classify_fn classify = csv_classifier();
+            bool in_quote = false;
+            const char* field = begin;
+            char tail[64];
+            for (const char* block = begin; block < end; block += 64) {
+                const size_t len = static_cast<size_t>(std::min<std::ptrdiff_t>(64, end - block));
+                const char* src = block;
+                if (len < 64) {
+                    std::memcpy(tail, block, len);
+                    std::memset(tail + len, 0, 64 - len);
+                    src = tail;
+                }
+                csv_masks m = classify(src, delim, quote);
+                std::uint64_t bits = m.delim | m.quote | m.newline;
+                if (len < 64) bits &= (std::uint64_t{ 1 } << len) - 1;
+                while (bits) {
+                    unsigned i = static_cast<unsigned>(std::countr_zero(bits));
+                    bits &= bits - 1;
+                    if ((m.quote >> i) & 1) { in_quote = !in_quote; continue; }
+                    if (in_quote) continue;
+                    bool row_end = (m.newline >> i) & 1;
+                    if (!on_field(field, block + i, row_end)) return false;
+                    field = block + i + 1;
+                }
+            }
+            if (field < end) return on_field(field, end, true);
+            return true;
+        }
+
+        // Number of quote bytes in [begin, end), for quote parity at chunk boundaries
+        inline size_t csv_count_quotes(const char* begin, const char* end, char quote) {
+            size_t count = 0;
+            const csv_classify_fn classify = csv_classifier();
+            const char* p = begin;
+            for (; end - p >= 64; p += 64) count += static_cast<size_t>(std::popcount(classify(p, quote, quote).quote));
+            return count + static_cast<size_t>(std::count(p, end, quote));
+        }
+
+        // Strips the surrounding quotes and undoubles "" inside a quoted field
+        inline std::string_view csv_unquote(std::string_view f, char quote, std::string& scratch) {
+            if (f.size() < 2 || f.front() != quote || f.back() != quote) return f;
+            f = f.substr(1, f.size() - 2);
+            if (f.find(quote) == std::string_view::npos) return f;
+            scratch.clear();
+            for (size_t i = 0; i < f.size(); ++i) {
+                scratch.push_back(f[i]);
+                if (f[i] == quote && i + 1 < f.size() && f[i + 1] == quote) ++i;
+            }
+            return scratch;
+        }
+
+        inline bool csv_parse(std::string_view f, int& out) {
+            if (!f.empty() && f.front() == '+') f.remove_prefix(1);
+            auto [p, ec] = std::from_chars(f.data(), f.data() + f.size(), out);
+            return ec == std::errc() && p == f.data() + f.size();
+        }
+
+        inline bool csv_parse(std::string_view f, std::int64_t& out) {
+            if (!f.empty() && f.front() == '+') f.remove_prefix(1);
+            auto [p, ec] = std::from_chars(f.data(), f.data() + f.size(), out);
+            return ec == std::errc() && p == f.data() + f.size();
+        }
+
+        inline bool csv_parse(std::string_view f, timestamp& out) { return parse_timestamp(f, out); }
+
+        inline bool csv_parse(std::string_view f, double& out) {
+            if (!f.empty() && f.front() == '+') f.remove_prefix(1);
+            auto [p, ec] = std::from_chars(f.data(), f.data() + f.size(), out);
+            return ec == std::errc() && p == f.data() + f.size();
+        }
+
+        inline bool csv_parse(std::string_view f, bool& out) {
+            auto is = [&](std::string_view word) {
+                return f.size() == word.size() && std::equal(f.begin(), f.end(), word.begin(),
+                    [](char a, char b) { return (a | 0x20) == b; });
+            };
+            if (f == "1" || is("true")) { out = true; return true; }
+            if (f == "0" || is("false")) { out = false; return true; }
+            return false;
+        }
+
+        // Where a chunk writes each column: straight into the final vector at the chunk's first
+        // row, except bool, whose packed bits cannot be written concurrently. monostate: skipped.
+        using csv_target = std::variant<int*, double*, std::string*, std::vector<bool>*, std::monostate,
+            std::int64_t*, timestamp*>;
+
+        struct csv_chunk {
+            const char* begin = nullptr;
+            const char* end = nullptr;
+            size_t first_row = 0;
+            size_t rows = 0;
+            std::vector<csv_target> targets;
+            std::vector<std::vector<bool>> bools; // per column, used by bool columns only
+            std::vector<std::vector<size_t>> nulls; // per column, chunk rows with an empty field
+        };
+
+        // Rows in [begin, end), not counting blank lines
+        inline size_t csv_count_rows(const char* begin, const char* end, const csv_options& opts) {
+            size_t rows = 0, col = 0;
+            csv_scan(begin, end, opts.delimiter, opts.quote, [&](const char* b, const char* e, bool row_end) {
+                if (!row_end) { ++col; return true; }
+                if (e > b && e[-1] == '\r') --e;
+                if (col != 0 || e != b) ++rows;
+                col = 0;
+                return true;
+            });
+            return rows;
+        }
+
+        // Parses the rows of a chunk into its targets. Empty (unquoted) fields are recorded as
+        // nulls; anything else that does not parse throws.
+        inline void csv_parse_chunk(csv_chunk& chunk, const std::vector<std::string>& names, const csv_options& opts,
+            const char* file_begin) {
+            const size_t ncols = chunk.targets.size();
+            size_t col = 0, row = 0;
+            std::string scratch;
+            auto fail = [&](const std::string& what, const char* at) {
+                throw std::runtime_error("CSV " + what + " at byte " + std::to_string(at - file_begin));
+            };
+            csv_scan(chunk.begin, chunk.end, opts.delimiter, opts.quote, [&](const char* b, const char* e, bool row_end) {
+                if (row_end && e > b && e[-1] == '\r') --e;
+                if (row_end && col == 0 && e == b) return true; // blank line
+                if (col >= ncols) fail("row with too many fields", b);
+                if (!std::holds_alternative<std::monostate>(chunk.targets[col])) {
+                    if (e == b) chunk.nulls[col].push_back(row);
+                    std::string_view f = csv_unquote(std::string_view(b, static_cast<size_t>(e - b)), opts.quote, scratch);
+                    std::visit([&](auto target) {
+                        using P = decltype(target);
+                        if constexpr (std::is_same_v<P, std::monostate>) {
+                        }
+                        else if constexpr (std::is_same_v<P, std::string*>) {
+                            target[row].assign(f);
+                        }
+                        else {
+                            using T = std::conditional_t<std::is_same_v<P, std::vector<bool>*>, bool, std::remove_pointer_t<P>>;
+                            T v{};
+                            if (!f.empty() && !csv_parse(f, v)) fail("value '" + std::string(f) + "' in column " + names[col] + " does not parse", b);
+                            if constexpr (std::is_same_v<T, bool>) target->push_back(v);
+                            else target[row] = v;
+                        }
+                    }, chunk.targets[col]);
+                }
+                if (!row_end) { ++col; return true; }
+                if (col + 1 != ncols) fail("row with too few fields", b);
+                col = 0;
+                ++row;
+                return true;
+            });
+        }
+
+        template<typename T>
+        csv_target csv_make_column(const std::string& name, size_t rows, std::shared_ptr<IColumn>& out) {
+            auto col = std::make_shared<data_column<T>>(name);
+            out = col;
+            if constexpr (std::is_same_v<T, bool>) {
+                col->data.reserve(rows);
+                return &col->data;
+            }
+            else {
+                col->data.resize(rows);
+                return col->data.data();
+            }
+        }
+
+        // Runs f(0) .. f(n - 1), on the pool when there is one and more than one task
+        template<typename F>
+        void csv_run(thread_pool* pool, size_t n, F&& f) {
+            if (!pool || n < 2) {
+                for (size_t i = 0; i < n; ++i) f(i);
+                return;
+            }
+            std::vector<std::future<void>> done;
+            for (size_t i = 0; i < n; ++i) done.push_back(pool->enqueue([&f, i] { f(i); }));
+            for (auto& d : done) d.wait();
+            for (auto& d : done) d.get();
+        }
+
+        // Narrowest type that fits every non-empty sample: int32, int64, float64, boolean,
+        // timestamp (ISO 8601, see parse_timestamp), else string
+        inline std::vector<data_type> csv_infer(const char* begin, const char* end, size_t ncols, const csv_options& opts) {
+            enum : unsigned { can_int = 1, can_double = 2, can_bool = 4, can_int64 = 8, can_timestamp = 16 };
+            std::vector<unsigned> fits(ncols, can_int | can_double | can_bool | can_int64 | can_timestamp);
+            std::vector<bool> seen(ncols, false);
+            size_t col = 0, rows = 0;
+            std::string scratch;
+            csv_scan(begin, end, opts.delimiter, opts.quote, [&](const char* b, const char* e, bool row_end) {
+                if (row_end && e > b && e[-1] == '\r') --e;
+                if (col < ncols && e > b) {
+                    std::string_view f = csv_unquote(std::string_view(b, static_cast<size_t>(e - b)), opts.quote, scratch);
+                    int i; std::int64_t l; double d; bool x; timestamp t;
+                    if (!csv_parse(f, i)) fits[col] &= ~can_int;
+                    if (!csv_parse(f, l)) fits[col] &= ~can_int64;
+                    if (!csv_parse(f, t)) fits[col] &= ~can_timestamp;
+                    if (!csv_parse(f, d)) fits[col] &= ~can_double;
+                    if (!csv_parse(f, x) || f == "0" || f == "1") fits[col] &= ~can_bool;
+                    seen[col] = true;
+                }
+                if (!row_end) { ++col; return true; }
+                col = 0;
+                return ++rows < opts.infer_rows;
+            });
+            std::vector<data_type> types(ncols, data_type::string);
+            for (size_t c = 0; c < ncols; ++c) {
+                if (!seen[c]) continue;
+                if (fits[c] & can_int) types[c] = data_type::int32;
+                else if (fits[c] & can_int64) types[c] = data_type::int64;
+                else if (fits[c] & can_double) types[c] = data_type::float64;
+                else if (fits[c] & can_bool) types[c] = data_type::boolean;
+                else if (fits[c] & can_timestamp) types[c] = data_type::timestamp;
+            }
+            return types;
+        }
+
+        // Splits [begin, end) into about n ranges of whole rows. Quote parity at each raw split
+        // point comes from counting quotes per range, so quoted newlines never split a row.
+        inline std::vector<std::pair<const char*, const char*>> csv_split(const char* begin, const char* end, size_t n,
+            const csv_options& opts) {
+            std::vector<std::pair<const char*, const char*>> ranges;
+            const size_t size = static_cast<size_t>(end - begin);
+            std::vector<const char*> raw(n + 1);
+            for (size_t k = 0; k <= n; ++k) raw[k] = begin + size * k / n;
+
+            std::vector<size_t> quotes(n, 0);
+            csv_run(opts.pool, n, [&](size_t k) { quotes[k] = csv_count_quotes(raw[k], raw[k + 1], opts.quote); });
+
+            const char* start = begin;
+            size_t parity = 0;
+            for (size_t k = 1; k < n; ++k) {
+                parity += quotes[k - 1];
+                const char* p = raw[k];
+                if (p < start) continue;
+                bool in_quote = parity % 2 != 0;
+                for (; p < end; ++p) {
+                    if (*p == opts.quote) in_quote = !in_quote;
+                    else if (*p == '\n' && !in_quote) break;
+                }
+                if (p == end) break;
+                ranges.emplace_back(start, p + 1);
+                start = p + 1;
+            }
+            if (start < end) ranges.emplace_back(start, end);
+            return ranges;
+        }
+    }
+
+    // Reads a CSV file into typed columns. The file is memory-mapped and structural bytes are
+    // found with SIMD. Rows are split into chunks that are counted, then parsed (in parallel
+    // with opts.pool) straight into their slice of each pre-sized data_column<T> vector.
+    inline data_frame read_csv(const std::filesystem::path& path, const csv_options& opts = {}) {
+        mapped_file file(path);
+        file.advise_sequential();
+        const char* begin = reinterpret_cast<const char*>(file.data());
+        const char* end = begin + file.size();
+        if (end - begin >= 3 && std::memcmp(begin, "\xEF\xBB\xBF", 3) == 0) begin += 3;
+
+        // Header or first row decides the column count
+        std::vector<std::string> names;
+        const char* data = begin;
+        {
+            std::string scratch;
+            detail::csv_scan(begin, end, opts.delimiter, opts.quote, [&](const char* b, const char* e, bool row_end) {
+                if (row_end && e > b && e[-1] == '\r') --e;
+                names.emplace_back(detail::csv_unquote(std::string_view(b, static_cast<size_t>(e - b)), opts.quote, scratch));
+                data = e < end && *e == '\r' ? e + 2 : e + 1;
+                return !row_end;
+            });
+            data = std::min(data, end);
+        }
+        if (names.empty()) return data_frame{};
+        if (!opts.header) {
+            data = begin;
+            for (size_t c = 0; c < names.size(); ++c)
+                names[c] = c < opts.names.size() ? opts.names[c] : "c" + std::to_string(c);
+        }
+
+        auto types = detail::csv_infer(data, end, names.size(), opts);
+        for (size_t c = 0; c < names.size(); ++c)
+            if (auto it = opts.types.find(names[c]); it != opts.types.end()) types[c] = it->second;
+
+        size_t tasks = 1;
+        if (opts.pool) tasks = std::clamp<size_t>(static_cast<size_t>(end - data) / std::max<size_t>(opts.min_chunk_bytes, 1), 1, opts.pool->size() * 4);
+        auto ranges = detail::csv_split(data, end, tasks, opts);
+
+        std::vector<detail::csv_chunk> chunks(ranges.size());
+        for (size_t i = 0; i < ranges.size(); ++i) std::tie(chunks[i].begin, chunks[i].end) = ranges[i];
+        detail::csv_run(opts.pool, chunks.size(), [&](size_t i) { chunks[i].rows = detail::csv_count_rows(chunks[i].begin, chunks[i].end, opts); });
+        size_t total = 0;
+        for (auto& chunk : chunks) {
+            chunk.first_row = total;
+            total += chunk.rows;
+        }
+
+        const size_t ncols = names.size();
+        std::vector<bool> keep(ncols, opts.columns.empty());
+        for (const auto& name : opts.columns) {
+            auto it = std::find(names.begin(), names.end(), name);
+            if (it == names.end()) throw std::runtime_error("Unknown column: " + name);
+            keep[it - names.begin()] = true;
+        }
+
+        std::vector<std::shared_ptr<IColumn>> columns(ncols);
+        std::vector<detail::csv_target> bases(ncols);
+        for (size_t c = 0; c < ncols; ++c) {
+            if (!keep[c]) {
+                bases[c] = std::monostate{};
+                continue;
+            }
+            switch (types[c]) {
+            case data_type::int32: bases[c] = detail::csv_make_column<int>(names[c], total, columns[c]); break;
+            case data_type::float64: bases[c] = detail::csv_make_column<double>(names[c], total, columns[c]); break;
+            case data_type::boolean: bases[c] = detail::csv_make_column<bool>(names[c], total, columns[c]); break;
+            case data_type::string: bases[c] = detail::csv_make_column<std::string>(names[c], total, columns[c]); break;
+            case data_type::int64: bases[c] = detail::csv_make_column<std::int64_t>(names[c], total, columns[c]); break;
+            case data_type::timestamp: bases[c] = detail::csv_make_column<timestamp>(names[c], total, columns[c]); break;
+            }
+        }
+        for (auto& chunk : chunks) {
+            chunk.bools.resize(ncols);
+            chunk.nulls.resize(ncols);
+            for (size_t c = 0; c < ncols; ++c) {
+                chunk.targets.push_back(std::visit([&](auto base) -> detail::csv_target {
+                    if constexpr (std::is_same_v<decltype(base), std::monostate>) return base;
+                    else if constexpr (std::is_same_v<decltype(base), std::vector<bool>*>) return &chunk.bools[c];
+                    else return base + chunk.first_row;
+                }, bases[c]));
+            }
+        }
+        detail::csv_run(opts.pool, chunks.size(), [&](size_t i) { detail::csv_parse_chunk(chunks[i], names, opts, begin); });
+
+        data_frame df;
+        for (size_t c = 0; c < ncols; ++c) {
+            if (!keep[c]) continue;
+            if (auto* bits = std::get_if<std::vector<bool>*>(&bases[c]))
+                for (auto& chunk : chunks) (*bits)->insert((*bits)->end(), chunk.bools[c].begin(), chunk.bools[c].end());
+            for (auto& chunk : chunks)
+                for (size_t r : chunk.nulls[c]) columns[c]->set_null(chunk.first_row + r);
+            df.add_column(names[c], columns[c]);
+            if (types[c] == data_type::string && opts.dictionary_ratio > 0) df.dictionary_encode(names[c], opts.dictionary_ratio);
+        }
+        return df;
+    }
+
+} // namespace framework
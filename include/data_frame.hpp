@@ -1,16 +1,183 @@
 #pragma once
+#include "column_kernels.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <array>
+#include <bit>
+#include <ranges>
+#include <tuple>
+#include <utility>
+#include <numeric>
+#include <optional>
 #include <variant>
+#include <span>
 #include <stdexcept>
+#include <type_traits>
 #include <variant>
 
 namespace framework {
 
-    using data_value = std::variant<int, double, std::string, bool>;
+    // Nanoseconds since the Unix epoch (UTC). Converts to and from framework::datetime and
+    // takes chrono durations directly: ts + std::chrono::minutes(5).
+    using timestamp = std::chrono::sys_time<std::chrono::nanoseconds>;
+
+    using data_value = std::variant<int, double, std::string, bool, std::int64_t, timestamp>;
+
+    // Element type of a column, one per data_value alternative. The values are stored in
+    // columnar files, so new types are only ever appended.
+    enum class data_type { int32, float64, string, boolean, int64, timestamp };
+
+    template<typename T> struct data_type_of;
+    template<> struct data_type_of<int> { static constexpr data_type value = data_type::int32; };
+    template<> struct data_type_of<double> { static constexpr data_type value = data_type::float64; };
+    template<> struct data_type_of<std::string> { static constexpr data_type value = data_type::string; };
+    template<> struct data_type_of<bool> { static constexpr data_type value = data_type::boolean; };
+    template<> struct data_type_of<std::int64_t> { static constexpr data_type value = data_type::int64; };
+    template<> struct data_type_of<timestamp> { static constexpr data_type value = data_type::timestamp; };
+
+    namespace detail {
+        // ISO 8601 in UTC, fraction only as long as needed: 2024-03-01T09:30:00.25Z
+        inline std::string format_timestamp(timestamp t) {
+            auto days = std::chrono::floor<std::chrono::days>(t);
+            std::chrono::year_month_day ymd{ days };
+            std::chrono::hh_mm_ss<std::chrono::nanoseconds> hms{ t - days };
+            char buf[48];
+            int n = std::snprintf(buf, sizeof(buf), "%04d-%02u-%02uT%02d:%02d:%02d", static_cast<int>(ymd.year()),
+                static_cast<unsigned>(ymd.month()), static_cast<unsigned>(ymd.day()), static_cast<int>(hms.hours().count()),
+                static_cast<int>(hms.minutes().count()), static_cast<int>(hms.seconds().count()));
+            std::string out(buf, static_cast<size_t>(n));
+            if (auto ns = hms.subseconds().count()) {
+                std::snprintf(buf, sizeof(buf), ".%09lld", static_cast<long long>(ns));
+                std::string_view frac(buf);
+                out += frac.substr(0, frac.find_last_not_of('0') + 1);
+            }
+            return out + "Z";
+        }
+
+        // YYYY-MM-DD, optionally followed by 'T' or ' ' and HH:MM[:SS[.fraction]], optionally
+        // ending in 'Z'; read as UTC. Fraction digits past nanoseconds are ignored.
+        inline bool parse_timestamp(std::string_view s, timestamp& out) {
+            auto number = [&](size_t at, size_t len, int& v) {
+                if (at + len > s.size()) return false;
+                v = 0;
+                for (size_t i = at; i < at + len; ++i) {
+                    if (s[i] < '0' || s[i] > '9') return false;
+                    v = v * 10 + (s[i] - '0');
+                }
+                return true;
+            };
+            int y, mo, d, h = 0, mi = 0, sec = 0;
+            if (!number(0, 4, y) || s.size() < 10 || s[4] != '-' || !number(5, 2, mo) || s[7] != '-' || !number(8, 2, d)) return false;
+            std::chrono::year_month_day ymd{ std::chrono::year(y), std::chrono::month(static_cast<unsigned>(mo)), std::chrono::day(static_cast<unsigned>(d)) };
+            if (!ymd.ok()) return false;
+            size_t at = 10;
+            std::int64_t frac = 0;
+            if (at < s.size() && (s[at] == 'T' || s[at] == ' ')) {
+                if (!number(at + 1, 2, h) || at + 6 > s.size() || s[at + 3] != ':' || !number(at + 4, 2, mi)) return false;
+                at += 6;
+                if (at < s.size() && s[at] == ':') {
+                    if (!number(at + 1, 2, sec)) return false;
+                    at += 3;
+                    if (at < s.size() && s[at] == '.') {
+                        int digits = 0;
+                        for (++at; at < s.size() && s[at] >= '0' && s[at] <= '9'; ++at)
+                            if (digits < 9) { frac = frac * 10 + (s[at] - '0'); ++digits; }
+                        if (digits == 0) return false;
+                        for (; digits < 9; ++digits) frac *= 10;
+                    }
+                }
+                if (h > 23 || mi > 59 || sec > 60) return false;
+            }
+            if (at < s.size() && s[at] == 'Z') ++at;
+            if (at != s.size()) return false;
+            out = std::chrono::sys_days(ymd) + std::chrono::hours(h) + std::chrono::minutes(mi) + std::chrono::seconds(sec)
+                + std::chrono::nanoseconds(frac);
+            return true;
+        }
+    }
+
+    // Row index standing for "no row", e.g. the right side of an unmatched left join row
+    inline constexpr size_t no_row = static_cast<size_t>(-1);
+
+    // Arrow-layout validity: bit i of 64-bit word i / 64 (LSB first) is set when row i holds a
+    // value. Nothing is allocated until the first null, so columns without nulls pay nothing.
+    class validity_bitmap {
+        std::vector<std::uint64_t> words_;
+        size_t size_ = 0;
+
+        // Covers rows [0, rows), rows not yet covered being valid
+        void extend(size_t rows) {
+            if (rows <= size_) return;
+            words_.resize(kernels::mask_words(rows), 0);
+            for (size_t r = size_; r < rows;) {
+                if (r % 64 == 0 && rows - r >= 64) { words_[r / 64] = ~std::uint64_t{ 0 }; r += 64; }
+                else { words_[r / 64] |= std::uint64_t{ 1 } << (r % 64); ++r; }
+            }
+            size_ = rows;
+        }
+
+    public:
+        bool has_nulls() const { return !words_.empty(); }
+
+        // Bitmap over rows rows, or nullptr when every row is valid
+        const std::uint64_t* data(size_t rows) const {
+            if (words_.empty()) return nullptr;
+            if (size_ < rows) throw std::runtime_error("Validity bitmap out of step with column; append nulls through the column");
+            return words_.data();
+        }
+
+        bool valid(size_t row) const { return row >= size_ || ((words_[row / 64] >> (row % 64)) & 1); }
+
+        // rows is the column length; appends that bypassed the bitmap are taken as valid
+        void set(size_t row, bool valid, size_t rows) {
+            if (valid && words_.empty()) return;
+            extend(rows);
+            if (valid) words_[row / 64] |= std::uint64_t{ 1 } << (row % 64);
+            else words_[row / 64] &= ~(std::uint64_t{ 1 } << (row % 64));
+        }
+
+        // rows is the column length before the append
+        void push_back(bool valid, size_t rows) {
+            if (valid && words_.empty()) return;
+            extend(rows + 1);
+            if (!valid) words_[rows / 64] &= ~(std::uint64_t{ 1 } << (rows % 64));
+        }
+
+        // Appends n rows valid where bits [0, n) of source are set (nullptr: all valid)
+        void append(const std::uint64_t* source, size_t n, size_t rows) {
+            if (kernels::count_valid(source, n) == n) {
+                if (!words_.empty()) extend(rows + n);
+                return;
+            }
+            extend(rows + n);
+            for (size_t w = 0; w < kernels::mask_words(n); ++w) {
+                std::uint64_t nulls = ~source[w];
+                if (w == n / 64) nulls &= (std::uint64_t{ 1 } << (n % 64)) - 1;
+                for (; nulls; nulls &= nulls - 1) {
+                    size_t r = rows + w * 64 + static_cast<size_t>(std::countr_zero(nulls));
+                    words_[r / 64] &= ~(std::uint64_t{ 1 } << (r % 64));
+                }
+            }
+        }
+
+        void reserve(size_t rows) { if (!words_.empty()) words_.reserve(kernels::mask_words(rows)); }
+
+        // Takes over a bitmap of mask_words(rows) words
+        void assign(std::vector<std::uint64_t> words, size_t rows) {
+            words_ = std::move(words);
+            size_ = rows;
+        }
+    };
 
     // Base column interface
     struct IColumn {
@@ -19,31 +186,525 @@ namespace framework {
         virtual void set(size_t row, const data_value& val) = 0;
         virtual void push_back(const data_value& val) = 0;
         virtual size_t size() const = 0;
+        virtual data_type type() const = 0;
+        // New column holding the given rows, in order; no_row yields a null
+        virtual std::shared_ptr<IColumn> gather(std::span<const size_t> rows) const = 0;
+
+        // Validity bitmap (see validity_bitmap), or nullptr when the column has no nulls.
+        // Null rows read as a default value through get() and values().
+        virtual const std::uint64_t* validity() const { return nullptr; }
+        virtual void set_null(size_t) { throw std::runtime_error("Column does not support nulls"); }
+        virtual void push_null() { throw std::runtime_error("Column does not support nulls"); }
+        virtual void reserve(size_t) {}
+
+        // Whether the column reads storage it does not own (a slice_column, a mapping);
+        // data_frame replaces such columns by an owned copy before writing to them
+        virtual bool shares_storage() const { return false; }
+
+        // Owned copy of the whole column, which copy-on-write writes go to
+        virtual std::shared_ptr<IColumn> clone() const {
+            std::vector<size_t> rows(size());
+            std::iota(rows.begin(), rows.end(), size_t{ 0 });
+            return gather(rows);
+        }
+
+        bool is_null(size_t row) const {
+            auto* valid = validity();
+            return valid && !((valid[row / 64] >> (row % 64)) & 1);
+        }
+        size_t null_count() const { return size() - kernels::count_valid(validity(), size()); }
+    };
+
+    // Column with contiguous values of T; values() bypasses data_value entirely
+    template<typename T>
+    struct typed_column : IColumn {
+        using value_type = T;
+
+        // Invalidated by appends, like vector iterators
+        virtual std::span<const T> values() const = 0;
+    };
+
+    // Column held in an encoded form (compressed_column in compression.hpp) that answers
+    // aggregations and comparisons from the encoding; values() has to decode all of it
+    template<typename T>
+    struct encoded_column : typed_column<T> {
+        // Over the valid rows, as kernels::sum / min / max
+        virtual kernels::detail::sum_t<T> sum() const = 0;
+        virtual std::optional<T> min() const = 0;
+        virtual std::optional<T> max() const = 0;
+        // Over rows [begin, end), begin a multiple of 64: out (mask_words(end - begin) words)
+        // gets bit i = value begin + i op rhs; null rows' bits are unspecified
+        virtual void compare(kernels::compare_op op, const T& rhs, size_t begin, size_t end, std::uint64_t* out) const = 0;
     };
 
-    // Typed column
+    // Typed column. Nulls are tracked in validity_bits; rows appended to data directly are
+    // valid, so a column with nulls should grow through push_back/push_null.
     template<typename T>
-    struct data_column : IColumn {
+    struct data_column : typed_column<T> {
         std::string name;
         std::vector<T> data;
+        validity_bitmap validity_bits;
 
         data_column(const std::string& n) : name(n) {}
 
         data_value get(size_t row) const override { return data.at(row); }
-        void set(size_t row, const data_value& val) override { data.at(row) = std::get<T>(val); }
-        void push_back(const data_value& val) override { data.push_back(std::get<T>(val)); }
+        void set(size_t row, const data_value& val) override {
+            data.at(row) = std::get<T>(val);
+            validity_bits.set(row, true, data.size());
+        }
+        void push_back(const data_value& val) override { push_valid(std::get<T>(val)); }
         size_t size() const override { return data.size(); }
+        data_type type() const override { return data_type_of<T>::value; }
+
+        const std::uint64_t* validity() const override { return validity_bits.data(data.size()); }
+        void set_null(size_t row) override {
+            data.at(row) = T{};
+            validity_bits.set(row, false, data.size());
+        }
+        void push_null() override {
+            validity_bits.push_back(false, data.size());
+            data.push_back(T{});
+        }
+
+        void push_valid(T val) {
+            validity_bits.push_back(true, data.size());
+            data.push_back(std::move(val));
+        }
+
+        // Bulk append; validity as in validity_bitmap::append, null rows holding any value
+        void append(std::span<const T> values, const std::uint64_t* validity = nullptr) {
+            validity_bits.append(validity, values.size(), data.size());
+            data.insert(data.end(), values.begin(), values.end());
+        }
+
+        void reserve(size_t rows) override {
+            data.reserve(rows);
+            validity_bits.reserve(rows);
+        }
+
+        std::shared_ptr<IColumn> clone() const override { return std::make_shared<data_column<T>>(*this); }
+
+        std::shared_ptr<IColumn> gather(std::span<const size_t> rows) const override {
+            auto out = std::make_shared<data_column<T>>(name);
+            out->data.reserve(rows.size());
+            for (size_t r : rows) {
+                if (r == no_row || !validity_bits.valid(r)) out->push_null();
+                else out->push_valid(data[r]);
+            }
+            return out;
+        }
+
+        std::span<const T> values() const override {
+            if constexpr (std::is_same_v<T, bool>) throw std::runtime_error("bool columns are bit-packed");
+            else return data;
+        }
     };
 
+    // Unique values of a dictionary-encoded column; code i stands for values[i]
+    struct string_dictionary {
+        struct hash {
+            using is_transparent = void;
+            size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+        };
+
+        std::vector<std::string> values;
+        std::unordered_map<std::string, int, hash, std::equal_to<>> index;
+
+        // Code of s, or -1 when s is not in the dictionary
+        int find(std::string_view s) const {
+            auto it = index.find(s);
+            return it == index.end() ? -1 : it->second;
+        }
+
+        int insert(std::string_view s) {
+            auto it = index.find(s);
+            if (it != index.end()) return it->second;
+            int code = static_cast<int>(values.size());
+            values.emplace_back(s);
+            index.emplace(values.back(), code);
+            return code;
+        }
+    };
+
+    namespace detail {
+        // Validity of rows [offset, offset + size) of a column: a pointer into valid when the
+        // offset is word aligned, else the bits shifted into `shifted`
+        inline const std::uint64_t* slice_validity(const std::uint64_t* valid, size_t source_rows, size_t offset, size_t size,
+            std::vector<std::uint64_t>& shifted) {
+            if (!valid || offset % 64 == 0) return valid ? valid + offset / 64 : nullptr;
+            const size_t shift = offset % 64, source_words = kernels::mask_words(source_rows);
+            shifted.resize(kernels::mask_words(size));
+            for (size_t w = 0, from = offset / 64; w < shifted.size(); ++w, ++from) {
+                std::uint64_t bits = valid[from] >> shift;
+                if (from + 1 < source_words) bits |= valid[from + 1] << (64 - shift);
+                shifted[w] = bits;
+            }
+            return shifted.data();
+        }
+    }
+
+    // String column stored as int codes into a shared dictionary of unique values. Reports
+    // data_type::string; operators that know about it (filter, group_by, join) work on the
+    // codes, everything else sees strings. values() decodes the column once and caches it,
+    // extending the cache as rows are appended. A slice is a read-only view of another
+    // column's codes that shares its dictionary.
+    class dictionary_column : public typed_column<std::string> {
+        std::shared_ptr<string_dictionary> dict_;
+        std::vector<int> codes_;
+        validity_bitmap validity_bits_;
+        std::shared_ptr<const dictionary_column> source_; // a slice reads source_'s rows [offset_, offset_ + size_)
+        size_t offset_ = 0, size_ = 0;
+        const std::uint64_t* slice_validity_ = nullptr;
+        std::vector<std::uint64_t> shifted_;
+        mutable std::mutex decode_mutex_;
+        mutable std::vector<std::string> decoded_; // decoded prefix of the rows; appends keep it
+
+        string_dictionary& own_dictionary() {
+            if (source_) throw std::runtime_error("Column slice is read-only");
+            if (dict_.use_count() > 1) dict_ = std::make_shared<string_dictionary>(*dict_);
+            return *dict_;
+        }
+
+    public:
+        std::string name;
+
+        explicit dictionary_column(const std::string& n, std::shared_ptr<string_dictionary> dict = nullptr)
+            : dict_(dict ? std::move(dict) : std::make_shared<string_dictionary>()), name(n) {
+        }
+
+        // Rows [offset, offset + size) of source without copying its codes
+        dictionary_column(std::shared_ptr<const dictionary_column> source, size_t offset, size_t size)
+            : dict_(source->dict_), source_(std::move(source)), offset_(offset), size_(size), name(source_->name) {
+            slice_validity_ = detail::slice_validity(source_->validity(), source_->size(), offset_, size_, shifted_);
+        }
+
+        static std::shared_ptr<dictionary_column> encode(const std::string& name, std::span<const std::string> values) {
+            auto col = std::make_shared<dictionary_column>(name);
+            col->codes_.reserve(values.size());
+            for (const auto& v : values) col->codes_.push_back(col->dict_->insert(v));
+            return col;
+        }
+
+        std::span<const int> codes() const { return source_ ? source_->codes().subspan(offset_, size_) : std::span<const int>(codes_); }
+        const std::shared_ptr<const dictionary_column>& source() const { return source_; }
+        size_t offset() const { return offset_; }
+        const std::vector<std::string>& dictionary() const { return dict_->values; }
+        bool shares_dictionary(const dictionary_column& other) const { return dict_ == other.dict_; }
+        int code_of(std::string_view s) const { return dict_->find(s); }
+        std::string_view view(size_t row) const { return dict_->values[codes()[row]]; }
+
+        void push_back(std::string_view s) {
+            int code = own_dictionary().insert(s);
+            validity_bits_.push_back(true, codes_.size());
+            codes_.push_back(code);
+        }
+
+        // Rows of another dictionary column; a shared dictionary means plain code copies
+        void append(const dictionary_column& other) {
+            if (dict_ == other.dict_) {
+                if (source_) throw std::runtime_error("Column slice is read-only");
+                auto codes = other.codes();
+                validity_bits_.append(other.validity(), other.size(), codes_.size());
+                codes_.insert(codes_.end(), codes.begin(), codes.end());
+                return;
+            }
+            for (size_t r = 0; r < other.size(); ++r) {
+                if (other.is_null(r)) push_null();
+                else push_back(other.view(r));
+            }
+        }
+
+        void reserve(size_t rows) override {
+            if (source_) return;
+            codes_.reserve(rows);
+            validity_bits_.reserve(rows);
+        }
+
+        data_value get(size_t row) const override {
+            if (row >= size()) throw std::out_of_range("Row out of range");
+            return dict_->values[codes()[row]];
+        }
+        void set(size_t row, const data_value& val) override {
+            codes_.at(row) = own_dictionary().insert(std::get<std::string>(val));
+            validity_bits_.set(row, true, codes_.size());
+            std::scoped_lock lock(decode_mutex_);
+            if (row < decoded_.size()) decoded_.resize(row);
+        }
+        void push_back(const data_value& val) override { push_back(std::string_view(std::get<std::string>(val))); }
+        size_t size() const override { return source_ ? size_ : codes_.size(); }
+        data_type type() const override { return data_type::string; }
+        bool shares_storage() const override { return source_ != nullptr; }
+
+        // Null rows hold the code of ""
+        const std::uint64_t* validity() const override { return source_ ? slice_validity_ : validity_bits_.data(codes_.size()); }
+        void set_null(size_t row) override {
+            codes_.at(row) = own_dictionary().insert("");
+            validity_bits_.set(row, false, codes_.size());
+            std::scoped_lock lock(decode_mutex_);
+            if (row < decoded_.size()) decoded_.resize(row);
+        }
+        void push_null() override {
+            int code = own_dictionary().insert("");
+            validity_bits_.push_back(false, codes_.size());
+            codes_.push_back(code);
+        }
+
+        // Shares the dictionary, so the codes stay comparable with this column's
+        std::shared_ptr<IColumn> gather(std::span<const size_t> rows) const override {
+            auto out = std::make_shared<dictionary_column>(name, dict_);
+            auto codes = this->codes();
+            out->codes_.reserve(rows.size());
+            for (size_t r : rows) {
+                if (r == no_row || is_null(r)) out->push_null();
+                else {
+                    out->validity_bits_.push_back(true, out->codes_.size());
+                    out->codes_.push_back(codes[r]);
+                }
+            }
+            return out;
+        }
+
+        // Decodes only the rows past the cached prefix, so an indexed column growing a row
+        // at a time is not decoded again from the start
+        std::span<const std::string> values() const override {
+            std::scoped_lock lock(decode_mutex_);
+            auto codes = this->codes();
+            if (decoded_.empty()) decoded_.reserve(codes.size());
+            for (size_t r = decoded_.size(); r < codes.size(); ++r) decoded_.push_back(dict_->values[codes[r]]);
+            return decoded_;
+        }
+    };
+
+    // Column resolved once from its name. Indexing is a plain vector access with no virtual
+    // call or variant; the handle stays valid across appends while the column exists.
+    template<typename T>
+    class column_handle {
+        data_column<T>* col_;
+    public:
+        explicit column_handle(data_column<T>* col) : col_(col) {}
+
+        decltype(auto) operator[](size_t row) { return col_->data[row]; }
+        decltype(auto) operator[](size_t row) const { return col_->data[row]; }
+
+        void push_back(const T& val) { col_->push_valid(val); }
+        void push_null() { col_->push_null(); }
+        size_t size() const { return col_->data.size(); }
+
+        std::vector<T>& data() { return col_->data; }
+        const std::vector<T>& data() const { return col_->data; }
+        std::span<const T> values() const { return col_->values(); }
+    };
+
+    // Typed rows for a whole frame: appender(1, 2.5, "x") pushes one value per column with no
+    // data_value or virtual call. Ts are the column types in order; like column_handle it
+    // writes to the columns in place.
+    template<typename... Ts>
+    class row_appender {
+        std::tuple<data_column<Ts>*...> columns_;
+
+        template<size_t... I>
+        void push(std::index_sequence<I...>, const Ts&... values) { (std::get<I>(columns_)->push_valid(values), ...); }
+
+    public:
+        explicit row_appender(std::tuple<data_column<Ts>*...> columns) : columns_(columns) {}
+
+        void operator()(const Ts&... values) { push(std::index_sequence_for<Ts...>{}, values...); }
+    };
+
+    // Calls f with the column downcast to typed_column<T> for its element type.
+    // Every column reporting type() X must derive from typed_column of that type.
+    template<typename F>
+    decltype(auto) visit_column(const IColumn& col, F&& f) {
+        switch (col.type()) {
+        case data_type::int32: return f(static_cast<const typed_column<int>&>(col));
+        case data_type::float64: return f(static_cast<const typed_column<double>&>(col));
+        case data_type::string: return f(static_cast<const typed_column<std::string>&>(col));
+        case data_type::int64: return f(static_cast<const typed_column<std::int64_t>&>(col));
+        case data_type::timestamp: return f(static_cast<const typed_column<timestamp>&>(col));
+        case data_type::boolean: break;
+        }
+        return f(static_cast<const typed_column<bool>&>(col));
+    }
+
+    // Rows [offset, offset + size) of another column, read in place. Read-only; the source
+    // is shared, so data_frame copies it on write rather than changing it under the slice.
+    // Validity is shared too when offset is a multiple of 64, shifted into a copy otherwise.
+    template<typename T>
+    class slice_column : public typed_column<T> {
+        std::shared_ptr<const IColumn> source_;
+        size_t offset_, size_;
+        const std::uint64_t* validity_ = nullptr;
+        std::vector<std::uint64_t> shifted_;
+
+    public:
+        slice_column(std::shared_ptr<const IColumn> source, size_t offset, size_t size)
+            : source_(std::move(source)), offset_(offset), size_(size) {
+            validity_ = detail::slice_validity(source_->validity(), source_->size(), offset_, size_, shifted_);
+        }
+
+        const std::shared_ptr<const IColumn>& source() const { return source_; }
+        size_t offset() const { return offset_; }
+
+        data_value get(size_t row) const override {
+            if (row >= size_) throw std::out_of_range("Row out of range");
+            return source_->get(offset_ + row);
+        }
+        void set(size_t, const data_value&) override { throw std::runtime_error("Column slice is read-only"); }
+        void push_back(const data_value&) override { throw std::runtime_error("Column slice is read-only"); }
+        size_t size() const override { return size_; }
+        data_type type() const override { return source_->type(); }
+        const std::uint64_t* validity() const override { return validity_; }
+        bool shares_storage() const override { return true; }
+
+        std::shared_ptr<IColumn> gather(std::span<const size_t> rows) const override {
+            std::vector<size_t> source_rows(rows.begin(), rows.end());
+            for (auto& r : source_rows) if (r != no_row) r += offset_;
+            return source_->gather(source_rows);
+        }
+
+        std::span<const T> values() const override {
+            return static_cast<const typed_column<T>&>(*source_).values().subspan(offset_, size_);
+        }
+    };
+
+    namespace detail {
+        // Copy-on-write: before a write through a frame, make its column the only owner of
+        // its storage, copying it when another frame, view or slice still reads it
+        inline IColumn& writable(std::shared_ptr<IColumn>& col) {
+            if (col.use_count() > 1 || col->shares_storage()) col = col->clone();
+            return *col;
+        }
+
+        template<typename T>
+        void append_values(IColumn& to, std::span<const T> values) {
+            if constexpr (std::is_same_v<T, std::string>) {
+                if (auto* dict = dynamic_cast<dictionary_column*>(&to)) {
+                    for (const auto& v : values) dict->push_back(std::string_view(v));
+                    return;
+                }
+            }
+            auto* col = dynamic_cast<data_column<T>*>(&to);
+            if (!col) throw std::runtime_error("Column type mismatch");
+            col->append(values);
+        }
+
+        // Rows of from appended to to (an owned column of the same type)
+        inline void append_column(IColumn& to, const IColumn& from) {
+            auto* dict = dynamic_cast<dictionary_column*>(&to);
+            auto* from_dict = dynamic_cast<const dictionary_column*>(&from);
+            if (dict && from_dict) return dict->append(*from_dict);
+            visit_column(from, [&](const auto& typed) {
+                using T = typename std::decay_t<decltype(typed)>::value_type;
+                if constexpr (std::is_same_v<T, bool>) {
+                    for (size_t r = 0; r < from.size(); ++r) {
+                        if (from.is_null(r)) to.push_null();
+                        else to.push_back(from.get(r));
+                    }
+                }
+                else {
+                    if constexpr (std::is_same_v<T, std::string>) {
+                        if (dict) {
+                            auto values = typed.values();
+                            for (size_t r = 0; r < values.size(); ++r) {
+                                if (from.is_null(r)) dict->push_null();
+                                else dict->push_back(std::string_view(values[r]));
+                            }
+                            return;
+                        }
+                    }
+                    auto* col = dynamic_cast<data_column<T>*>(&to);
+                    if (!col) throw std::runtime_error("Column type mismatch");
+                    col->append(typed.values(), from.validity());
+                }
+            });
+        }
+
+        inline std::shared_ptr<IColumn> slice(const std::shared_ptr<IColumn>& col, size_t offset, size_t size) {
+            // Dictionary columns keep their codes for filter/group_by/join: the slice views
+            // the codes and shares the dictionary
+            if (auto dict = std::dynamic_pointer_cast<const dictionary_column>(col)) {
+                if (dict->source()) return std::make_shared<dictionary_column>(dict->source(), dict->offset() + offset, size);
+                return std::make_shared<dictionary_column>(dict, offset, size);
+            }
+            return visit_column(*col, [&](const auto& typed) -> std::shared_ptr<IColumn> {
+                using T = typename std::decay_t<decltype(typed)>::value_type;
+                if (auto* s = dynamic_cast<const slice_column<T>*>(col.get()))
+                    return std::make_shared<slice_column<T>>(s->source(), s->offset() + offset, size);
+                return std::make_shared<slice_column<T>>(col, offset, size);
+            });
+        }
+    }
+
+    class predicate;
+    class expr;
+    class frame_view;
+    class grouped_frame;
+    class resampled_frame;
+    class windowed_frame;
+    class thread_pool;
+
+    // inner: matching pairs; left: also unmatched left rows (right columns null);
+    // semi/anti: left rows with / without a match, left columns only
+    enum class join_kind { inner, left, semi, anti };
+
+    // One ordering key of data_frame::sort_by(), e.g. {"ts", asc}
+    enum class sort_order { ascending, descending };
+    inline constexpr sort_order asc = sort_order::ascending;
+    inline constexpr sort_order desc = sort_order::descending;
+
+    struct sort_key {
+        std::string column;
+        sort_order order = asc;
+    };
+
+    // hash answers equality; sorted answers equality and ranges (<, <=, >, >=)
+    enum class index_kind { hash, sorted };
+
+    // Encodings of data_frame::compress(); automatic picks the smallest that applies.
+    // rle suits long runs of one value, delta sorted or slowly changing integers (time
+    // stamps, ids), frame_of_reference integers in a narrow range per block; strings
+    // compress by dictionary.
+    enum class column_encoding { automatic, rle, delta, frame_of_reference, dictionary };
+
+    // Secondary index over one column of a data_frame (implemented in index.hpp). It holds
+    // row numbers, not values, so it reads the column it was built on when queried.
+    class column_index {
+    public:
+        virtual ~column_index() = default;
+        virtual index_kind kind() const = 0;
+        // Rows [0, rows()) of the column are indexed
+        virtual size_t rows() const = 0;
+        // Indexes the rows appended since, [rows(), col.size())
+        virtual void extend(const IColumn& col) = 0;
+        virtual std::shared_ptr<column_index> clone() const = 0;
+        // Non-null rows whose value compares op against value, in no particular order. False
+        // when the index cannot answer (op or value type) or more than limit rows match.
+        virtual bool lookup(const IColumn& col, kernels::compare_op op, const data_value& value, size_t limit, std::vector<size_t>& out) const = 0;
+    };
+
+    namespace detail {
+        struct index_entry {
+            std::string column;
+            std::shared_ptr<column_index> index;
+        };
+
+        // A column written in place loses its indexes
+        inline void drop_indexes(std::vector<index_entry>& indexes, const std::string& column) {
+            std::erase_if(indexes, [&](const index_entry& e) { return e.column == column; });
+        }
+    }
+
     // Proxy to access a row
     class row_view {
         std::vector<std::shared_ptr<IColumn>>& columns_;
         std::unordered_map<std::string, size_t>& col_map_;
+        std::vector<detail::index_entry>& indexes_;
         size_t row_;
     public:
         row_view(std::vector<std::shared_ptr<IColumn>>& cols,
             std::unordered_map<std::string, size_t>& cmap,
-            size_t row) : columns_(cols), col_map_(cmap), row_(row) {
+            std::vector<detail::index_entry>& indexes,
+            size_t row) : columns_(cols), col_map_(cmap), indexes_(indexes), row_(row) {
         }
 
         data_value operator[](const std::string& col_name) const {
@@ -51,25 +712,33 @@ namespace framework {
         }
 
         void set(const std::string& col_name, const data_value& val) {
-            columns_[col_map_.at(col_name)]->set(row_, val);
+            detail::writable(columns_[col_map_.at(col_name)]).set(row_, val);
+            detail::drop_indexes(indexes_, col_name);
         }
 
         // Optional: operator[] assignment style
         struct Proxy {
-            IColumn* col;
+            std::shared_ptr<IColumn>* col;
             size_t row;
-            Proxy& operator=(const data_value& val) { col->set(row, val); return *this; }
-            operator data_value() const { return col->get(row); }
+            std::vector<detail::index_entry>* indexes;
+            std::string name;
+            Proxy& operator=(const data_value& val) {
+                detail::writable(*col).set(row, val);
+                detail::drop_indexes(*indexes, name);
+                return *this;
+            }
+            operator data_value() const { return (*col)->get(row); }
         };
 
         Proxy operator[](const std::string& col_name) {
-            return Proxy{ columns_[col_map_.at(col_name)].get(), row_ };
+            return Proxy{ &columns_[col_map_.at(col_name)], row_, &indexes_, col_name };
         }
     };
 
     class data_frame {
         std::vector<std::shared_ptr<IColumn>> columns_;
         std::unordered_map<std::string, size_t> columns_map_;
+        std::vector<detail::index_entry> indexes_;
     public:
         template<typename T>
         void addColumn(const std::string& name) {
@@ -78,18 +747,299 @@ namespace framework {
             columns_.push_back(std::make_shared<data_column<T>>(name));
         }
 
+        // Adopt an existing column (e.g. a gathered one); it must match the current row count
+        void add_column(const std::string& name, std::shared_ptr<IColumn> col) {
+            if (columns_map_.contains(name)) throw std::runtime_error("Column exists");
+            if (!columns_.empty() && col->size() != rowCount()) throw std::runtime_error("Column length mismatch");
+            columns_map_[name] = columns_.size();
+            columns_.push_back(std::move(col));
+        }
+
         void addRow(const std::vector<data_value>& row) {
             if (row.size() != columns_.size()) throw std::runtime_error("Row size mismatch");
             for (size_t i = 0; i < row.size(); ++i)
-                columns_[i]->push_back(row[i]);
+                detail::writable(columns_[i]).push_back(row[i]);
+            update_indexes();
+        }
+
+        // Capacity for rows rows in every column, so appends up to that do not reallocate
+        void reserve(size_t rows) {
+            for (auto& col : columns_) detail::writable(col).reserve(rows);
+        }
+
+        // A batch of rows as one contiguous range per column, in column order, e.g.
+        // df.append_batch(ids, prices, symbols) for a vector<int>, vector<double>, ...
+        template<typename... Columns>
+        void append_batch(const Columns&... columns) {
+            if (sizeof...(Columns) != columns_.size()) throw std::runtime_error("Row size mismatch");
+            std::array<size_t, sizeof...(Columns)> sizes{ std::ranges::size(columns)... };
+            for (size_t n : sizes)
+                if (n != sizes[0]) throw std::runtime_error("Column length mismatch");
+            size_t i = 0;
+            auto check = [&]<typename T>() {
+                if (columns_[i++]->type() != data_type_of<T>::value) throw std::runtime_error("Column type mismatch");
+            };
+            (check.template operator()<std::ranges::range_value_t<Columns>>(), ...);
+            i = 0;
+            (detail::append_values(detail::writable(columns_[i++]), std::span<const std::ranges::range_value_t<Columns>>(std::ranges::data(columns), std::ranges::size(columns))), ...);
+            update_indexes();
         }
 
+        // Typed row appender over every column (see row_appender); the columns must be
+        // plain data_columns of Ts
+        template<typename... Ts>
+        row_appender<Ts...> appender() {
+            if (sizeof...(Ts) != columns_.size()) throw std::runtime_error("Row size mismatch");
+            size_t i = 0;
+            auto resolve = [&]<typename T>() {
+                auto* col = dynamic_cast<data_column<T>*>(&detail::writable(columns_[i++]));
+                if (!col) throw std::runtime_error("Column type mismatch");
+                return col;
+            };
+            return row_appender<Ts...>(std::tuple<data_column<Ts>*...>{ resolve.template operator()<Ts>()... });
+        }
+
+        // Rows of other, whose columns must match by name, order and type. Each column is one
+        // bulk insert (dictionary columns sharing a dictionary copy codes). An empty frame
+        // takes other's columns, shared until written.
+        void append(const data_frame& other) {
+            if (&other == this) {
+                data_frame copy = other;
+                return append(copy);
+            }
+            if (columns_.empty()) {
+                *this = other;
+                return;
+            }
+            if (other.column_names() != column_names()) throw std::runtime_error("Schema mismatch");
+            for (size_t c = 0; c < columns_.size(); ++c)
+                if (columns_[c]->type() != other.columns_[c]->type()) throw std::runtime_error("Schema mismatch");
+            for (size_t c = 0; c < columns_.size(); ++c) detail::append_column(detail::writable(columns_[c]), *other.columns_[c]);
+            update_indexes();
+        }
+
+        // Secondary indexes (see column_index; built by create_index in index.hpp). filter
+        // answers comparisons on an indexed column from the index when it selects few rows,
+        // and join probes a hash index on a single right key instead of building a table.
+        // addRow, append_batch and append extend the indexes; rows added by an appender()
+        // are indexed at the next of those or update_indexes(), and until then the indexes
+        // are not used. Writing a column in place (row set, handle) drops its indexes.
+        void create_index(const std::string& column, index_kind kind = index_kind::hash);
+
+        void drop_index(const std::string& column) { detail::drop_indexes(indexes_, column); }
+
+        // The column's index of that kind if it covers every row, else nullptr
+        const column_index* find_index(const std::string& column, index_kind kind) const {
+            for (const auto& e : indexes_)
+                if (e.column == column && e.index->kind() == kind && e.index->rows() == rowCount()) return e.index.get();
+            return nullptr;
+        }
+
+        void update_indexes() {
+            for (auto& e : indexes_) {
+                const IColumn& col = *columns_[column_position(e.column)];
+                if (e.index->rows() == col.size()) continue;
+                if (e.index.use_count() > 1) e.index = e.index->clone(); // shared with a copy of the frame
+                e.index->extend(col);
+            }
+        }
+
+        // Rows where column == value, ascending; through an index in time proportional to
+        // the matches, else a filter scan (defined in filter.hpp)
+        template<typename V>
+        std::vector<size_t> lookup(const std::string& column, const V& value) const;
+
         row_view operator[](size_t row_index) {
-            return row_view(columns_, columns_map_, row_index);
+            return row_view(columns_, columns_map_, indexes_, row_index);
         }
 
         size_t rowCount() const { return columns_.empty() ? 0 : columns_[0]->size(); }
         size_t columnCount() const { return columns_.size(); }
+
+        std::vector<std::string> column_names() const {
+            std::vector<std::string> names(columns_.size());
+            for (const auto& [name, index] : columns_map_) names[index] = name;
+            return names;
+        }
+
+        bool has_column(const std::string& name) const { return columns_map_.contains(name); }
+
+        // Frames sharing this one's column buffers: rows [offset, offset + count), clamped to
+        // the end, or the named columns in that order. Nothing is copied until either frame
+        // is written to, and then only the column written.
+        data_frame slice(size_t offset, size_t count) const {
+            data_frame out;
+            offset = std::min(offset, rowCount());
+            count = std::min(count, rowCount() - offset);
+            auto names = column_names();
+            for (size_t i = 0; i < columns_.size(); ++i) out.add_column(names[i], detail::slice(columns_[i], offset, count));
+            return out;
+        }
+
+        data_frame select(const std::vector<std::string>& columns) const {
+            data_frame out;
+            for (const auto& name : columns) out.add_column(name, columns_[column_position(name)]);
+            return out;
+        }
+
+        const IColumn& column_at(size_t index) const { return *columns_.at(index); }
+        std::shared_ptr<IColumn> column_ptr(size_t index) const { return columns_.at(index); }
+
+        size_t column_position(const std::string& name) const {
+            auto it = columns_map_.find(name);
+            if (it == columns_map_.end()) throw std::runtime_error("Unknown column: " + name);
+            return it->second;
+        }
+
+        // Typed contiguous view of a column, e.g. for (double px : df.column<double>("px"))
+        template<typename T>
+        std::span<const T> column(const std::string& name) const {
+            return column<T>(column_position(name));
+        }
+
+        template<typename T>
+        std::span<const T> column(size_t index) const {
+            static_assert(!std::is_same_v<T, bool>, "bool columns are bit-packed; use get() or handle<bool>()");
+            auto* col = dynamic_cast<const typed_column<T>*>(columns_.at(index).get());
+            if (!col) throw std::runtime_error("Column type mismatch");
+            return col->values();
+        }
+
+        template<typename T>
+        column_handle<T> handle(const std::string& name) {
+            return handle<T>(column_position(name));
+        }
+
+        // Copies the column first if it is shared (see detail::writable). The handle writes
+        // in place, so take it after copying the frame, not before; it drops the column's indexes.
+        template<typename T>
+        column_handle<T> handle(size_t index) {
+            auto* col = dynamic_cast<data_column<T>*>(&detail::writable(columns_.at(index)));
+            if (!col) throw std::runtime_error("Column type mismatch");
+            detail::drop_indexes(indexes_, column_names()[index]);
+            return column_handle<T>(col);
+        }
+
+        // Replaces a string column by a dictionary_column when it has at most
+        // max_distinct_ratio * rows distinct values; returns whether it did
+        bool dictionary_encode(const std::string& name, double max_distinct_ratio = 1.0) {
+            size_t index = column_position(name);
+            if (columns_[index]->type() != data_type::string) throw std::runtime_error("Column type mismatch");
+            if (dynamic_cast<const dictionary_column*>(columns_[index].get())) return true;
+
+            const IColumn& source = *columns_[index];
+            auto values = column<std::string>(index);
+            auto limit = static_cast<size_t>(max_distinct_ratio * static_cast<double>(values.size()));
+            auto encoded = std::make_shared<dictionary_column>(name);
+            for (size_t r = 0; r < values.size(); ++r) {
+                if (source.is_null(r)) encoded->push_null();
+                else encoded->push_back(std::string_view(values[r]));
+                if (encoded->dictionary().size() > limit) return false;
+            }
+            columns_[index] = std::move(encoded);
+            return true;
+        }
+
+        // Replaces a column by its compressed form (defined in compression.hpp): a read-only
+        // compressed_column for numbers and timestamps, a dictionary_column for strings. It
+        // reads like the original; sum, min, max, mean and filter run on the encoding, a
+        // write decompresses the column. automatic leaves it as it is when no encoding
+        // is smaller. Returns whether the column is compressed.
+        bool compress(const std::string& name, column_encoding encoding = column_encoding::automatic);
+        void decompress(const std::string& name);
+
+        // Validity bitmap of a column, nullptr when it has no nulls
+        const std::uint64_t* validity(const std::string& name) const { return columns_[column_position(name)]->validity(); }
+        size_t null_count(const std::string& name) const { return columns_[column_position(name)]->null_count(); }
+
+        // Column aggregations, run by the SIMD kernels in column_kernels.hpp; nulls are skipped
+        template<typename T>
+        auto sum(const std::string& name) const {
+            if (auto* col = encoded<T>(name)) return col->sum();
+            return kernels::sum(column<T>(name), validity(name));
+        }
+
+        template<typename T>
+        std::optional<T> min(const std::string& name) const {
+            if (auto* col = encoded<T>(name)) return col->min();
+            return kernels::min(column<T>(name), validity(name));
+        }
+
+        template<typename T>
+        std::optional<T> max(const std::string& name) const {
+            if (auto* col = encoded<T>(name)) return col->max();
+            return kernels::max(column<T>(name), validity(name));
+        }
+
+        template<typename T>
+        double mean(const std::string& name) const {
+            auto* col = encoded<T>(name);
+            if (!col) return kernels::mean(column<T>(name), validity(name));
+            size_t n = col->size() - col->null_count();
+            return n ? static_cast<double>(col->sum()) / static_cast<double>(n) : std::numeric_limits<double>::quiet_NaN();
+        }
+
+        template<typename T>
+        double var(const std::string& name, size_t ddof = 1) const { return kernels::var(column<T>(name), validity(name), ddof); }
+
+        template<typename T>
+        std::optional<size_t> argmin(const std::string& name) const { return kernels::argmin(column<T>(name), validity(name)); }
+
+        template<typename T>
+        std::optional<size_t> argmax(const std::string& name) const { return kernels::argmax(column<T>(name), validity(name)); }
+
+        template<typename T, typename Pred>
+        size_t count_if(const std::string& name, Pred pred) const { return kernels::count_if(column<T>(name), pred, validity(name)); }
+
+        // Rows matching pred as a view sharing this frame's columns (defined in filter.hpp)
+        frame_view filter(const predicate& pred, thread_pool* pool = nullptr) const;
+
+        // Lazy column expressions such as col("a") * col("b") + col("c") (defined in expression.hpp)
+        std::shared_ptr<IColumn> evaluate(const expr& e, thread_pool* pool = nullptr) const;
+        data_frame with_column(const std::string& name, const expr& e, thread_pool* pool = nullptr) const;
+        frame_view filter(const expr& condition, thread_pool* pool = nullptr) const;
+
+        // Hash aggregation by the given key columns, e.g.
+        // df.group_by({"symbol", "venue"}).agg({sum("qty"), mean("px"), count()}) (defined in group_by.hpp)
+        grouped_frame group_by(std::vector<std::string> keys) const;
+
+        // Equi-join on key columns, in left row order (defined in join.hpp)
+        data_frame join(const data_frame& right, const std::vector<std::string>& on, join_kind how = join_kind::inner,
+            thread_pool* pool = nullptr) const;
+        data_frame join(const data_frame& right, const std::vector<std::string>& left_on,
+            const std::vector<std::string>& right_on, join_kind how = join_kind::inner, thread_pool* pool = nullptr) const;
+
+        // Time series over a timestamp (or int64) column sorted ascending (defined in
+        // timeseries.hpp). resample buckets rows into fixed intervals from the epoch,
+        // df.resample("ts", std::chrono::minutes(5)).agg({mean("px")}), with keys grouping
+        // within each bucket. join_asof matches each row with the last right row at or
+        // before it, optionally with equal by keys and no further back than tolerance.
+        resampled_frame resample(const std::string& column, std::chrono::nanoseconds interval, std::vector<std::string> keys = {}) const;
+        data_frame join_asof(const data_frame& right, const std::string& on, const std::vector<std::string>& by = {},
+            std::optional<std::chrono::nanoseconds> tolerance = std::nullopt) const;
+
+        // Window functions over row order, optionally within partitions of equal keys
+        // (defined in window.hpp): df.window({ "sym" }).apply({ rolling_mean("px", 20), lag("px") })
+        windowed_frame window(std::vector<std::string> partition_by = {}) const;
+
+        // Rows ordered by the keys, stable, nulls last (defined in sort.hpp). sort_indices
+        // returns the permutation; top_k the first k rows of the ordering without a full sort.
+        std::vector<size_t> sort_indices(const std::vector<sort_key>& keys, thread_pool* pool = nullptr) const;
+        data_frame sort_by(const std::vector<sort_key>& keys, thread_pool* pool = nullptr) const;
+        data_frame top_k(const std::vector<sort_key>& keys, size_t k) const;
+        data_frame nlargest(size_t k, const std::string& column) const { return top_k({ { column, desc } }, k); }
+        data_frame nsmallest(size_t k, const std::string& column) const { return top_k({ { column, asc } }, k); }
+
+        // Native columnar file (defined in columnar_file.hpp). open_mmap maps the file and
+        // serves columns straight from the mapping; a write copies that column into memory.
+        void save(const std::filesystem::path& path, size_t block_rows = 65536) const;
+        static data_frame open_mmap(const std::filesystem::path& path);
+
+    private:
+        template<typename T>
+        const encoded_column<T>* encoded(const std::string& name) const {
+            return dynamic_cast<const encoded_column<T>*>(columns_[column_position(name)].get());
+        }
     };
 
 } // namespace framework
@@ -52,6 +52,12 @@ namespace framework {
             : tp_(std::chrono::time_point_cast<std::chrono::seconds>(std::chrono::system_clock::from_time_t(t))) {
         }
 
+        // Construct from any system_clock time_point, e.g. a data_frame timestamp (truncated to seconds)
+        template<typename Duration>
+        explicit datetime(std::chrono::sys_time<Duration> t)
+            : tp_(std::chrono::floor<std::chrono::seconds>(t)) {
+        }
+
         // Construct from ISO string
         explicit datetime(const std::string& str)
             : tp_(parse(str)) {
@@ -172,6 +178,11 @@ namespace framework {
         seconds_tp time_point() const {
             return tp_;
         }
+
+        // Nanosecond time_point, the value type of timestamp columns
+        std::chrono::sys_time<std::chrono::nanoseconds> to_timestamp() const {
+            return tp_;
+        }
     };
 
     // User-defined literal
@@ -0,0 +1,601 @@
+#pragma once
+
+#include "data_frame.hpp"
+#include "filter.hpp"
+#include "morsel.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace framework {
+
+    namespace detail {
+        enum class expr_op {
+            column, literal, cast, negate, logical_not,
+            add, sub, mul, div,
+            eq, ne, lt, le, gt, ge,
+            logical_and, logical_or
+        };
+
+        struct expr_node {
+            expr_op op;
+            std::string column;
+            data_value value;      // literal
+            data_type to{};        // cast target
+            std::shared_ptr<const expr_node> lhs, rhs;
+        };
+    }
+
+    // Lazy column expression: col("px") * col("qty") + 1.0, col("px") > 10.0 && !col("halted"),
+    // (col("qty") / 2).cast(data_type::int32). Building one only records the tree; it is
+    // evaluated against a frame by data_frame::evaluate/with_column/filter.
+    //
+    // int op int stays int32 (wrapping) except '/', which is always float64; int32 with int64
+    // gives int64, and mixing either with double gives double. A timestamp plus or minus an
+    // integer (nanoseconds) is a timestamp, and timestamp - timestamp is int64 nanoseconds.
+    // Comparisons and &&, ||, ! give bool. A null operand gives a null result, except that
+    // && and || follow three-valued logic like predicate.
+    class expr {
+    public:
+        template<typename V>
+            requires std::is_arithmetic_v<V> || detail::time_like<V>
+        expr(V v) : expr(literal(detail::predicate_value(v))) {}
+        expr(const char* s) : expr(literal(std::string(s))) {}
+        expr(std::string s) : expr(literal(std::move(s))) {}
+
+        expr cast(data_type to) const {
+            return expr(std::make_shared<detail::expr_node>(detail::expr_node{ detail::expr_op::cast, {}, {}, to, root_, {} }));
+        }
+
+        friend expr operator+(const expr& a, const expr& b) { return binary(detail::expr_op::add, a, b); }
+        friend expr operator-(const expr& a, const expr& b) { return binary(detail::expr_op::sub, a, b); }
+        friend expr operator*(const expr& a, const expr& b) { return binary(detail::expr_op::mul, a, b); }
+        friend expr operator/(const expr& a, const expr& b) { return binary(detail::expr_op::div, a, b); }
+        friend expr operator==(const expr& a, const expr& b) { return binary(detail::expr_op::eq, a, b); }
+        friend expr operator!=(const expr& a, const expr& b) { return binary(detail::expr_op::ne, a, b); }
+        friend expr operator<(const expr& a, const expr& b) { return binary(detail::expr_op::lt, a, b); }
+        friend expr operator<=(const expr& a, const expr& b) { return binary(detail::expr_op::le, a, b); }
+        friend expr operator>(const expr& a, const expr& b) { return binary(detail::expr_op::gt, a, b); }
+        friend expr operator>=(const expr& a, const expr& b) { return binary(detail::expr_op::ge, a, b); }
+        friend expr operator&&(const expr& a, const expr& b) { return binary(detail::expr_op::logical_and, a, b); }
+        friend expr operator||(const expr& a, const expr& b) { return binary(detail::expr_op::logical_or, a, b); }
+        friend expr operator!(const expr& a) { return unary(detail::expr_op::logical_not, a); }
+        friend expr operator-(const expr& a) { return unary(detail::expr_op::negate, a); }
+
+        friend expr col(std::string name);
+
+        const detail::expr_node& node() const { return *root_; }
+        std::string to_string() const;
+
+        // Operands of a top-level && chain, or just this expression
+        std::vector<expr> conjuncts() const {
+            if (root_->op != detail::expr_op::logical_and) return { *this };
+            auto out = expr(root_->lhs).conjuncts();
+            for (auto& e : expr(root_->rhs).conjuncts()) out.push_back(std::move(e));
+            return out;
+        }
+
+    private:
+        explicit expr(std::shared_ptr<const detail::expr_node> root) : root_(std::move(root)) {}
+
+        static expr literal(data_value v) {
+            return expr(std::make_shared<detail::expr_node>(detail::expr_node{ detail::expr_op::literal, {}, std::move(v), {}, {}, {} }));
+        }
+        static expr unary(detail::expr_op op, const expr& a) {
+            return expr(std::make_shared<detail::expr_node>(detail::expr_node{ op, {}, {}, {}, a.root_, {} }));
+        }
+        static expr binary(detail::expr_op op, const expr& a, const expr& b) {
+            return expr(std::make_shared<detail::expr_node>(detail::expr_node{ op, {}, {}, {}, a.root_, b.root_ }));
+        }
+
+        std::shared_ptr<const detail::expr_node> root_;
+    };
+
+    inline expr col(std::string name) {
+        return expr(std::make_shared<detail::expr_node>(detail::expr_node{ detail::expr_op::column, std::move(name), {}, {}, {}, {} }));
+    }
+
+    namespace detail {
+        // Rows per batch. A multiple of 64, so a batch's validity is a whole-word slice of the
+        // column's; small enough that every node's buffer of a typical tree stays in L1/L2.
+        inline constexpr size_t expr_batch = 1024;
+        inline constexpr size_t expr_batch_words = expr_batch / 64;
+
+        // Value type a node works in: int32, int64, double, timestamp, one byte per bool, std::string
+        template<typename T> struct expr_type_of : data_type_of<T> {};
+        template<> struct expr_type_of<std::uint8_t> { static constexpr data_type value = data_type::boolean; };
+
+        template<typename F>
+        decltype(auto) visit_lane(data_type t, F&& f) {
+            switch (t) {
+            case data_type::int32: return f(std::type_identity<int>{});
+            case data_type::float64: return f(std::type_identity<double>{});
+            case data_type::int64: return f(std::type_identity<std::int64_t>{});
+            case data_type::timestamp: return f(std::type_identity<timestamp>{});
+            case data_type::boolean: return f(std::type_identity<std::uint8_t>{});
+            case data_type::string: break;
+            }
+            return f(std::type_identity<std::string>{});
+        }
+
+        // A compiled node. run() makes data/validity describe rows [begin, begin + n) of the
+        // current batch; data points at column storage where it can, else at the node's buffer.
+        class expr_kernel {
+        public:
+            explicit expr_kernel(data_type t) : type(t) {}
+            virtual ~expr_kernel() = default;
+            virtual void run(size_t begin, size_t n) = 0;
+
+            const data_type type;
+            const void* data = nullptr;
+            const std::uint64_t* validity = nullptr; // batch words, nullptr when all valid
+            bool scalar = false;                     // data[0] holds the value of every row
+
+            template<typename T> const T* values() const { return static_cast<const T*>(data); }
+        };
+
+        using expr_kernel_ptr = std::unique_ptr<expr_kernel>;
+
+        template<typename T>
+        class column_kernel : public expr_kernel {
+            std::span<const T> values_;
+            const std::uint64_t* validity_;
+        public:
+            column_kernel(std::span<const T> values, const std::uint64_t* validity)
+                : expr_kernel(expr_type_of<T>::value), values_(values), validity_(validity) {
+            }
+            void run(size_t begin, size_t) override {
+                data = values_.data() + begin;
+                validity = validity_ ? validity_ + begin / 64 : nullptr;
+            }
+        };
+
+        // bool columns are bit-packed; unpacked a batch at a time
+        class bool_column_kernel : public expr_kernel {
+            const data_column<bool>& col_;
+            const std::uint64_t* validity_;
+            std::vector<std::uint8_t> buf_ = std::vector<std::uint8_t>(expr_batch);
+        public:
+            explicit bool_column_kernel(const data_column<bool>& col)
+                : expr_kernel(data_type::boolean), col_(col), validity_(col.validity()) {
+                data = buf_.data();
+            }
+            void run(size_t begin, size_t n) override {
+                for (size_t i = 0; i < n; ++i) buf_[i] = col_.data[begin + i];
+                validity = validity_ ? validity_ + begin / 64 : nullptr;
+            }
+        };
+
+        template<typename T>
+        class literal_kernel : public expr_kernel {
+            T value_;
+        public:
+            explicit literal_kernel(T v) : expr_kernel(expr_type_of<T>::value), value_(std::move(v)) {
+                data = &value_;
+                scalar = true;
+            }
+            void run(size_t, size_t) override {}
+        };
+
+        // Validity of a two-input node: the AND of both, copied only when both have nulls
+        inline const std::uint64_t* combine_validity(const expr_kernel& a, const expr_kernel& b, size_t n, std::uint64_t* buf) {
+            if (!a.validity) return b.validity;
+            if (!b.validity) return a.validity;
+            for (size_t w = 0; w < kernels::mask_words(n); ++w) buf[w] = a.validity[w] & b.validity[w];
+            return buf;
+        }
+
+        // Timestamps convert through their nanosecond count
+        template<typename From, typename To>
+        To expr_convert(const From& v) {
+            if constexpr (std::is_same_v<To, std::uint8_t>) return v != From{};
+            else if constexpr (std::is_same_v<From, To>) return v;
+            else if constexpr (std::is_same_v<From, timestamp>) return static_cast<To>(v.time_since_epoch().count());
+            else if constexpr (std::is_same_v<To, timestamp>) return timestamp(std::chrono::nanoseconds(static_cast<std::int64_t>(v)));
+            else return static_cast<To>(v);
+        }
+
+        template<typename From, typename To>
+        class cast_kernel : public expr_kernel {
+            expr_kernel_ptr in_;
+            std::vector<To> buf_ = std::vector<To>(expr_batch);
+        public:
+            explicit cast_kernel(expr_kernel_ptr in) : expr_kernel(expr_type_of<To>::value), in_(std::move(in)) {
+                data = buf_.data();
+                scalar = in_->scalar;
+            }
+            void run(size_t begin, size_t n) override {
+                in_->run(begin, n);
+                const From* x = in_->values<From>();
+                if (scalar) n = 1;
+                for (size_t i = 0; i < n; ++i) buf_[i] = expr_convert<From, To>(x[i]);
+                validity = in_->validity;
+            }
+        };
+
+        // Wrapping int32 arithmetic; plain arithmetic for double
+        template<typename T, typename U>
+        T wrap(U v) { return static_cast<T>(v); }
+
+        struct add_op {
+            template<typename T> T operator()(T a, T b) const {
+                if constexpr (std::is_integral_v<T>) return wrap<T>(static_cast<std::make_unsigned_t<T>>(a) + static_cast<std::make_unsigned_t<T>>(b));
+                else return a + b;
+            }
+        };
+        struct sub_op {
+            template<typename T> T operator()(T a, T b) const {
+                if constexpr (std::is_integral_v<T>) return wrap<T>(static_cast<std::make_unsigned_t<T>>(a) - static_cast<std::make_unsigned_t<T>>(b));
+                else return a - b;
+            }
+        };
+        struct mul_op {
+            template<typename T> T operator()(T a, T b) const {
+                if constexpr (std::is_integral_v<T>) return wrap<T>(static_cast<std::make_unsigned_t<T>>(a) * static_cast<std::make_unsigned_t<T>>(b));
+                else return a * b;
+            }
+        };
+        struct div_op {
+            double operator()(double a, double b) const { return a / b; }
+        };
+
+        template<typename Cmp>
+        struct compare_with {
+            template<typename T> std::uint8_t operator()(const T& a, const T& b) const { return Cmp{}(a, b); }
+        };
+
+        // out[i] = op(a[i], b[i]) with T inputs and R output. One tight loop per operand shape
+        // (column/column, column/scalar, scalar/column), which the compiler vectorizes.
+        template<typename T, typename R, typename Op>
+        class binary_kernel : public expr_kernel {
+            expr_kernel_ptr a_, b_;
+            std::vector<R> buf_ = std::vector<R>(expr_batch);
+            std::uint64_t valid_[expr_batch_words];
+        public:
+            binary_kernel(expr_kernel_ptr a, expr_kernel_ptr b)
+                : expr_kernel(expr_type_of<R>::value), a_(std::move(a)), b_(std::move(b)) {
+                data = buf_.data();
+                scalar = a_->scalar && b_->scalar;
+            }
+            void run(size_t begin, size_t n) override {
+                a_->run(begin, n);
+                b_->run(begin, n);
+                const T* x = a_->values<T>();
+                const T* y = b_->values<T>();
+                R* out = buf_.data();
+                Op op;
+                if (scalar) out[0] = op(x[0], y[0]);
+                else if (a_->scalar) { const T& s = x[0]; for (size_t i = 0; i < n; ++i) out[i] = op(s, y[i]); }
+                else if (b_->scalar) { const T& s = y[0]; for (size_t i = 0; i < n; ++i) out[i] = op(x[i], s); }
+                else for (size_t i = 0; i < n; ++i) out[i] = op(x[i], y[i]);
+                validity = combine_validity(*a_, *b_, n, valid_);
+            }
+        };
+
+        template<typename T>
+        class negate_kernel : public expr_kernel {
+            expr_kernel_ptr in_;
+            std::vector<T> buf_ = std::vector<T>(expr_batch);
+        public:
+            explicit negate_kernel(expr_kernel_ptr in) : expr_kernel(in->type), in_(std::move(in)) {
+                data = buf_.data();
+                scalar = in_->scalar;
+            }
+            void run(size_t begin, size_t n) override {
+                in_->run(begin, n);
+                const T* x = in_->values<T>();
+                if (scalar) n = 1;
+                for (size_t i = 0; i < n; ++i) {
+                    if constexpr (std::is_same_v<T, std::uint8_t>) buf_[i] = !x[i];
+                    else if constexpr (std::is_integral_v<T>) buf_[i] = wrap<T>(0u - static_cast<std::make_unsigned_t<T>>(x[i]));
+                    else buf_[i] = -x[i];
+                }
+                validity = in_->validity;
+            }
+        };
+
+        // && and || with three-valued logic: false && null is false, true || null is true
+        template<bool And>
+        class logical_kernel : public expr_kernel {
+            expr_kernel_ptr a_, b_;
+            std::vector<std::uint8_t> buf_ = std::vector<std::uint8_t>(expr_batch);
+            std::uint64_t valid_[expr_batch_words];
+        public:
+            logical_kernel(expr_kernel_ptr a, expr_kernel_ptr b)
+                : expr_kernel(data_type::boolean), a_(std::move(a)), b_(std::move(b)) {
+                data = buf_.data();
+                scalar = a_->scalar && b_->scalar;
+            }
+            void run(size_t begin, size_t n) override {
+                a_->run(begin, n);
+                b_->run(begin, n);
+                if (scalar) n = 1;
+                const std::uint8_t* x = a_->values<std::uint8_t>();
+                const std::uint8_t* y = b_->values<std::uint8_t>();
+                const size_t xs = a_->scalar ? 0 : 1, ys = b_->scalar ? 0 : 1;
+                for (size_t i = 0; i < n; ++i) {
+                    if constexpr (And) buf_[i] = x[i * xs] & y[i * ys];
+                    else buf_[i] = x[i * xs] | y[i * ys];
+                }
+                validity = nullptr;
+                if (!a_->validity && !b_->validity) return;
+                auto bit = [](const std::uint64_t* v, size_t i) { return !v || ((v[i / 64] >> (i % 64)) & 1); };
+                std::fill_n(valid_, expr_batch_words, 0);
+                for (size_t i = 0; i < n; ++i) {
+                    bool va = bit(a_->validity, i), vb = bit(b_->validity, i);
+                    // A known operand equal to the absorbing value (false for &&, true for ||) decides the row
+                    bool decided = (va && bool(x[i * xs]) != And) || (vb && bool(y[i * ys]) != And);
+                    if ((va && vb) || decided) valid_[i / 64] |= std::uint64_t{ 1 } << (i % 64);
+                    if (decided) buf_[i] = !And;
+                }
+                validity = valid_;
+            }
+        };
+
+        inline bool expr_integral(data_type t) { return t == data_type::int32 || t == data_type::int64; }
+        inline bool expr_numeric(data_type t) { return expr_integral(t) || t == data_type::float64; }
+
+        inline expr_kernel_ptr expr_cast(expr_kernel_ptr in, data_type to) {
+            if (in->type == to) return in;
+            if (in->type == data_type::string || to == data_type::string)
+                throw std::runtime_error("Expression cannot cast to or from string");
+            return visit_lane(in->type, [&](auto from) -> expr_kernel_ptr {
+                using From = typename decltype(from)::type;
+                return visit_lane(to, [&](auto target) -> expr_kernel_ptr {
+                    using To = typename decltype(target)::type;
+                    if constexpr (std::is_same_v<From, std::string> || std::is_same_v<To, std::string>) return nullptr;
+                    else return std::make_unique<cast_kernel<From, To>>(std::move(in));
+                });
+            });
+        }
+
+        template<typename Op>
+        expr_kernel_ptr expr_arithmetic(expr_kernel_ptr a, expr_kernel_ptr b, bool always_double) {
+            constexpr bool shifts = std::is_same_v<Op, add_op> || std::is_same_v<Op, sub_op>;
+            const bool ta = a->type == data_type::timestamp, tb = b->type == data_type::timestamp;
+            if constexpr (shifts) {
+                bool offset = (ta && expr_integral(b->type)) || (std::is_same_v<Op, add_op> && tb && expr_integral(a->type));
+                if (offset || (std::is_same_v<Op, sub_op> && ta && tb)) {
+                    auto ns = std::make_unique<binary_kernel<std::int64_t, std::int64_t, Op>>(
+                        expr_cast(std::move(a), data_type::int64), expr_cast(std::move(b), data_type::int64));
+                    return offset ? expr_cast(std::move(ns), data_type::timestamp) : std::move(ns);
+                }
+            }
+            if (!expr_numeric(a->type) || !expr_numeric(b->type))
+                throw std::runtime_error("Expression arithmetic needs numeric operands");
+            bool as_int = !always_double && a->type == data_type::int32 && b->type == data_type::int32;
+            if (as_int) return std::make_unique<binary_kernel<int, int, Op>>(std::move(a), std::move(b));
+            if (!always_double && expr_integral(a->type) && expr_integral(b->type))
+                return std::make_unique<binary_kernel<std::int64_t, std::int64_t, Op>>(expr_cast(std::move(a), data_type::int64),
+                    expr_cast(std::move(b), data_type::int64));
+            return std::make_unique<binary_kernel<double, double, Op>>(expr_cast(std::move(a), data_type::float64),
+                expr_cast(std::move(b), data_type::float64));
+        }
+
+        template<typename Cmp>
+        expr_kernel_ptr expr_compare(expr_kernel_ptr a, expr_kernel_ptr b) {
+            data_type common = a->type;
+            if (a->type != b->type) {
+                if (!expr_numeric(a->type) || !expr_numeric(b->type)) throw std::runtime_error("Expression comparison type mismatch");
+                common = expr_integral(a->type) && expr_integral(b->type) ? data_type::int64 : data_type::float64;
+            }
+            a = expr_cast(std::move(a), common);
+            b = expr_cast(std::move(b), common);
+            return visit_lane(common, [&](auto lane) -> expr_kernel_ptr {
+                using T = typename decltype(lane)::type;
+                return std::make_unique<binary_kernel<T, std::uint8_t, compare_with<Cmp>>>(std::move(a), std::move(b));
+            });
+        }
+
+        inline expr_kernel_ptr compile(const expr_node& n, const data_frame& df) {
+            switch (n.op) {
+            case expr_op::column: {
+                const IColumn& col = df.column_at(df.column_position(n.column));
+                return visit_column(col, [&](const auto& typed) -> expr_kernel_ptr {
+                    using T = typename std::decay_t<decltype(typed)>::value_type;
+                    if constexpr (std::is_same_v<T, bool>) {
+                        auto* bits = dynamic_cast<const data_column<bool>*>(&col);
+                        if (!bits) throw std::runtime_error("Unsupported expression column: " + n.column);
+                        return std::make_unique<bool_column_kernel>(*bits);
+                    }
+                    else {
+                        return std::make_unique<column_kernel<T>>(typed.values(), col.validity());
+                    }
+                });
+            }
+            case expr_op::literal:
+                return std::visit([](const auto& v) -> expr_kernel_ptr {
+                    using V = std::decay_t<decltype(v)>;
+                    if constexpr (std::is_same_v<V, bool>) return std::make_unique<literal_kernel<std::uint8_t>>(v);
+                    else return std::make_unique<literal_kernel<V>>(v);
+                }, n.value);
+            case expr_op::cast:
+                return expr_cast(compile(*n.lhs, df), n.to);
+            case expr_op::negate: {
+                auto in = compile(*n.lhs, df);
+                if (!expr_numeric(in->type)) throw std::runtime_error("Expression negation needs a numeric operand");
+                if (in->type == data_type::int32) return std::make_unique<negate_kernel<int>>(std::move(in));
+                if (in->type == data_type::int64) return std::make_unique<negate_kernel<std::int64_t>>(std::move(in));
+                return std::make_unique<negate_kernel<double>>(std::move(in));
+            }
+            case expr_op::logical_not: {
+                auto in = compile(*n.lhs, df);
+                if (in->type != data_type::boolean) throw std::runtime_error("Expression ! needs a bool operand");
+                return std::make_unique<negate_kernel<std::uint8_t>>(std::move(in));
+            }
+            default:
+                break;
+            }
+
+            auto a = compile(*n.lhs, df);
+            auto b = compile(*n.rhs, df);
+            switch (n.op) {
+            case expr_op::add: return expr_arithmetic<add_op>(std::move(a), std::move(b), false);
+            case expr_op::sub: return expr_arithmetic<sub_op>(std::move(a), std::move(b), false);
+            case expr_op::mul: return expr_arithmetic<mul_op>(std::move(a), std::move(b), false);
+            case expr_op::div: return expr_arithmetic<div_op>(std::move(a), std::move(b), true);
+            case expr_op::eq: return expr_compare<std::equal_to<>>(std::move(a), std::move(b));
+            case expr_op::ne: return expr_compare<std::not_equal_to<>>(std::move(a), std::move(b));
+            case expr_op::lt: return expr_compare<std::less<>>(std::move(a), std::move(b));
+            case expr_op::le: return expr_compare<std::less_equal<>>(std::move(a), std::move(b));
+            case expr_op::gt: return expr_compare<std::greater<>>(std::move(a), std::move(b));
+            case expr_op::ge: return expr_compare<std::greater_equal<>>(std::move(a), std::move(b));
+            default:
+                break;
+            }
+            if (a->type != data_type::boolean || b->type != data_type::boolean)
+                throw std::runtime_error("Expression && / || need bool operands");
+            if (n.op == expr_op::logical_and) return std::make_unique<logical_kernel<true>>(std::move(a), std::move(b));
+            return std::make_unique<logical_kernel<false>>(std::move(a), std::move(b));
+        }
+
+        // Runs the compiled tree batch by batch over rows [begin, end), handing each batch's
+        // result to sink(begin, n, root). begin must be a multiple of 64.
+        template<typename Sink>
+        void run_batches(expr_kernel& root, size_t begin, size_t end, Sink&& sink) {
+            for (; begin < end; begin += expr_batch) {
+                size_t n = std::min(expr_batch, end - begin);
+                root.run(begin, n);
+                sink(begin, n, root);
+            }
+        }
+
+        template<typename Sink>
+        void run_batches(expr_kernel& root, size_t rows, Sink&& sink) { run_batches(root, 0, rows, std::forward<Sink>(sink)); }
+
+        // Sets the mask bits of rows [begin, end) where the bool tree is true (null is false)
+        inline void expr_mask(expr_kernel& root, size_t begin, size_t end, std::uint64_t* mask) {
+            if (root.type != data_type::boolean) throw std::runtime_error("filter needs a bool expression");
+            run_batches(root, begin, end, [&](size_t b, size_t n, const expr_kernel& k) {
+                const std::uint8_t* v = k.values<std::uint8_t>();
+                for (size_t w = 0; w < kernels::mask_words(n); ++w) {
+                    std::uint64_t bits = 0;
+                    size_t m = std::min<size_t>(64, n - w * 64);
+                    for (size_t i = 0; i < m; ++i) bits |= static_cast<std::uint64_t>(v[k.scalar ? 0 : w * 64 + i] != 0) << i;
+                    if (k.validity) bits &= k.validity[w];
+                    mask[b / 64 + w] = bits;
+                }
+            });
+        }
+
+        // Columns an expression reads, in first-use order
+        inline void expr_columns(const expr_node& n, std::vector<std::string>& out) {
+            if (n.op == expr_op::column && std::find(out.begin(), out.end(), n.column) == out.end()) out.push_back(n.column);
+            if (n.lhs) expr_columns(*n.lhs, out);
+            if (n.rhs) expr_columns(*n.rhs, out);
+        }
+
+        inline std::string expr_string(const expr_node& n) {
+            static constexpr const char* symbols[] = { "", "", "", "-", "!", " + ", " - ", " * ", " / ",
+                " == ", " != ", " < ", " <= ", " > ", " >= ", " && ", " || " };
+            switch (n.op) {
+            case expr_op::column: return n.column;
+            case expr_op::literal:
+                return std::visit([](const auto& v) -> std::string {
+                    using V = std::decay_t<decltype(v)>;
+                    if constexpr (std::is_same_v<V, std::string>) return "\"" + v + "\"";
+                    else if constexpr (std::is_same_v<V, bool>) return v ? "true" : "false";
+                    else if constexpr (std::is_same_v<V, timestamp>) return format_timestamp(v);
+                    else {
+                        std::ostringstream s;
+                        s << v;
+                        return s.str();
+                    }
+                }, n.value);
+            case expr_op::cast: {
+                static constexpr const char* types[] = { "int32", "float64", "string", "boolean", "int64", "timestamp" };
+                return "cast(" + expr_string(*n.lhs) + ", " + types[static_cast<int>(n.to)] + ")";
+            }
+            case expr_op::negate:
+            case expr_op::logical_not:
+                return symbols[static_cast<int>(n.op)] + expr_string(*n.lhs);
+            default:
+                return "(" + expr_string(*n.lhs) + symbols[static_cast<int>(n.op)] + expr_string(*n.rhs) + ")";
+            }
+        }
+    }
+
+    inline std::string expr::to_string() const { return detail::expr_string(*root_); }
+
+    namespace detail {
+        // One compiled tree per worker, since a tree holds its batch buffers
+        inline std::vector<expr_kernel_ptr> compile_workers(const expr_node& n, const data_frame& df, size_t workers) {
+            std::vector<expr_kernel_ptr> roots;
+            for (size_t w = 0; w < workers; ++w) roots.push_back(compile(n, df));
+            return roots;
+        }
+    }
+
+    // One output column; only the batch buffers of the trees are live while they run. With a
+    // pool each worker runs its own tree over the morsels it claims.
+    inline std::shared_ptr<IColumn> data_frame::evaluate(const expr& e, thread_pool* pool) const {
+        const size_t rows = rowCount();
+        const size_t workers = detail::morsel_workers(pool, rows);
+        auto roots = detail::compile_workers(e.node(), *this, workers);
+        std::vector<std::uint64_t> validity(kernels::mask_words(rows), ~std::uint64_t{ 0 });
+        std::atomic<bool> has_nulls{ false };
+        auto record_validity = [&](size_t begin, size_t n, const detail::expr_kernel& k) {
+            if (!k.validity) return;
+            has_nulls.store(true, std::memory_order_relaxed);
+            std::copy_n(k.validity, kernels::mask_words(n), validity.begin() + begin / 64);
+        };
+
+        return detail::visit_lane(roots[0]->type, [&](auto lane) -> std::shared_ptr<IColumn> {
+            using T = typename decltype(lane)::type;
+            using C = std::conditional_t<std::is_same_v<T, std::uint8_t>, bool, T>;
+            auto out = std::make_shared<data_column<C>>("");
+            // bool rows are bit-packed, so they go through a byte per row first
+            std::vector<T> bytes(std::is_same_v<C, bool> ? rows : 0);
+            if constexpr (!std::is_same_v<C, bool>) out->data.resize(rows);
+            detail::for_each_morsel(pool, workers, rows, [&](size_t w, size_t first, size_t last) {
+                detail::run_batches(*roots[w], first, last, [&](size_t begin, size_t n, const detail::expr_kernel& k) {
+                    const T* v = k.values<T>();
+                    if constexpr (std::is_same_v<C, bool>) {
+                        if (k.scalar) std::fill_n(bytes.begin() + begin, n, v[0]);
+                        else std::memcpy(bytes.data() + begin, v, n);
+                    }
+                    else if (k.scalar) std::fill_n(out->data.begin() + begin, n, static_cast<C>(v[0]));
+                    else if constexpr (std::is_same_v<C, std::string>) std::copy_n(v, n, out->data.begin() + begin);
+                    else std::memcpy(out->data.data() + begin, v, n * sizeof(T));
+                    record_validity(begin, n, k);
+                });
+            });
+            if constexpr (std::is_same_v<C, bool>) out->data.assign(bytes.begin(), bytes.end());
+            if (has_nulls.load()) {
+                if (rows % 64) validity.back() &= (std::uint64_t{ 1 } << (rows % 64)) - 1;
+                out->validity_bits.assign(std::move(validity), rows);
+            }
+            return out;
+        });
+    }
+
+    // This frame's columns (shared) plus the evaluated one
+    inline data_frame data_frame::with_column(const std::string& name, const expr& e, thread_pool* pool) const {
+        data_frame out = *this;
+        out.add_column(name, evaluate(e, pool));
+        return out;
+    }
+
+    // Rows where the bool expression is true (null counts as false), straight into the mask
+    inline frame_view data_frame::filter(const expr& condition, thread_pool* pool) const {
+        const size_t rows = rowCount();
+        const size_t workers = detail::morsel_workers(pool, rows);
+        auto roots = detail::compile_workers(condition.node(), *this, workers);
+        std::vector<std::uint64_t> mask(kernels::mask_words(rows), 0);
+        detail::for_each_morsel(pool, workers, rows, [&](size_t w, size_t begin, size_t end) {
+            detail::expr_mask(*roots[w], begin, end, mask.data());
+        });
+        return frame_view(*this, std::move(mask));
+    }
+
+} // namespace framework
@@ -0,0 +1,412 @@
+#pragma once
+
+#include "column_kernels.hpp"
+#include "data_frame.hpp"
+#include "index.hpp"
+#include "morsel.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace framework {
+
+    using kernels::compare_op;
+
+    namespace detail {
+        // Anything with a time_point(), such as framework::datetime
+        template<typename V>
+        concept time_like = std::is_convertible_v<const V&, timestamp> || requires(const V& v) { timestamp(v.time_point()); };
+
+        template<typename V>
+        data_value predicate_value(const V& v) {
+            if constexpr (std::is_same_v<V, bool>) return v;
+            else if constexpr (std::is_integral_v<V> && sizeof(V) > sizeof(int)) return static_cast<std::int64_t>(v);
+            else if constexpr (std::is_integral_v<V>) return static_cast<int>(v);
+            else if constexpr (std::is_convertible_v<const V&, timestamp>) return timestamp(v);
+            else if constexpr (time_like<V>) return timestamp(v.time_point());
+            else if constexpr (std::is_floating_point_v<V>) return static_cast<double>(v);
+            else if constexpr (std::is_convertible_v<const V&, std::string_view>) return std::string(std::string_view(v));
+            else return data_value(v);
+        }
+    }
+
+    // Row predicate built from column-vs-constant comparisons combined with &&, || and !.
+    // Each comparison runs as one vectorized pass over the typed column into a bitmask;
+    // boolean operators are word-wise AND/OR/NOT over those masks. Nulls follow SQL: a
+    // comparison on a null is unknown, && / || / ! propagate unknown (three-valued logic),
+    // and only rows that come out true match. With a pool the frame is evaluated a morsel at
+    // a time across its workers.
+    class predicate {
+    public:
+        predicate(std::string column, compare_op op, data_value value)
+            : root_(std::make_shared<node>(node{ kind::compare, std::move(column), op, std::move(value), {}, {} })) {
+        }
+
+        friend predicate operator&&(const predicate& a, const predicate& b) { return predicate(kind::all_of, a.root_, b.root_); }
+        friend predicate operator||(const predicate& a, const predicate& b) { return predicate(kind::any_of, a.root_, b.root_); }
+        friend predicate operator!(const predicate& a) { return predicate(kind::negate, a.root_, nullptr); }
+
+        // Rows where the column is null; never unknown
+        static predicate is_null(std::string column) {
+            return predicate(std::make_shared<node>(node{ kind::null_test, std::move(column), compare_op::eq, {}, {}, {} }));
+        }
+
+        // One bit per row of df, kernels::mask_words(df.rowCount()) words. Must not be called
+        // from one of the pool's own workers.
+        std::vector<std::uint64_t> evaluate(const data_frame& df, thread_pool* pool = nullptr) const {
+            const size_t rows = df.rowCount();
+            std::vector<std::uint64_t> mask(kernels::mask_words(rows));
+            index_hits hits;
+            find_hits(*root_, df, hits);
+            detail::for_each_morsel(pool, detail::morsel_workers(pool, rows), rows, [&](size_t, size_t begin, size_t end) {
+                std::vector<std::uint64_t> out(kernels::mask_words(end - begin)), unknown;
+                eval(*root_, df, hits, begin, end, out, unknown);
+                std::copy(out.begin(), out.end(), mask.begin() + begin / 64);
+            });
+            return mask;
+        }
+
+        // The matching rows, ascending, read straight from an index when the predicate is a
+        // single comparison on an indexed column matching at most limit rows; else false
+        bool lookup(const data_frame& df, size_t limit, std::vector<size_t>& rows) const {
+            if (!lookup_index(*root_, df, limit, rows)) return false;
+            std::sort(rows.begin(), rows.end());
+            return true;
+        }
+
+        // Indexes answer a comparison when it selects at most 1 / index_selectivity of the
+        // rows; past that the vectorized scan is faster than scattering the index's rows
+        static constexpr size_t index_selectivity = 16;
+
+    private:
+        enum class kind { compare, null_test, all_of, any_of, negate };
+
+        struct node {
+            kind k;
+            std::string column;
+            compare_op op;
+            data_value value;
+            std::shared_ptr<const node> lhs, rhs;
+        };
+
+        predicate(kind k, std::shared_ptr<const node> lhs, std::shared_ptr<const node> rhs)
+            : root_(std::make_shared<node>(node{ k, {}, compare_op::eq, {}, std::move(lhs), std::move(rhs) })) {
+        }
+
+        explicit predicate(std::shared_ptr<const node> root) : root_(std::move(root)) {}
+
+        // Rows of the comparisons an index answers, ascending, found once for the whole frame
+        using index_hits = std::vector<std::pair<const node*, std::vector<size_t>>>;
+
+        static void find_hits(const node& n, const data_frame& df, index_hits& hits) {
+            std::vector<size_t> rows;
+            if (lookup_index(n, df, df.rowCount() / index_selectivity, rows)) {
+                std::sort(rows.begin(), rows.end());
+                hits.emplace_back(&n, std::move(rows));
+            }
+            if (n.lhs) find_hits(*n.lhs, df, hits);
+            if (n.rhs) find_hits(*n.rhs, df, hits);
+        }
+
+        // Over rows [begin, end), begin a multiple of 64: out gets the rows where n is true,
+        // unknown those where it is unknown, bit i for row begin + i. unknown stays empty while
+        // no null is involved, so null-free frames run the plain mask operations.
+        static void eval(const node& n, const data_frame& df, const index_hits& hits, size_t begin, size_t end,
+            std::vector<std::uint64_t>& out, std::vector<std::uint64_t>& unknown) {
+            const size_t rows = end - begin;
+            switch (n.k) {
+            case kind::compare: {
+                const IColumn& col = df.column_at(df.column_position(n.column));
+                auto hit = std::find_if(hits.begin(), hits.end(), [&](const auto& h) { return h.first == &n; });
+                if (hit != hits.end()) {
+                    std::fill(out.begin(), out.end(), 0);
+                    const auto& matched = hit->second;
+                    for (auto r = std::lower_bound(matched.begin(), matched.end(), begin); r != matched.end() && *r < end; ++r)
+                        out[(*r - begin) / 64] |= std::uint64_t{ 1 } << ((*r - begin) % 64);
+                }
+                else {
+                    compare_column(col, n, begin, end, out.data());
+                }
+                if (auto* valid = col.validity()) {
+                    valid += begin / 64;
+                    kernels::mask_and(out.data(), valid, out.size());
+                    unknown.assign(valid, valid + out.size());
+                    kernels::mask_not(unknown.data(), rows);
+                }
+                return;
+            }
+            case kind::null_test: {
+                auto* valid = df.column_at(df.column_position(n.column)).validity();
+                std::fill(out.begin(), out.end(), 0);
+                if (valid) {
+                    std::copy(valid + begin / 64, valid + begin / 64 + out.size(), out.begin());
+                    kernels::mask_not(out.data(), rows);
+                }
+                return;
+            }
+            case kind::negate:
+                eval(*n.lhs, df, hits, begin, end, out, unknown);
+                kernels::mask_not(out.data(), rows);
+                for (size_t w = 0; w < unknown.size(); ++w) out[w] &= ~unknown[w];
+                return;
+            case kind::all_of:
+            case kind::any_of: {
+                eval(*n.lhs, df, hits, begin, end, out, unknown);
+                std::vector<std::uint64_t> rhs(out.size()), rhs_unknown;
+                eval(*n.rhs, df, hits, begin, end, rhs, rhs_unknown);
+                if (unknown.empty() && rhs_unknown.empty()) {
+                    if (n.k == kind::all_of) kernels::mask_and(out.data(), rhs.data(), out.size());
+                    else kernels::mask_or(out.data(), rhs.data(), out.size());
+                    return;
+                }
+                unknown.resize(out.size(), 0);
+                rhs_unknown.resize(out.size(), 0);
+                for (size_t w = 0; w < out.size(); ++w) {
+                    std::uint64_t t1 = out[w], u1 = unknown[w], t2 = rhs[w], u2 = rhs_unknown[w];
+                    if (n.k == kind::all_of) {
+                        out[w] = t1 & t2;
+                        unknown[w] = (u1 | u2) & (t1 | u1) & (t2 | u2);
+                    }
+                    else {
+                        out[w] = t1 | t2;
+                        unknown[w] = (u1 | u2) & ~out[w];
+                    }
+                }
+                return;
+            }
+            }
+        }
+
+        // Rows of a comparison from a hash index (equality) or sorted index on its column
+        static bool lookup_index(const node& n, const data_frame& df, size_t limit, std::vector<size_t>& rows) {
+            if (n.k != kind::compare) return false;
+            const IColumn& col = df.column_at(df.column_position(n.column));
+            for (auto k : { index_kind::hash, index_kind::sorted }) {
+                if (k == index_kind::hash && n.op != compare_op::eq) continue;
+                auto* index = df.find_index(n.column, k);
+                if (index && index->lookup(col, n.op, n.value, limit, rows)) return true;
+            }
+            return false;
+        }
+
+        static void compare_column(const IColumn& col, const node& n, size_t begin, size_t end, std::uint64_t* out) {
+            const size_t rows = end - begin;
+            visit_column(col, [&](const auto& typed) {
+                using T = typename std::decay_t<decltype(typed)>::value_type;
+                auto values = [&] { return typed.values().subspan(begin, rows); };
+                if constexpr (!std::is_same_v<T, bool> && !std::is_same_v<T, std::string>) {
+                    // A compressed column compares on its encoding
+                    auto* encoded = dynamic_cast<const encoded_column<T>*>(&col);
+                    auto value = detail::compare_value<T>(n.value);
+                    if (encoded && value) return encoded->compare(n.op, *value, begin, end, out);
+                }
+                if constexpr (std::is_same_v<T, bool>) {
+                    auto* b = std::get_if<bool>(&n.value);
+                    auto* bits = dynamic_cast<const data_column<bool>*>(&col);
+                    if (!b || !bits) throw std::runtime_error("Predicate type mismatch on column " + n.column);
+                    for (size_t w = 0; w < kernels::mask_words(rows); ++w) out[w] = 0;
+                    for (size_t i = 0; i < rows; ++i) {
+                        bool v = bits->data[begin + i];
+                        bool hit = false;
+                        switch (n.op) {
+                        case compare_op::eq: hit = v == *b; break;
+                        case compare_op::ne: hit = v != *b; break;
+                        case compare_op::lt: hit = v < *b; break;
+                        case compare_op::le: hit = v <= *b; break;
+                        case compare_op::gt: hit = v > *b; break;
+                        case compare_op::ge: hit = v >= *b; break;
+                        }
+                        out[i / 64] |= static_cast<std::uint64_t>(hit) << (i % 64);
+                    }
+                }
+                else if constexpr (std::is_same_v<T, std::string>) {
+                    auto* s = std::get_if<std::string>(&n.value);
+                    if (!s) throw std::runtime_error("Predicate type mismatch on column " + n.column);
+                    if (auto* dict = dynamic_cast<const dictionary_column*>(&col)) compare_codes(*dict, n.op, *s, begin, end, out);
+                    else kernels::compare(values(), n.op, *s, out);
+                }
+                else if constexpr (std::is_same_v<T, timestamp>) {
+                    auto* t = std::get_if<timestamp>(&n.value);
+                    if (!t) throw std::runtime_error("Predicate type mismatch on column " + n.column);
+                    kernels::compare(values(), n.op, *t, out);
+                }
+                else {
+                    if (auto* i = std::get_if<int>(&n.value)) {
+                        if constexpr (std::is_same_v<T, int>) kernels::compare(values(), n.op, *i, out);
+                        else kernels::compare(values(), n.op, static_cast<T>(*i), out);
+                    }
+                    else if (auto* l = std::get_if<std::int64_t>(&n.value)) {
+                        kernels::compare(values(), n.op, *l, out);
+                    }
+                    else if (auto* d = std::get_if<double>(&n.value)) {
+                        kernels::compare(values(), n.op, *d, out);
+                    }
+                    else {
+                        throw std::runtime_error("Predicate type mismatch on column " + n.column);
+                    }
+                }
+            });
+        }
+
+        // Equality is one int compare of the codes (an absent value has code -1, matching no
+        // row); orderings are evaluated once per dictionary entry, then looked up per row
+        static void compare_codes(const dictionary_column& col, compare_op op, const std::string& s, size_t begin, size_t end, std::uint64_t* out) {
+            const size_t rows = end - begin;
+            auto codes = col.codes().subspan(begin, rows);
+            if (op == compare_op::eq || op == compare_op::ne) {
+                kernels::compare(codes, op, col.code_of(s), out);
+                return;
+            }
+            const auto& dict = col.dictionary();
+            std::vector<std::uint64_t> hit_words(kernels::mask_words(dict.size()));
+            kernels::compare(std::span<const std::string>(dict), op, s, hit_words.data());
+            for (size_t w = 0; w < kernels::mask_words(rows); ++w) out[w] = 0;
+            for (size_t i = 0; i < rows; ++i) {
+                size_t c = static_cast<size_t>(codes[i]);
+                out[i / 64] |= ((hit_words[c / 64] >> (c % 64)) & 1) << (i % 64);
+            }
+        }
+
+        std::shared_ptr<const node> root_;
+    };
+
+    // Column reference for predicates: where("px") > 10.0 && where("symbol") == "AAPL"
+    struct where {
+        std::string column;
+
+        explicit where(std::string c) : column(std::move(c)) {}
+
+        template<typename V> predicate operator==(const V& v) const { return { column, compare_op::eq, detail::predicate_value(v) }; }
+        template<typename V> predicate operator!=(const V& v) const { return { column, compare_op::ne, detail::predicate_value(v) }; }
+        template<typename V> predicate operator<(const V& v) const { return { column, compare_op::lt, detail::predicate_value(v) }; }
+        template<typename V> predicate operator<=(const V& v) const { return { column, compare_op::le, detail::predicate_value(v) }; }
+        template<typename V> predicate operator>(const V& v) const { return { column, compare_op::gt, detail::predicate_value(v) }; }
+        template<typename V> predicate operator>=(const V& v) const { return { column, compare_op::ge, detail::predicate_value(v) }; }
+
+        predicate is_null() const { return predicate::is_null(column); }
+        predicate is_not_null() const { return !predicate::is_null(column); }
+    };
+
+    // Filtered rows of a frame: the source's columns (shared, not copied) plus the matching
+    // rows as a bitmask and a selection vector. Aggregations run on the source columns with the
+    // mask as validity; row values are only copied by materialize()/values().
+    class frame_view {
+        data_frame source_;
+        std::vector<std::uint64_t> mask_;
+        std::vector<size_t> rows_;
+
+    public:
+        frame_view(data_frame source, std::vector<std::uint64_t> mask)
+            : source_(std::move(source)), mask_(std::move(mask)),
+              rows_(kernels::mask_to_indices(mask_.data(), source_.rowCount())) {
+        }
+
+        // From a selection already known, rows ascending
+        static frame_view of_rows(data_frame source, std::vector<size_t> rows) {
+            std::vector<std::uint64_t> mask(kernels::mask_words(source.rowCount()));
+            for (size_t r : rows) mask[r / 64] |= std::uint64_t{ 1 } << (r % 64);
+            return frame_view(std::move(source), std::move(mask), std::move(rows));
+        }
+
+        size_t rowCount() const { return rows_.size(); }
+        size_t columnCount() const { return source_.columnCount(); }
+
+        const data_frame& source() const { return source_; }
+        const std::vector<std::uint64_t>& mask() const { return mask_; }
+        const std::vector<size_t>& selection() const { return rows_; }
+
+        // i-th selected row
+        row_view operator[](size_t i) { return source_[rows_.at(i)]; }
+
+        // Narrow further; the predicate is evaluated on the source and ANDed into the mask
+        frame_view filter(const predicate& pred, thread_pool* pool = nullptr) const {
+            auto mask = pred.evaluate(source_, pool);
+            kernels::mask_and(mask.data(), mask_.data(), mask.size());
+            return frame_view(source_, std::move(mask));
+        }
+
+        // Gather the selected rows into an independent frame
+        data_frame materialize() const { return materialize(source_.column_names()); }
+
+        data_frame materialize(const std::vector<std::string>& columns) const {
+            data_frame out;
+            for (const auto& name : columns)
+                out.add_column(name, source_.column_at(source_.column_position(name)).gather(rows_));
+            return out;
+        }
+
+        template<typename T>
+        std::vector<T> values(const std::string& name) const {
+            auto src = source_.column<T>(name);
+            std::vector<T> out;
+            out.reserve(rows_.size());
+            for (size_t r : rows_) out.push_back(src[r]);
+            return out;
+        }
+
+        template<typename T>
+        auto sum(const std::string& name) const {
+            return with_valid_mask(name, [&](const std::uint64_t* m) { return kernels::sum(source_.column<T>(name), m); });
+        }
+
+        template<typename T>
+        std::optional<T> min(const std::string& name) const {
+            return with_valid_mask(name, [&](const std::uint64_t* m) { return kernels::min(source_.column<T>(name), m); });
+        }
+
+        template<typename T>
+        std::optional<T> max(const std::string& name) const {
+            return with_valid_mask(name, [&](const std::uint64_t* m) { return kernels::max(source_.column<T>(name), m); });
+        }
+
+        template<typename T>
+        double mean(const std::string& name) const {
+            return with_valid_mask(name, [&](const std::uint64_t* m) { return kernels::mean(source_.column<T>(name), m); });
+        }
+
+        template<typename T>
+        double var(const std::string& name, size_t ddof = 1) const {
+            return with_valid_mask(name, [&](const std::uint64_t* m) { return kernels::var(source_.column<T>(name), m, ddof); });
+        }
+
+        template<typename T, typename Pred>
+        size_t count_if(const std::string& name, Pred pred) const {
+            return with_valid_mask(name, [&](const std::uint64_t* m) { return kernels::count_if(source_.column<T>(name), pred, m); });
+        }
+
+    private:
+        frame_view(data_frame source, std::vector<std::uint64_t> mask, std::vector<size_t> rows)
+            : source_(std::move(source)), mask_(std::move(mask)), rows_(std::move(rows)) {
+        }
+
+        // Calls f with the selection mask, ANDed with the column's validity when it has nulls
+        template<typename F>
+        auto with_valid_mask(const std::string& name, F&& f) const {
+            auto* valid = source_.validity(name);
+            if (!valid) return f(mask_.data());
+            std::vector<std::uint64_t> mask(mask_);
+            kernels::mask_and(mask.data(), valid, mask.size());
+            return f(mask.data());
+        }
+    };
+
+    inline frame_view data_frame::filter(const predicate& pred, thread_pool* pool) const {
+        std::vector<size_t> rows;
+        if (pred.lookup(*this, rowCount() / predicate::index_selectivity, rows)) return frame_view::of_rows(*this, std::move(rows));
+        return frame_view(*this, pred.evaluate(*this, pool));
+    }
+
+    template<typename V>
+    std::vector<size_t> data_frame::lookup(const std::string& column, const V& value) const {
+        auto pred = where(column) == value;
+        std::vector<size_t> rows;
+        if (pred.lookup(*this, rowCount(), rows)) return rows;
+        return filter(pred).selection();
+    }
+
+} // namespace framework
@@ -0,0 +1,505 @@
+#pragma once
+
+#include "data_frame.hpp"
+#include "key_columns.hpp"
+#include "morsel.hpp"
+#include "sketch.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace framework {
+
+    enum class aggregate_kind { sum, mean, min, max, count, approx_count_distinct, approx_quantile };
+
+    // One output column of grouped_frame::agg(): sum("qty"), mean("px"), count(), ...
+    struct aggregate {
+        aggregate_kind kind;
+        std::string column; // empty for count() of rows
+        std::string alias;
+        double quantile;    // approx_quantile
+
+        // Rename the output column (default "<column>_<kind>", or "count" for count())
+        aggregate as(std::string name) const { return { kind, column, std::move(name), quantile }; }
+
+        std::string output_name() const {
+            if (!alias.empty()) return alias;
+            switch (kind) {
+            case aggregate_kind::sum: return column + "_sum";
+            case aggregate_kind::mean: return column + "_mean";
+            case aggregate_kind::min: return column + "_min";
+            case aggregate_kind::max: return column + "_max";
+            case aggregate_kind::approx_count_distinct: return column + "_approx_distinct";
+            case aggregate_kind::approx_quantile: {
+                std::ostringstream p;
+                p << quantile * 100;
+                return column + "_p" + p.str();
+            }
+            case aggregate_kind::count: break;
+            }
+            return column.empty() ? "count" : column + "_count";
+        }
+    };
+
+    inline aggregate sum(std::string column) { return { aggregate_kind::sum, std::move(column), {}, 0 }; }
+    inline aggregate mean(std::string column) { return { aggregate_kind::mean, std::move(column), {}, 0 }; }
+    inline aggregate min(std::string column) { return { aggregate_kind::min, std::move(column), {}, 0 }; }
+    inline aggregate max(std::string column) { return { aggregate_kind::max, std::move(column), {}, 0 }; }
+    inline aggregate count() { return { aggregate_kind::count, {}, {}, 0 }; }
+    // Non-null values of a column
+    inline aggregate count(std::string column) { return { aggregate_kind::count, std::move(column), {}, 0 }; }
+    // Distinct non-null values from a HyperLogLog (about 1.6% error), as int64 (see sketch.hpp)
+    inline aggregate approx_count_distinct(std::string column) { return { aggregate_kind::approx_count_distinct, std::move(column), {}, 0 }; }
+    // Quantile q of the non-null values from a t-digest, as float64: "px_p99" for 0.99
+    inline aggregate approx_quantile(std::string column, double q) {
+        if (!(q >= 0 && q <= 1)) throw std::runtime_error("Quantile must be in [0, 1]");
+        return { aggregate_kind::approx_quantile, std::move(column), {}, q };
+    }
+
+    namespace detail {
+        // Open-addressing (linear probing) table from key to dense group id. Keys are not copied:
+        // each group remembers the hash and the first row it was seen at, and probes compare rows.
+        class group_table {
+            struct slot {
+                std::uint64_t hash;
+                std::uint32_t group;
+            };
+            static constexpr std::uint32_t empty = std::numeric_limits<std::uint32_t>::max();
+
+            const key_columns* keys_;
+            std::vector<slot> slots_;
+            std::vector<std::uint64_t> hashes_;
+            std::vector<size_t> rows_;
+
+            void grow() {
+                std::vector<slot> next(std::max<size_t>(slots_.size() * 2, 1024), slot{ 0, empty });
+                size_t mask = next.size() - 1;
+                for (std::uint32_t g = 0; g < rows_.size(); ++g) {
+                    size_t i = hashes_[g] & mask;
+                    while (next[i].group != empty) i = (i + 1) & mask;
+                    next[i] = slot{ hashes_[g], g };
+                }
+                slots_.swap(next);
+            }
+
+        public:
+            explicit group_table(const key_columns& keys) : keys_(&keys) { grow(); }
+
+            // Group of `row`, creating it if the key is new
+            std::uint32_t insert(std::uint64_t hash, size_t row) {
+                if ((rows_.size() + 1) * 2 > slots_.size()) grow();
+                size_t mask = slots_.size() - 1;
+                for (size_t i = hash & mask;; i = (i + 1) & mask) {
+                    slot& s = slots_[i];
+                    if (s.group == empty) {
+                        if (rows_.size() >= empty) throw std::runtime_error("Too many groups");
+                        s = slot{ hash, static_cast<std::uint32_t>(rows_.size()) };
+                        hashes_.push_back(hash);
+                        rows_.push_back(row);
+                        return s.group;
+                    }
+                    if (s.hash == hash && keys_->equal(rows_[s.group], row)) return s.group;
+                }
+            }
+
+            // Group whose key equals row `row` of probe, a compatible() key set over another
+            // frame; never a null key. empty when there is none.
+            std::uint32_t find(std::uint64_t hash, const key_columns& probe, size_t row) const {
+                size_t mask = slots_.size() - 1;
+                for (size_t i = hash & mask; slots_[i].group != empty; i = (i + 1) & mask) {
+                    if (slots_[i].hash != hash) continue;
+                    std::uint8_t same = 1;
+                    probe.equal_rows(*keys_, &row, &rows_[slots_[i].group], 1, &same);
+                    if (same) return slots_[i].group;
+                }
+                return empty;
+            }
+
+            // Forgets every group, in time proportional to their number rather than the table's
+            void clear() {
+                size_t mask = slots_.size() - 1;
+                for (std::uint32_t g = 0; g < rows_.size(); ++g) {
+                    size_t i = hashes_[g] & mask;
+                    while (slots_[i].group != g) i = (i + 1) & mask;
+                    slots_[i].group = empty;
+                }
+                hashes_.clear();
+                rows_.clear();
+            }
+
+            static constexpr std::uint32_t no_group = empty;
+
+            size_t size() const { return rows_.size(); }
+            std::uint64_t hash_of(std::uint32_t group) const { return hashes_[group]; }
+            const std::vector<size_t>& first_rows() const { return rows_; }
+
+            // Records an earlier row of the group; any row of it works for key comparisons
+            void lower_first_row(std::uint32_t group, size_t row) { rows_[group] = std::min(rows_[group], row); }
+        };
+
+        // Per-group running state of one aggregate
+        struct group_accumulator {
+            virtual ~group_accumulator() = default;
+            // Row begin + i belongs to groups[i]; all ids are below ngroups
+            virtual void update(size_t begin, std::span<const std::uint32_t> groups, size_t ngroups) = 0;
+            // Fold in another partial; its group g is our group remap[g]
+            virtual void merge(const group_accumulator& other, std::span<const std::uint32_t> remap, size_t ngroups) = 0;
+            virtual std::shared_ptr<IColumn> finish(const std::string& name) const = 0;
+        };
+
+        class count_accumulator : public group_accumulator {
+            const std::uint64_t* validity_;
+            std::vector<int> n_;
+        public:
+            // With a validity bitmap only valid rows are counted
+            explicit count_accumulator(const std::uint64_t* validity = nullptr) : validity_(validity) {}
+
+            void update(size_t begin, std::span<const std::uint32_t> groups, size_t ngroups) override {
+                n_.resize(ngroups);
+                if (!validity_) {
+                    for (std::uint32_t g : groups) ++n_[g];
+                    return;
+                }
+                for (size_t i = 0; i < groups.size(); ++i) {
+                    size_t r = begin + i;
+                    n_[groups[i]] += (validity_[r / 64] >> (r % 64)) & 1;
+                }
+            }
+
+            void merge(const group_accumulator& other, std::span<const std::uint32_t> remap, size_t ngroups) override {
+                const auto& o = static_cast<const count_accumulator&>(other);
+                n_.resize(ngroups);
+                for (size_t g = 0; g < o.n_.size(); ++g) n_[remap[g]] += o.n_[g];
+            }
+
+            std::shared_ptr<IColumn> finish(const std::string& name) const override {
+                auto out = std::make_shared<data_column<int>>(name);
+                out->data = n_;
+                return out;
+            }
+        };
+
+        // sum/mean/min/max over a numeric column, min/max over timestamps. Integer sums
+        // accumulate exactly in 64 bits and are reported as float64 like every other sum.
+        // Null values are skipped; a group without any valid value gets a null result.
+        template<typename T>
+        class value_accumulator : public group_accumulator {
+            using sum_type = std::conditional_t<std::is_integral_v<T>, std::int64_t, double>;
+            static constexpr bool summable = std::is_arithmetic_v<T>;
+
+            static T highest() {
+                if constexpr (summable) return std::numeric_limits<T>::max();
+                else return T::max();
+            }
+            static T lowest() {
+                if constexpr (summable) return std::numeric_limits<T>::lowest();
+                else return T::min();
+            }
+
+            aggregate_kind kind_;
+            std::span<const T> values_;
+            const std::uint64_t* validity_;
+            std::vector<sum_type> sum_;
+            std::vector<std::int64_t> n_; // valid values per group, kept for mean or when there are nulls
+            std::vector<T> extreme_;
+
+            void resize(size_t ngroups) {
+                if (kind_ == aggregate_kind::min) extreme_.resize(ngroups, highest());
+                else if (kind_ == aggregate_kind::max) extreme_.resize(ngroups, lowest());
+                else sum_.resize(ngroups);
+                if (kind_ == aggregate_kind::mean || validity_) n_.resize(ngroups);
+            }
+
+            void add(std::uint32_t g, T v) {
+                ++n_[g];
+                switch (kind_) {
+                case aggregate_kind::min: extreme_[g] = std::min(extreme_[g], v); break;
+                case aggregate_kind::max: extreme_[g] = std::max(extreme_[g], v); break;
+                default: if constexpr (summable) sum_[g] += v; break;
+                }
+            }
+
+        public:
+            value_accumulator(aggregate_kind kind, std::span<const T> values, const std::uint64_t* validity)
+                : kind_(kind), values_(values), validity_(validity) {
+            }
+
+            void update(size_t begin, std::span<const std::uint32_t> groups, size_t ngroups) override {
+                resize(ngroups);
+                if (validity_) {
+                    for (size_t i = 0; i < groups.size(); ++i) {
+                        size_t r = begin + i;
+                        if ((validity_[r / 64] >> (r % 64)) & 1) add(groups[i], values_[r]);
+                    }
+                    return;
+                }
+                const T* v = values_.data() + begin;
+                switch (kind_) {
+                case aggregate_kind::min:
+                    for (size_t i = 0; i < groups.size(); ++i) extreme_[groups[i]] = std::min(extreme_[groups[i]], v[i]);
+                    break;
+                case aggregate_kind::max:
+                    for (size_t i = 0; i < groups.size(); ++i) extreme_[groups[i]] = std::max(extreme_[groups[i]], v[i]);
+                    break;
+                case aggregate_kind::mean:
+                    for (std::uint32_t g : groups) ++n_[g];
+                    [[fallthrough]];
+                default:
+                    if constexpr (summable)
+                        for (size_t i = 0; i < groups.size(); ++i) sum_[groups[i]] += v[i];
+                    break;
+                }
+            }
+
+            void merge(const group_accumulator& other, std::span<const std::uint32_t> remap, size_t ngroups) override {
+                const auto& o = static_cast<const value_accumulator&>(other);
+                resize(ngroups);
+                for (size_t g = 0; g < remap.size(); ++g) {
+                    auto to = remap[g];
+                    if (!n_.empty()) n_[to] += o.n_[g];
+                    switch (kind_) {
+                    case aggregate_kind::min: extreme_[to] = std::min(extreme_[to], o.extreme_[g]); break;
+                    case aggregate_kind::max: extreme_[to] = std::max(extreme_[to], o.extreme_[g]); break;
+                    default: sum_[to] += o.sum_[g]; break;
+                    }
+                }
+            }
+
+            std::shared_ptr<IColumn> finish(const std::string& name) const override {
+                std::shared_ptr<IColumn> result;
+                if (kind_ == aggregate_kind::min || kind_ == aggregate_kind::max) {
+                    auto out = std::make_shared<data_column<T>>(name);
+                    out->data = extreme_;
+                    result = out;
+                }
+                else {
+                    auto out = std::make_shared<data_column<double>>(name);
+                    out->data.resize(sum_.size());
+                    for (size_t g = 0; g < sum_.size(); ++g) {
+                        out->data[g] = static_cast<double>(sum_[g]);
+                        if (kind_ == aggregate_kind::mean) out->data[g] /= static_cast<double>(n_[g]);
+                    }
+                    result = out;
+                }
+                if (validity_)
+                    for (size_t g = 0; g < n_.size(); ++g)
+                        if (n_[g] == 0) result->set_null(g);
+                return result;
+            }
+        };
+
+        // Hash of each row's value for a HyperLogLog; dictionary strings hash each entry once
+        template<typename T>
+        struct value_hashes {
+            std::span<const T> values;
+            std::uint64_t operator()(size_t row) const { return sketch_hash(values[row]); }
+        };
+
+        struct code_hashes {
+            std::span<const int> codes;
+            std::vector<std::uint64_t> hashes;
+            std::uint64_t operator()(size_t row) const { return hashes[codes[row]]; }
+        };
+
+        // approx_count_distinct: a HyperLogLog per group, sparse while the group is small
+        template<typename Hashes>
+        class distinct_accumulator : public group_accumulator {
+            Hashes hash_;
+            const std::uint64_t* validity_;
+            std::vector<hyperloglog> sketches_;
+        public:
+            distinct_accumulator(Hashes hash, const std::uint64_t* validity) : hash_(std::move(hash)), validity_(validity) {}
+
+            void update(size_t begin, std::span<const std::uint32_t> groups, size_t ngroups) override {
+                sketches_.resize(ngroups);
+                for (size_t i = 0; i < groups.size(); ++i) {
+                    size_t r = begin + i;
+                    if (!validity_ || ((validity_[r / 64] >> (r % 64)) & 1)) sketches_[groups[i]].add_hash(hash_(r));
+                }
+            }
+
+            void merge(const group_accumulator& other, std::span<const std::uint32_t> remap, size_t ngroups) override {
+                const auto& o = static_cast<const distinct_accumulator&>(other);
+                sketches_.resize(ngroups);
+                for (size_t g = 0; g < o.sketches_.size(); ++g) sketches_[remap[g]].merge(o.sketches_[g]);
+            }
+
+            std::shared_ptr<IColumn> finish(const std::string& name) const override {
+                auto out = std::make_shared<data_column<std::int64_t>>(name);
+                for (const auto& h : sketches_) out->data.push_back(static_cast<std::int64_t>(h.count()));
+                return out;
+            }
+        };
+
+        // approx_quantile: a t-digest per group; a group without valid values gets a null
+        template<typename T>
+        class quantile_accumulator : public group_accumulator {
+            std::span<const T> values_;
+            const std::uint64_t* validity_;
+            double q_;
+            std::vector<tdigest> digests_;
+        public:
+            quantile_accumulator(std::span<const T> values, const std::uint64_t* validity, double q)
+                : values_(values), validity_(validity), q_(q) {
+            }
+
+            void update(size_t begin, std::span<const std::uint32_t> groups, size_t ngroups) override {
+                digests_.resize(ngroups);
+                for (size_t i = 0; i < groups.size(); ++i) {
+                    size_t r = begin + i;
+                    if (!validity_ || ((validity_[r / 64] >> (r % 64)) & 1)) digests_[groups[i]].add(static_cast<double>(values_[r]));
+                }
+            }
+
+            void merge(const group_accumulator& other, std::span<const std::uint32_t> remap, size_t ngroups) override {
+                const auto& o = static_cast<const quantile_accumulator&>(other);
+                digests_.resize(ngroups);
+                for (size_t g = 0; g < o.digests_.size(); ++g) digests_[remap[g]].merge(o.digests_[g]);
+            }
+
+            std::shared_ptr<IColumn> finish(const std::string& name) const override {
+                auto out = std::make_shared<data_column<double>>(name);
+                for (const auto& d : digests_) {
+                    if (d.count()) out->push_valid(d.quantile(q_));
+                    else out->push_null();
+                }
+                return out;
+            }
+        };
+
+        inline std::unique_ptr<group_accumulator> make_accumulator(const aggregate& spec, const data_frame& df) {
+            if (spec.kind == aggregate_kind::count && spec.column.empty()) return std::make_unique<count_accumulator>();
+            const IColumn& col = df.column_at(df.column_position(spec.column));
+            if (spec.kind == aggregate_kind::count) return std::make_unique<count_accumulator>(col.validity());
+            if (spec.kind == aggregate_kind::approx_count_distinct) {
+                if (auto* dict = dynamic_cast<const dictionary_column*>(&col)) {
+                    code_hashes hashes{ dict->codes(), {} };
+                    for (const auto& v : dict->dictionary()) hashes.hashes.push_back(sketch_hash(v));
+                    return std::make_unique<distinct_accumulator<code_hashes>>(std::move(hashes), col.validity());
+                }
+                return visit_column(col, [&](const auto& typed) -> std::unique_ptr<group_accumulator> {
+                    using T = typename std::decay_t<decltype(typed)>::value_type;
+                    if constexpr (std::is_same_v<T, bool>) throw std::runtime_error("Cannot count distinct values of bool column: " + spec.column);
+                    else return std::make_unique<distinct_accumulator<value_hashes<T>>>(value_hashes<T>{ typed.values() }, col.validity());
+                });
+            }
+            return visit_column(col, [&](const auto& typed) -> std::unique_ptr<group_accumulator> {
+                using T = typename std::decay_t<decltype(typed)>::value_type;
+                if constexpr (std::is_same_v<T, int> || std::is_same_v<T, double> || std::is_same_v<T, std::int64_t>) {
+                    if (spec.kind == aggregate_kind::approx_quantile)
+                        return std::make_unique<quantile_accumulator<T>>(typed.values(), col.validity(), spec.quantile);
+                }
+                if constexpr (std::is_same_v<T, timestamp>) {
+                    if (spec.kind != aggregate_kind::min && spec.kind != aggregate_kind::max)
+                        throw std::runtime_error("Timestamps only aggregate by min/max: " + spec.column);
+                    return std::make_unique<value_accumulator<T>>(spec.kind, typed.values(), col.validity());
+                }
+                else if constexpr (std::is_same_v<T, int> || std::is_same_v<T, double> || std::is_same_v<T, std::int64_t>)
+                    return std::make_unique<value_accumulator<T>>(spec.kind, typed.values(), col.validity());
+                else
+                    throw std::runtime_error("Cannot aggregate non-numeric column: " + spec.column);
+            });
+        }
+
+        // Groups and accumulators for the row ranges one worker ran
+        struct group_partial {
+            group_table table;
+            std::vector<std::unique_ptr<group_accumulator>> accumulators;
+
+            group_partial(const key_columns& keys, const data_frame& df, const std::vector<aggregate>& specs) : table(keys) {
+                for (const auto& spec : specs) accumulators.push_back(make_accumulator(spec, df));
+            }
+
+            void run(const key_columns& keys, size_t begin, size_t end) {
+                constexpr size_t batch = 1024;
+                std::uint64_t hashes[batch];
+                std::uint32_t groups[batch];
+                for (size_t b = begin; b < end; b += batch) {
+                    size_t n = std::min(batch, end - b);
+                    keys.hash(b, n, hashes);
+                    for (size_t i = 0; i < n; ++i) groups[i] = table.insert(hashes[i], b + i);
+                    for (auto& acc : accumulators) acc->update(b, std::span<const std::uint32_t>(groups, n), table.size());
+                }
+            }
+
+            void merge(const group_partial& other) {
+                const auto& rows = other.table.first_rows();
+                std::vector<std::uint32_t> remap(rows.size());
+                for (std::uint32_t g = 0; g < rows.size(); ++g) {
+                    remap[g] = table.insert(other.table.hash_of(g), rows[g]);
+                    table.lower_first_row(remap[g], rows[g]);
+                }
+                for (size_t a = 0; a < accumulators.size(); ++a)
+                    accumulators[a]->merge(*other.accumulators[a], remap, table.size());
+            }
+        };
+    }
+
+    // Result of data_frame::group_by(); agg() runs the aggregation. Groups appear in the order
+    // of their first row, with the key columns first and then one column per aggregate.
+    class grouped_frame {
+        data_frame source_;
+        std::vector<std::string> keys_;
+
+    public:
+        grouped_frame(data_frame source, std::vector<std::string> keys)
+            : source_(std::move(source)), keys_(std::move(keys)) {
+            if (keys_.empty()) throw std::runtime_error("group_by needs at least one key column");
+            for (const auto& k : keys_) source_.column_position(k);
+        }
+
+        const std::vector<std::string>& keys() const { return keys_; }
+
+        // With a pool, each worker aggregates the morsels it claims into its own partial
+        // table; the partials are merged at the end and the groups put back in first-row
+        // order. Must not be called from one of the pool's own workers.
+        data_frame agg(const std::vector<aggregate>& specs, thread_pool* pool = nullptr) const {
+            detail::key_columns keys(source_, keys_);
+            const size_t rows = source_.rowCount();
+
+            const size_t workers = detail::morsel_workers(pool, rows);
+            detail::group_partial result(keys, source_, specs);
+            if (workers < 2) {
+                result.run(keys, 0, rows);
+            }
+            else {
+                std::vector<std::unique_ptr<detail::group_partial>> partials;
+                for (size_t w = 0; w < workers; ++w) partials.push_back(std::make_unique<detail::group_partial>(keys, source_, specs));
+                detail::for_each_morsel(pool, workers, rows, [&](size_t w, size_t begin, size_t end) { partials[w]->run(keys, begin, end); });
+                for (const auto& p : partials) result.merge(*p);
+            }
+
+            auto first_rows = result.table.first_rows();
+            std::vector<size_t> order;
+            if (!std::is_sorted(first_rows.begin(), first_rows.end())) {
+                order.resize(first_rows.size());
+                std::iota(order.begin(), order.end(), size_t{ 0 });
+                std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return first_rows[a] < first_rows[b]; });
+                std::sort(first_rows.begin(), first_rows.end());
+            }
+
+            data_frame out;
+            for (const auto& k : keys_)
+                out.add_column(k, source_.column_at(source_.column_position(k)).gather(first_rows));
+            for (size_t a = 0; a < specs.size(); ++a) {
+                auto name = specs[a].output_name();
+                auto column = result.accumulators[a]->finish(name);
+                out.add_column(name, order.empty() ? std::move(column) : column->gather(order));
+            }
+            return out;
+        }
+    };
+
+    inline grouped_frame data_frame::group_by(std::vector<std::string> keys) const {
+        return grouped_frame(*this, std::move(keys));
+    }
+
+} // namespace framework
@@ -0,0 +1,228 @@
+#pragma once
+
+#include "column_kernels.hpp"
+#include "data_frame.hpp"
+#include "key_columns.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace framework {
+
+    namespace detail {
+        // A predicate value as the column's T, where comparing it as T matches the scan in
+        // filter.hpp: the same type, or an int literal against int64 / double
+        template<typename T>
+        std::optional<T> compare_value(const data_value& v) {
+            if (auto* same = std::get_if<T>(&v)) return *same;
+            if constexpr (std::is_same_v<T, std::int64_t> || std::is_same_v<T, double>) {
+                if (auto* i = std::get_if<int>(&v)) return static_cast<T>(*i);
+            }
+            return std::nullopt;
+        }
+
+        template<typename T>
+        bool is_nan(const T& v) {
+            if constexpr (std::is_floating_point_v<T>) return v != v;
+            else return false;
+        }
+
+        inline void check_index_rows(size_t rows) {
+            if (rows >= std::numeric_limits<std::uint32_t>::max()) throw std::runtime_error("Column too large to index");
+        }
+
+        // Distinct values in an open-addressing table, each heading a chain of its rows in
+        // ascending order. Appends link new rows onto the chain tails. NaN keys equal each
+        // other, as in join; null rows are left out.
+        template<typename T>
+        class hash_index final : public column_index {
+            struct slot {
+                std::uint64_t hash;
+                std::uint32_t key;
+            };
+            static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+            std::vector<slot> slots_;
+            std::vector<T> keys_;
+            std::vector<std::uint64_t> hashes_;
+            std::vector<std::uint32_t> head_, tail_, count_; // per key
+            std::vector<std::uint32_t> next_;                // per row
+            size_t rows_ = 0;
+
+            void grow() {
+                std::vector<slot> next(std::max<size_t>(slots_.size() * 2, 1024), slot{ 0, none });
+                size_t mask = next.size() - 1;
+                for (std::uint32_t k = 0; k < keys_.size(); ++k) {
+                    size_t i = hashes_[k] & mask;
+                    while (next[i].key != none) i = (i + 1) & mask;
+                    next[i] = slot{ hashes_[k], k };
+                }
+                slots_.swap(next);
+            }
+
+            std::uint32_t find(const T& v, std::uint64_t hash) const {
+                size_t mask = slots_.size() - 1;
+                for (size_t i = hash & mask; slots_[i].key != none; i = (i + 1) & mask)
+                    if (slots_[i].hash == hash && key_equal(keys_[slots_[i].key], v)) return slots_[i].key;
+                return none;
+            }
+
+        public:
+            hash_index() { grow(); }
+
+            index_kind kind() const override { return index_kind::hash; }
+            size_t rows() const override { return rows_; }
+            std::shared_ptr<column_index> clone() const override { return std::make_shared<hash_index>(*this); }
+
+            void extend(const IColumn& col) override {
+                check_index_rows(col.size());
+                auto values = static_cast<const typed_column<T>&>(col).values();
+                const auto* validity = col.validity();
+                next_.resize(values.size(), none);
+                for (size_t r = rows_; r < values.size(); ++r) {
+                    if (validity && !((validity[r / 64] >> (r % 64)) & 1)) continue;
+                    std::uint64_t hash = mix64(key_hash(values[r]));
+                    std::uint32_t k = find(values[r], hash);
+                    if (k == none) {
+                        if ((keys_.size() + 1) * 2 > slots_.size()) grow();
+                        size_t mask = slots_.size() - 1, i = hash & mask;
+                        while (slots_[i].key != none) i = (i + 1) & mask;
+                        k = static_cast<std::uint32_t>(keys_.size());
+                        slots_[i] = slot{ hash, k };
+                        keys_.push_back(values[r]);
+                        hashes_.push_back(hash);
+                        head_.push_back(static_cast<std::uint32_t>(r));
+                        tail_.push_back(static_cast<std::uint32_t>(r));
+                        count_.push_back(1);
+                        continue;
+                    }
+                    next_[tail_[k]] = static_cast<std::uint32_t>(r);
+                    tail_[k] = static_cast<std::uint32_t>(r);
+                    ++count_[k];
+                }
+                rows_ = values.size();
+            }
+
+            // Calls f(row) for every row equal to v, ascending
+            template<typename F>
+            void for_each_equal(const T& v, F&& f) const {
+                std::uint32_t k = find(v, mix64(key_hash(v)));
+                if (k == none) return;
+                for (std::uint32_t r = head_[k]; r != none; r = next_[r]) f(static_cast<size_t>(r));
+            }
+
+            bool lookup(const IColumn&, kernels::compare_op op, const data_value& value, size_t limit, std::vector<size_t>& out) const override {
+                auto v = compare_value<T>(value);
+                if (op != kernels::compare_op::eq || !v) return false;
+                if (is_nan(*v)) return true; // NaN == x is false for every x
+                std::uint32_t k = find(*v, mix64(key_hash(*v)));
+                if (k == none) return true;
+                if (count_[k] > limit) return false;
+                out.reserve(out.size() + count_[k]);
+                for (std::uint32_t r = head_[k]; r != none; r = next_[r]) out.push_back(r);
+                return true;
+            }
+        };
+
+        // Non-null, non-NaN rows ordered by value (ties by row), plus the rows appended since
+        // the last merge. Appends go to the unsorted tail, which is sorted and merged into
+        // the order once it reaches an eighth of it, so growing a row at a time stays cheap;
+        // lookups binary search the order and scan the tail.
+        template<typename T>
+        class sorted_index final : public column_index {
+            std::vector<std::uint32_t> order_, pending_;
+            size_t rows_ = 0;
+
+            void merge(std::span<const T> values) {
+                auto less = [&](std::uint32_t a, std::uint32_t b) { return values[a] < values[b] || (!(values[b] < values[a]) && a < b); };
+                std::sort(pending_.begin(), pending_.end(), less);
+                size_t mid = order_.size();
+                order_.insert(order_.end(), pending_.begin(), pending_.end());
+                std::inplace_merge(order_.begin(), order_.begin() + mid, order_.end(), less);
+                pending_.clear();
+            }
+
+            static bool matches(const T& x, kernels::compare_op op, const T& v) {
+                switch (op) {
+                case kernels::compare_op::eq: return x == v;
+                case kernels::compare_op::lt: return x < v;
+                case kernels::compare_op::le: return x <= v;
+                case kernels::compare_op::gt: return x > v;
+                case kernels::compare_op::ge: return x >= v;
+                default: return false;
+                }
+            }
+
+        public:
+            index_kind kind() const override { return index_kind::sorted; }
+            size_t rows() const override { return rows_; }
+            std::shared_ptr<column_index> clone() const override { return std::make_shared<sorted_index>(*this); }
+
+            void extend(const IColumn& col) override {
+                check_index_rows(col.size());
+                auto values = static_cast<const typed_column<T>&>(col).values();
+                const auto* validity = col.validity();
+                for (size_t r = rows_; r < values.size(); ++r) {
+                    if (validity && !((validity[r / 64] >> (r % 64)) & 1)) continue;
+                    if (!is_nan(values[r])) pending_.push_back(static_cast<std::uint32_t>(r));
+                }
+                rows_ = values.size();
+                if (pending_.size() >= std::max<size_t>(order_.size() / 8, 4096) || order_.empty()) merge(values);
+            }
+
+            bool lookup(const IColumn& col, kernels::compare_op op, const data_value& value, size_t limit, std::vector<size_t>& out) const override {
+                auto v = compare_value<T>(value);
+                if (op == kernels::compare_op::ne || !v) return false;
+                if (is_nan(*v)) return true;
+                auto values = static_cast<const typed_column<T>&>(col).values();
+                auto lower = [&](bool inclusive) {
+                    return std::partition_point(order_.begin(), order_.end(),
+                        [&](std::uint32_t r) { return inclusive ? values[r] < *v : !(*v < values[r]); });
+                };
+                auto first = order_.begin(), last = order_.end();
+                switch (op) {
+                case kernels::compare_op::eq: first = lower(true); last = lower(false); break;
+                case kernels::compare_op::lt: last = lower(true); break;
+                case kernels::compare_op::le: last = lower(false); break;
+                case kernels::compare_op::gt: first = lower(false); break;
+                case kernels::compare_op::ge: first = lower(true); break;
+                default: break;
+                }
+                if (static_cast<size_t>(last - first) > limit) return false;
+                size_t begin = out.size();
+                out.insert(out.end(), first, last);
+                for (std::uint32_t r : pending_)
+                    if (matches(values[r], op, *v)) out.push_back(r);
+                if (out.size() - begin > limit) {
+                    out.resize(begin);
+                    return false;
+                }
+                return true;
+            }
+        };
+    }
+
+    inline void data_frame::create_index(const std::string& column, index_kind kind) {
+        const IColumn& col = *columns_[column_position(column)];
+        std::shared_ptr<column_index> index;
+        visit_column(col, [&](const auto& typed) {
+            using T = typename std::decay_t<decltype(typed)>::value_type;
+            if constexpr (std::is_same_v<T, bool>) throw std::runtime_error("Unsupported index column: " + column);
+            else if (kind == index_kind::hash) index = std::make_shared<detail::hash_index<T>>();
+            else index = std::make_shared<detail::sorted_index<T>>();
+        });
+        index->extend(col);
+        std::erase_if(indexes_, [&](const detail::index_entry& e) { return e.column == column && e.index->kind() == kind; });
+        indexes_.push_back(detail::index_entry{ column, std::move(index) });
+    }
+
+} // namespace framework
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace framework {
+
+    enum class job_kind : std::uint8_t { once = 0, every = 1, daily = 2 };
+
+    // What to do with persisted jobs whose fire time passed while the process was down
+    enum class misfire_policy {
+        fire_now, // run once immediately, then continue the schedule
+        skip      // drop one-shot jobs, move recurring ones to their next future occurrence
+    };
+
+    struct job_record {
+        std::uint64_t id = 0;
+        job_kind kind = job_kind::once;
+        std::int64_t next_fire_ns = 0; // system_clock, since epoch
+        std::int64_t spec_ns = 0;      // every: period; daily: local time of day
+        std::string handler;
+    };
+
+    // Append-only log of job upserts and removals, compacted by rewriting the live set.
+    // Layout: 8-byte magic, then records of [u32 size][u8 op][u64 id], where puts continue with
+    // [u8 kind][i64 next_fire][i64 spec][handler bytes]. A torn record at the tail (crash
+    // mid-append) is truncated away on load.
+    class job_store {
+    public:
+        explicit job_store(std::filesystem::path path) : path_(std::move(path)) {}
+
+        job_store(const job_store&) = delete;
+        job_store& operator=(const job_store&) = delete;
+
+        // Stream the whole log in one pass; live jobs come back ordered by next fire time
+        std::vector<job_record> load() {
+            out_.close();
+            std::unordered_map<std::uint64_t, job_record> live;
+            std::uintmax_t good = sizeof(magic);
+            records_ = 0;
+
+            if (std::filesystem::exists(path_)) {
+                std::ifstream in(path_, std::ios::binary);
+                char head[sizeof(magic)] = {};
+                in.read(head, sizeof(head));
+                if (in.gcount() == sizeof(head)) {
+                    if (std::memcmp(head, magic, sizeof(magic)) != 0)
+                        throw std::runtime_error("job_store: not a job log: " + path_.string());
+                    live.reserve(static_cast<std::size_t>(std::filesystem::file_size(path_) / 40));
+                    good += scan(in, live);
+                }
+                else {
+                    good = 0;
+                }
+            }
+            else {
+                good = 0;
+            }
+
+            if (good == 0) {
+                std::ofstream init(path_, std::ios::binary | std::ios::trunc);
+                init.write(magic, sizeof(magic));
+                if (!init) throw std::runtime_error("job_store: cannot create " + path_.string());
+            }
+            else if (good < std::filesystem::file_size(path_)) {
+                std::filesystem::resize_file(path_, good);
+            }
+            open_append();
+
+            std::vector<job_record> jobs;
+            jobs.reserve(live.size());
+            for (auto& [id, r] : live) jobs.push_back(std::move(r));
+            std::sort(jobs.begin(), jobs.end(), [](const job_record& a, const job_record& b) {
+                return a.next_fire_ns != b.next_fire_ns ? a.next_fire_ns < b.next_fire_ns : a.id < b.id;
+            });
+            return jobs;
+        }
+
+        void put(const job_record& r) {
+            char buf[record_capacity];
+            append(buf, encode_put(buf, r));
+        }
+
+        void remove(std::uint64_t id) {
+            char buf[header_size];
+            append(buf, encode_head(buf, op_remove, id, 0));
+        }
+
+        void flush() {
+            if (out_.is_open()) out_.flush();
+        }
+
+        // Records in the log; once this dwarfs the live set, compact()
+        std::size_t record_count() const { return records_; }
+        bool should_compact(std::size_t live) const { return records_ > 4096 && records_ > 2 * live; }
+
+        // Rewrite the log to hold exactly `live`, replacing the old file atomically
+        void compact(const std::vector<job_record>& live) {
+            auto tmp = path_;
+            tmp += ".tmp";
+            out_.close();
+            {
+                std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+                out.write(magic, sizeof(magic));
+                char buf[record_capacity];
+                for (const auto& r : live) out.write(buf, static_cast<std::streamsize>(encode_put(buf, r)));
+                if (!out) throw std::runtime_error("job_store: compaction failed: " + tmp.string());
+            }
+            std::filesystem::rename(tmp, path_);
+            records_ = live.size();
+            open_append();
+        }
+
+        const std::filesystem::path& path() const { return path_; }
+
+    private:
+        static constexpr char magic[8] = { 'F', 'W', 'J', 'O', 'B', 'S', '0', '1' };
+        static constexpr std::uint8_t op_put = 1;
+        static constexpr std::uint8_t op_remove = 2;
+        static constexpr std::size_t header_size = 4 + 1 + 8;
+        static constexpr std::size_t put_size = 1 + 8 + 8;
+        static constexpr std::size_t max_handler = 1024;
+        static constexpr std::size_t record_capacity = header_size + put_size + max_handler;
+
+        static std::size_t encode_head(char* buf, std::uint8_t op, std::uint64_t id, std::size_t body) {
+            std::uint32_t size = static_cast<std::uint32_t>(1 + 8 + body);
+            std::memcpy(buf, &size, 4);
+            buf[4] = static_cast<char>(op);
+            std::memcpy(buf + 5, &id, 8);
+            return header_size;
+        }
+
+        static std::size_t encode_put(char* buf, const job_record& r) {
+            if (r.handler.size() > max_handler) throw std::invalid_argument("job_store: handler name too long");
+            std::size_t n = encode_head(buf, op_put, r.id, put_size + r.handler.size());
+            buf[n++] = static_cast<char>(r.kind);
+            std::memcpy(buf + n, &r.next_fire_ns, 8); n += 8;
+            std::memcpy(buf + n, &r.spec_ns, 8); n += 8;
+            std::memcpy(buf + n, r.handler.data(), r.handler.size());
+            return n + r.handler.size();
+        }
+
+        void open_append() {
+            out_.open(path_, std::ios::binary | std::ios::app);
+            if (!out_) throw std::runtime_error("job_store: cannot open " + path_.string());
+        }
+
+        void append(const char* buf, std::size_t n) {
+            out_.write(buf, static_cast<std::streamsize>(n));
+            if (!out_) throw std::runtime_error("job_store: write failed: " + path_.string());
+            ++records_;
+        }
+
+        // Parse records in large blocks; returns the byte length of the intact prefix
+        std::uintmax_t scan(std::ifstream& in, std::unordered_map<std::uint64_t, job_record>& live) {
+            constexpr std::size_t block = 1 << 22;
+            std::vector<char> buf(block);
+            std::size_t begin = 0, end = 0;
+            std::uintmax_t consumed = 0;
+
+            for (;;) {
+                if (end - begin < 4 + max_handler + header_size + put_size) {
+                    std::memmove(buf.data(), buf.data() + begin, end - begin);
+                    end -= begin;
+                    begin = 0;
+                    in.read(buf.data() + end, static_cast<std::streamsize>(buf.size() - end));
+                    end += static_cast<std::size_t>(in.gcount());
+                }
+                if (end - begin < 4) break;
+
+                std::uint32_t size;
+                std::memcpy(&size, buf.data() + begin, 4);
+                if (size < 9 || size > 9 + put_size + max_handler || end - begin < 4 + size) break;
+
+                const char* p = buf.data() + begin + 4;
+                std::uint8_t op = static_cast<std::uint8_t>(p[0]);
+                std::uint64_t id;
+                std::memcpy(&id, p + 1, 8);
+                if (op == op_put && size >= 9 + put_size) {
+                    job_record r;
+                    r.id = id;
+                    r.kind = static_cast<job_kind>(p[9]);
+                    std::memcpy(&r.next_fire_ns, p + 10, 8);
+                    std::memcpy(&r.spec_ns, p + 18, 8);
+                    r.handler.assign(p + 26, size - 9 - put_size);
+                    live.insert_or_assign(id, std::move(r));
+                }
+                else if (op == op_remove) {
+                    live.erase(id);
+                }
+                else {
+                    break;
+                }
+
+                ++records_;
+                begin += 4 + size;
+                consumed += 4 + size;
+            }
+            return consumed;
+        }
+
+        std::filesystem::path path_;
+        std::ofstream out_;
+        std::size_t records_ = 0;
+    };
+
+} // namespace framework
@@ -0,0 +1,350 @@
+#pragma once
+
+#include "data_frame.hpp"
+#include "index.hpp"
+#include "key_columns.hpp"
+#include "morsel.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace framework {
+
+    namespace detail {
+        // Matched row pairs in left row order; right is empty for semi/anti joins and
+        // holds no_row for the unmatched rows of a left join
+        struct join_pairs {
+            std::vector<size_t> left;
+            std::vector<size_t> right;
+        };
+
+        // Collects the output pairs of one left row at a time according to the join kind
+        class join_emitter {
+            join_kind how_;
+            join_pairs& out_;
+        public:
+            join_emitter(join_kind how, join_pairs& out) : how_(how), out_(out) {}
+
+            // True when a semi/anti join no longer needs the remaining matches of this row
+            bool match(size_t l, size_t r) {
+                if (how_ == join_kind::semi) { out_.left.push_back(l); return true; }
+                if (how_ == join_kind::anti) return true;
+                out_.left.push_back(l);
+                out_.right.push_back(r);
+                return false;
+            }
+
+            void finish(size_t l, bool matched) {
+                if (matched) return;
+                if (how_ == join_kind::anti) out_.left.push_back(l);
+                else if (how_ == join_kind::left) { out_.left.push_back(l); out_.right.push_back(no_row); }
+            }
+        };
+
+        // Build-side table: one slot per distinct hash, the build rows with that hash chained
+        // in ascending order so matches come out in right row order
+        class join_table {
+            struct slot {
+                std::uint64_t hash;
+                std::uint32_t head;
+            };
+            static constexpr std::uint32_t empty = std::numeric_limits<std::uint32_t>::max();
+
+            std::vector<slot> slots_;
+            std::vector<std::uint32_t> next_;
+            const size_t* rows_;
+
+        public:
+            join_table(const size_t* rows, const std::uint64_t* hashes, size_t n) : rows_(rows) {
+                if (n >= empty) throw std::runtime_error("Join build side too large");
+                slots_.assign(std::bit_ceil(std::max<size_t>(n * 2, 16)), slot{ 0, empty });
+                next_.assign(n, empty);
+                size_t mask = slots_.size() - 1;
+                for (size_t i = n; i-- > 0;) {
+                    for (size_t s = hashes[i] & mask;; s = (s + 1) & mask) {
+                        if (slots_[s].head == empty) { slots_[s] = slot{ hashes[i], static_cast<std::uint32_t>(i) }; break; }
+                        if (slots_[s].hash == hashes[i]) { next_[i] = slots_[s].head; slots_[s].head = static_cast<std::uint32_t>(i); break; }
+                    }
+                }
+            }
+
+            // Calls f(right_row) for each build row with this hash
+            template<typename F>
+            void probe(std::uint64_t hash, F&& f) const {
+                size_t mask = slots_.size() - 1;
+                for (size_t s = hash & mask; slots_[s].head != empty; s = (s + 1) & mask) {
+                    if (slots_[s].hash != hash) continue;
+                    for (std::uint32_t j = slots_[s].head; j != empty; j = next_[j]) f(rows_[j]);
+                    return;
+                }
+            }
+        };
+
+        // Pairs of each morsel of left rows, probed on the pool by probe(begin, end, out), then
+        // concatenated in morsel order so the result stays in left row order
+        template<typename F>
+        join_pairs probe_morsels(thread_pool* pool, size_t nl, F&& probe) {
+            const size_t morsels = (nl + morsel_rows - 1) / morsel_rows;
+            const size_t workers = morsel_workers(pool, nl);
+            if (workers < 2) {
+                join_pairs out;
+                probe(0, nl, out);
+                return out;
+            }
+            std::vector<join_pairs> parts(morsels);
+            for_each_claimed(pool, workers, morsels, [&](size_t, size_t m) {
+                probe(m * morsel_rows, std::min(nl, (m + 1) * morsel_rows), parts[m]);
+            });
+            std::vector<size_t> offsets(morsels + 1, 0);
+            for (size_t m = 0; m < morsels; ++m) offsets[m + 1] = offsets[m] + parts[m].left.size();
+            join_pairs out;
+            out.left.resize(offsets.back());
+            // Semi and anti joins emit no right rows; any morsel may be the first with a match
+            if (std::any_of(parts.begin(), parts.end(), [](const join_pairs& p) { return !p.right.empty(); })) out.right.resize(offsets.back());
+            for_each_claimed(pool, workers, morsels, [&](size_t, size_t m) {
+                std::copy(parts[m].left.begin(), parts[m].left.end(), out.left.begin() + offsets[m]);
+                if (!out.right.empty()) std::copy(parts[m].right.begin(), parts[m].right.end(), out.right.begin() + offsets[m]);
+                parts[m] = {};
+            });
+            return out;
+        }
+
+        // Hashes of rows [0, n) of keys, a morsel per worker at a time
+        inline std::vector<std::uint64_t> hash_morsels(const key_columns& keys, size_t n, thread_pool* pool) {
+            std::vector<std::uint64_t> hashes(n);
+            for_each_morsel(pool, morsel_workers(pool, n), n, [&](size_t, size_t begin, size_t end) {
+                keys.hash(begin, end - begin, hashes.data() + begin);
+            });
+            return hashes;
+        }
+
+        // Probes a chunk of rows at a time: hash hits are collected as candidate pairs, their
+        // keys compared in one typed pass per key column, then emitted in probe order. The
+        // left rows are rows[i], or base + i without rows.
+        inline void probe_rows(const key_columns& lk, const key_columns& rk, const join_table& table,
+            const size_t* rows, size_t base, const std::uint64_t* hashes, size_t n, join_emitter& emit) {
+            constexpr size_t chunk = 2048;
+            std::vector<size_t> cand_l, cand_r;
+            std::vector<std::uint8_t> keep;
+            for (size_t c0 = 0; c0 < n; c0 += chunk) {
+                size_t c1 = std::min(n, c0 + chunk);
+                cand_l.clear();
+                cand_r.clear();
+                for (size_t i = c0; i < c1; ++i) {
+                    size_t l = rows ? rows[i] : base + i;
+                    table.probe(hashes[i], [&](size_t r) { cand_l.push_back(l); cand_r.push_back(r); });
+                }
+                keep.assign(cand_l.size(), 1);
+                lk.equal_rows(rk, cand_l.data(), cand_r.data(), cand_l.size(), keep.data());
+
+                size_t k = 0;
+                for (size_t i = c0; i < c1; ++i) {
+                    size_t l = rows ? rows[i] : base + i;
+                    bool matched = false, done = false;
+                    for (; k < cand_l.size() && cand_l[k] == l; ++k) {
+                        if (!keep[k] || done) continue;
+                        matched = true;
+                        done = emit.match(l, cand_r[k]);
+                    }
+                    emit.finish(l, matched);
+                }
+            }
+        }
+
+        // Stable scatter of rows into 2^bits partitions by the top hash bits
+        inline void radix_partition(const std::vector<std::uint64_t>& hashes, unsigned bits,
+            std::vector<size_t>& offsets, std::vector<size_t>& rows, std::vector<std::uint64_t>& part_hashes) {
+            const size_t parts = size_t{ 1 } << bits;
+            offsets.assign(parts + 1, 0);
+            for (auto h : hashes) ++offsets[(h >> (64 - bits)) + 1];
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+            std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+            rows.resize(hashes.size());
+            part_hashes.resize(hashes.size());
+            for (size_t i = 0; i < hashes.size(); ++i) {
+                size_t at = cursor[hashes[i] >> (64 - bits)]++;
+                rows[at] = i;
+                part_hashes[at] = hashes[i];
+            }
+        }
+
+        // Build rows per partition, sized so a partition's table stays in L2. Partitioning only
+        // pays once the whole table (~36 bytes per build row) no longer fits in the last-level cache.
+        inline constexpr size_t join_partition_rows = 1 << 14;
+        inline constexpr size_t join_partition_threshold = 1 << 20;
+
+        // With a pool the hashing, the probes of the unpartitioned table and whole partitions
+        // run across its workers
+        inline join_pairs hash_join(const key_columns& lk, size_t nl, const key_columns& rk, size_t nr, join_kind how, thread_pool* pool) {
+            auto rh = hash_morsels(rk, nr, pool);
+            auto lh = hash_morsels(lk, nl, pool);
+            auto reserve = [&](join_pairs& out, size_t rows) {
+                if (how != join_kind::inner && how != join_kind::left) return;
+                out.left.reserve(rows);
+                out.right.reserve(rows);
+            };
+
+            if (nr <= join_partition_threshold) {
+                std::vector<size_t> rows(nr);
+                std::iota(rows.begin(), rows.end(), size_t{ 0 });
+                join_table table(rows.data(), rh.data(), nr);
+                return probe_morsels(pool, nl, [&](size_t begin, size_t end, join_pairs& out) {
+                    reserve(out, end - begin);
+                    join_emitter emit(how, out);
+                    probe_rows(lk, rk, table, nullptr, begin, lh.data() + begin, end - begin, emit);
+                });
+            }
+
+            // Partition both sides so each build table and its probes stay cache-resident,
+            // then restore left row order with a counting sort on the left row
+            unsigned bits = std::min(12u, static_cast<unsigned>(std::bit_width(nr / join_partition_rows)));
+            std::vector<size_t> roff, rrows, loff, lrows;
+            std::vector<std::uint64_t> rph, lph;
+            radix_partition(rh, bits, roff, rrows, rph);
+            radix_partition(lh, bits, loff, lrows, lph);
+            rh = {};
+            lh = {};
+
+            const size_t parts = roff.size() - 1;
+            std::vector<join_pairs> part_pairs(parts);
+            for_each_claimed(pool, morsel_workers(pool, nl + nr), parts, [&](size_t, size_t p) {
+                reserve(part_pairs[p], loff[p + 1] - loff[p]);
+                join_emitter emit(how, part_pairs[p]);
+                join_table table(rrows.data() + roff[p], rph.data() + roff[p], roff[p + 1] - roff[p]);
+                probe_rows(lk, rk, table, lrows.data() + loff[p], 0, lph.data() + loff[p], loff[p + 1] - loff[p], emit);
+            });
+
+            std::vector<size_t> start(nl + 1, 0);
+            size_t total = 0;
+            for (const auto& part : part_pairs) {
+                for (size_t l : part.left) ++start[l + 1];
+                total += part.left.size();
+            }
+            std::partial_sum(start.begin(), start.end(), start.begin());
+            join_pairs ordered;
+            ordered.left.resize(total);
+            if (how != join_kind::semi && how != join_kind::anti) ordered.right.resize(total);
+            for (const auto& part : part_pairs)
+                for (size_t i = 0; i < part.left.size(); ++i) {
+                    size_t at = start[part.left[i]]++;
+                    ordered.left[at] = part.left[i];
+                    if (!part.right.empty()) ordered.right[at] = part.right[i];
+                }
+            return ordered;
+        }
+
+        // Single-key join probing a hash index on the right key, one left row at a time,
+        // instead of hashing the right side; false when right has no usable index
+        inline bool index_join(const data_frame& left, const std::string& left_on, const data_frame& right,
+            const std::string& right_on, join_kind how, thread_pool* pool, join_pairs& pairs) {
+            const column_index* index = right.find_index(right_on, index_kind::hash);
+            const IColumn& lcol = left.column_at(left.column_position(left_on));
+            if (!index || lcol.type() != right.column_at(right.column_position(right_on)).type()) return false;
+            bool joined = false;
+            visit_column(lcol, [&](const auto& typed) {
+                using T = typename std::decay_t<decltype(typed)>::value_type;
+                if constexpr (!std::is_same_v<T, bool>) {
+                    auto* table = dynamic_cast<const hash_index<T>*>(index);
+                    if (!table) return;
+                    auto values = typed.values();
+                    pairs = probe_morsels(pool, values.size(), [&](size_t begin, size_t end, join_pairs& out) {
+                        join_emitter emit(how, out);
+                        if (how == join_kind::inner || how == join_kind::left) {
+                            out.left.reserve(end - begin);
+                            out.right.reserve(end - begin);
+                        }
+                        for (size_t l = begin; l < end; ++l) {
+                            bool matched = false, done = false;
+                            if (!lcol.is_null(l)) table->for_each_equal(values[l], [&](size_t r) {
+                                if (done) return;
+                                matched = true;
+                                done = emit.match(l, r);
+                            });
+                            emit.finish(l, matched);
+                        }
+                    });
+                    joined = true;
+                }
+            });
+            return joined;
+        }
+
+        // Both sides already in key order: one forward pass, no table
+        inline join_pairs merge_join(const key_columns& lk, size_t nl, const key_columns& rk, size_t nr, join_kind how) {
+            join_pairs out;
+            join_emitter emit(how, out);
+            size_t j = 0;
+            for (size_t i = 0; i < nl;) {
+                while (j < nr && lk.compare(i, rk, j) > 0) ++j;
+                if (j == nr || lk.compare(i, rk, j) < 0) {
+                    emit.finish(i++, false);
+                    continue;
+                }
+                size_t end = j + 1;
+                while (end < nr && rk.compare(j, rk, end) == 0) ++end;
+                for (; i < nl && lk.compare(i, rk, j) == 0; ++i) {
+                    for (size_t r = j; r < end; ++r)
+                        if (emit.match(i, r)) break;
+                    emit.finish(i, true);
+                }
+                j = end;
+            }
+            return out;
+        }
+    }
+
+    inline data_frame data_frame::join(const data_frame& right, const std::vector<std::string>& on, join_kind how, thread_pool* pool) const {
+        return join(right, on, on, how, pool);
+    }
+
+    // Hash join with the right frame as build side, or a merge join when both sides are
+    // already sorted on the keys, or probes of the right's hash index on a single key. Output columns are gathered column-at-a-time: all left
+    // columns, then the right non-key columns (suffixed "_right" on a name clash). With a
+    // pool, hash and index joins probe morsels of left rows in parallel and the columns are
+    // gathered in parallel; the merge join stays a single pass. Must not be called from one
+    // of the pool's own workers.
+    inline data_frame data_frame::join(const data_frame& right, const std::vector<std::string>& left_on,
+        const std::vector<std::string>& right_on, join_kind how, thread_pool* pool) const {
+        if (left_on.empty() || left_on.size() != right_on.size()) throw std::runtime_error("Join key count mismatch");
+        detail::key_columns lk(*this, left_on), rk(right, right_on, &lk);
+        if (!lk.compatible(rk)) throw std::runtime_error("Join key type mismatch");
+
+        const size_t nl = rowCount(), nr = right.rowCount();
+        detail::join_pairs pairs;
+        if (left_on.size() > 1 || !detail::index_join(*this, left_on[0], right, right_on[0], how, pool, pairs)) {
+            pairs = lk.sorted() && rk.sorted()
+                ? detail::merge_join(lk, nl, rk, nr, how)
+                : detail::hash_join(lk, nl, rk, nr, how, pool);
+        }
+
+        // (name, source column, rows to gather) of every output column
+        std::vector<std::tuple<std::string, const IColumn*, const std::vector<size_t>*>> outputs;
+        auto left_names = column_names();
+        for (size_t c = 0; c < left_names.size(); ++c) outputs.emplace_back(left_names[c], columns_[c].get(), &pairs.left);
+        if (how != join_kind::semi && how != join_kind::anti) {
+            auto right_names = right.column_names();
+            for (size_t c = 0; c < right_names.size(); ++c) {
+                auto key = std::find(right_on.begin(), right_on.end(), right_names[c]);
+                if (key != right_on.end() && left_on[key - right_on.begin()] == *key) continue;
+                bool clash = std::find(left_names.begin(), left_names.end(), right_names[c]) != left_names.end();
+                outputs.emplace_back(clash ? right_names[c] + "_right" : right_names[c], &right.column_at(c), &pairs.right);
+            }
+        }
+
+        std::vector<std::shared_ptr<IColumn>> gathered(outputs.size());
+        auto gather = [&](size_t c) { gathered[c] = std::get<1>(outputs[c])->gather(*std::get<2>(outputs[c])); };
+        if (pool && pairs.left.size() >= morsel_rows) detail::run_tasks(pool, outputs.size(), gather);
+        else for (size_t c = 0; c < outputs.size(); ++c) gather(c);
+
+        data_frame out;
+        for (size_t c = 0; c < outputs.size(); ++c) out.add_column(std::get<0>(outputs[c]), std::move(gathered[c]));
+        return out;
+    }
+
+} // namespace framework
@@ -0,0 +1,227 @@
+#pragma once
+
+#include "data_frame.hpp"
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+// Typed key access shared by the hash operators (group_by, join)
+namespace framework::detail {
+
+    inline std::uint64_t mix64(std::uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    inline std::uint64_t key_hash(int v) { return static_cast<std::uint32_t>(v); }
+    inline std::uint64_t key_hash(std::int64_t v) { return static_cast<std::uint64_t>(v); }
+    inline std::uint64_t key_hash(timestamp v) { return static_cast<std::uint64_t>(v.time_since_epoch().count()); }
+    inline std::uint64_t key_hash(bool v) { return v ? 1 : 0; }
+    inline std::uint64_t key_hash(const std::string& v) { return std::hash<std::string_view>{}(v); }
+    inline std::uint64_t key_hash(double v) {
+        if (v == 0.0) v = 0.0;                                        // -0.0 matches 0.0
+        if (std::isnan(v)) v = std::numeric_limits<double>::quiet_NaN(); // and NaN matches NaN
+        return std::bit_cast<std::uint64_t>(v);
+    }
+
+    // Three-way key order; NaN sorts last and equals itself, so keys form a total order
+    template<typename T>
+    int key_compare(const T& a, const T& b) {
+        if constexpr (std::is_floating_point_v<T>) {
+            if (a != a || b != b) return (a != a) - (b != b);
+        }
+        return a < b ? -1 : (b < a ? 1 : 0);
+    }
+
+    template<typename T>
+    bool key_equal(const T& a, const T& b) {
+        if constexpr (std::is_floating_point_v<T>) return a == b || (a != a && b != b);
+        else return a == b;
+    }
+
+    // Key columns of a frame, resolved once to their typed storage. Rows are hashed a batch
+    // at a time, one tight loop per key column, rather than a row at a time across columns.
+    // Dictionary-encoded string keys are hashed and compared as their int codes. A null key
+    // equals another null for grouping (equal) but never matches in a join (equal_rows).
+    class key_columns {
+        struct dictionary_codes {
+            std::span<const int> codes;
+        };
+        using column_ref = std::variant<std::span<const int>, std::span<const double>,
+            std::span<const std::string>, const data_column<bool>*, dictionary_codes,
+            std::span<const std::int64_t>, std::span<const timestamp>>;
+        std::vector<column_ref> cols_;
+        std::vector<const std::uint64_t*> validity_;
+        std::vector<const dictionary_column*> dicts_;
+        std::vector<std::vector<int>> translated_;
+
+        template<typename C>
+        static decltype(auto) at(const C& col, size_t row) {
+            if constexpr (std::is_pointer_v<C>) return static_cast<bool>(col->data[row]);
+            else if constexpr (std::is_same_v<C, dictionary_codes>) return col.codes[row];
+            else return col[row];
+        }
+
+        static bool valid(const std::uint64_t* validity, size_t row) {
+            return !validity || ((validity[row / 64] >> (row % 64)) & 1);
+        }
+
+        // Codes in the reference column's code space, -1 where the value is absent there
+        dictionary_codes translate(const dictionary_column& ref, const IColumn& col) {
+            auto& codes = translated_.emplace_back();
+            if (auto* dict = dynamic_cast<const dictionary_column*>(&col)) {
+                std::vector<int> remap;
+                remap.reserve(dict->dictionary().size());
+                for (const auto& v : dict->dictionary()) remap.push_back(ref.code_of(v));
+                codes.reserve(dict->size());
+                for (int c : dict->codes()) codes.push_back(remap[c]);
+            }
+            else {
+                auto values = static_cast<const typed_column<std::string>&>(col).values();
+                codes.reserve(values.size());
+                for (const auto& v : values) codes.push_back(ref.code_of(v));
+            }
+            return dictionary_codes{ codes };
+        }
+
+    public:
+        // With a reference (the other side of a join), string keys are resolved so that rows
+        // compare across the two frames: codes are translated into the reference's dictionary
+        // when it has one, and decoded when it does not.
+        key_columns(const data_frame& df, const std::vector<std::string>& names, const key_columns* reference = nullptr) {
+            for (size_t k = 0; k < names.size(); ++k) {
+                const auto& name = names[k];
+                const IColumn& col = df.column_at(df.column_position(name));
+                auto* dict = dynamic_cast<const dictionary_column*>(&col);
+                const dictionary_column* ref = reference && k < reference->dicts_.size() ? reference->dicts_[k] : nullptr;
+                dicts_.push_back(dict);
+                validity_.push_back(col.validity());
+                if (ref && col.type() == data_type::string) {
+                    if (dict && dict->shares_dictionary(*ref)) cols_.emplace_back(dictionary_codes{ dict->codes() });
+                    else cols_.emplace_back(translate(*ref, col));
+                    continue;
+                }
+                if (dict && !reference) {
+                    cols_.emplace_back(dictionary_codes{ dict->codes() });
+                    continue;
+                }
+                visit_column(col, [&](const auto& typed) {
+                    using T = typename std::decay_t<decltype(typed)>::value_type;
+                    if constexpr (std::is_same_v<T, bool>) {
+                        auto* bits = dynamic_cast<const data_column<bool>*>(&col);
+                        if (!bits) throw std::runtime_error("Unsupported key column: " + name);
+                        cols_.emplace_back(bits);
+                    }
+                    else {
+                        cols_.emplace_back(typed.values());
+                    }
+                });
+            }
+        }
+
+        // Columns may point into translated_
+        key_columns(const key_columns&) = delete;
+        key_columns& operator=(const key_columns&) = delete;
+
+        size_t size() const { return cols_.size(); }
+
+        // True when other's keys have the same count and types, so rows can be compared across frames
+        bool compatible(const key_columns& other) const {
+            if (cols_.size() != other.cols_.size()) return false;
+            for (size_t k = 0; k < cols_.size(); ++k)
+                if (cols_[k].index() != other.cols_[k].index()) return false;
+            return true;
+        }
+
+        void hash(size_t begin, size_t n, std::uint64_t* out) const {
+            std::fill_n(out, n, 0x9e3779b97f4a7c15ULL);
+            for (size_t k = 0; k < cols_.size(); ++k) {
+                const auto* validity = validity_[k];
+                std::visit([&](const auto& col) {
+                    if (!validity) {
+                        for (size_t i = 0; i < n; ++i)
+                            out[i] = mix64(out[i] ^ key_hash(at(col, begin + i)));
+                        return;
+                    }
+                    // A null row's value is whatever the storage holds, so nulls hash alike
+                    for (size_t i = 0; i < n; ++i)
+                        out[i] = mix64(out[i] ^ (valid(validity, begin + i) ? key_hash(at(col, begin + i)) : 0x6e756c6cULL));
+                }, cols_[k]);
+            }
+        }
+
+        bool equal(size_t a, size_t b) const {
+            for (size_t k = 0; k < cols_.size(); ++k) {
+                bool va = valid(validity_[k], a);
+                if (va != valid(validity_[k], b)) return false;
+                if (!va) continue;
+                bool same = std::visit([&](const auto& col) { return key_equal(at(col, a), at(col, b)); }, cols_[k]);
+                if (!same) return false;
+            }
+            return true;
+        }
+
+        // Row a of this frame against row b of a compatible() one
+        int compare(size_t a, const key_columns& other, size_t b) const {
+            for (size_t k = 0; k < cols_.size(); ++k) {
+                int c = std::visit([&](const auto& x, const auto& y) {
+                    if constexpr (std::is_same_v<decltype(x), decltype(y)>) return key_compare(at(x, a), at(y, b));
+                    else return 0;
+                }, cols_[k], other.cols_[k]);
+                if (c) return c;
+            }
+            return 0;
+        }
+
+        // keep[i] &= (row a[i] equals row b[i] of other), one pass per key column
+        void equal_rows(const key_columns& other, const size_t* a, const size_t* b, size_t n, std::uint8_t* keep) const {
+            for (size_t k = 0; k < cols_.size(); ++k) {
+                std::visit([&](const auto& x, const auto& y) {
+                    if constexpr (std::is_same_v<decltype(x), decltype(y)>) {
+                        for (size_t i = 0; i < n; ++i) keep[i] &= key_equal(at(x, a[i]), at(y, b[i]));
+                    }
+                    else {
+                        std::fill_n(keep, n, std::uint8_t{ 0 });
+                    }
+                }, cols_[k], other.cols_[k]);
+                const auto* va = validity_[k];
+                const auto* vb = other.validity_[k];
+                if (va || vb) {
+                    for (size_t i = 0; i < n; ++i) keep[i] &= valid(va, a[i]) && valid(vb, b[i]);
+                }
+            }
+        }
+
+        // Whether rows are in non-decreasing key order; never for dictionary codes, whose
+        // order is first appearance rather than value order, or for keys with nulls
+        bool sorted() const {
+            for (const auto& ref : cols_)
+                if (std::holds_alternative<dictionary_codes>(ref)) return false;
+            for (const auto* validity : validity_)
+                if (validity) return false;
+            size_t n = 0;
+            if (!cols_.empty()) std::visit([&](const auto& col) {
+                using C = std::decay_t<decltype(col)>;
+                if constexpr (std::is_pointer_v<C>) n = col->data.size();
+                else if constexpr (std::is_same_v<C, dictionary_codes>) n = col.codes.size();
+                else n = col.size();
+            }, cols_[0]);
+            for (size_t i = 1; i < n; ++i)
+                if (compare(i - 1, *this, i) > 0) return false;
+            return true;
+        }
+    };
+
+} // namespace framework::detail
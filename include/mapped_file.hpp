@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace framework {
+
+    // Read-only memory mapping of a whole file. Pages are faulted in on first access, so
+    // opening costs the same for any file size.
+    class mapped_file {
+    public:
+        explicit mapped_file(const std::filesystem::path& path) {
+#ifdef _WIN32
+            file_ = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file_ == INVALID_HANDLE_VALUE) throw_error("open " + path.string());
+            LARGE_INTEGER size{};
+            if (!GetFileSizeEx(file_, &size)) { close(); throw_error("size " + path.string()); }
+            size_ = static_cast<std::size_t>(size.QuadPart);
+            if (size_ == 0) return;
+            mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mapping_) { close(); throw_error("map " + path.string()); }
+            data_ = static_cast<const std::byte*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+            if (!data_) { close(); throw_error("map " + path.string()); }
+#else
+            fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd_ < 0) throw_error("open " + path.string());
+            struct stat st {};
+            if (::fstat(fd_, &st) != 0) { close(); throw_error("stat " + path.string()); }
+            size_ = static_cast<std::size_t>(st.st_size);
+            if (size_ == 0) return;
+            void* p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+            if (p == MAP_FAILED) { close(); throw_error("mmap " + path.string()); }
+            data_ = static_cast<const std::byte*>(p);
+#endif
+        }
+
+        ~mapped_file() { close(); }
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        const std::byte* data() const { return data_; }
+        std::size_t size() const { return size_; }
+
+        // Hint that the mapping will be read front to back (read-ahead, no reuse)
+        void advise_sequential() const {
+#ifndef _WIN32
+            if (data_) ::madvise(const_cast<std::byte*>(data_), size_, MADV_SEQUENTIAL);
+#endif
+        }
+
+    private:
+        [[noreturn]] static void throw_error(const std::string& context) {
+#ifdef _WIN32
+            std::error_code ec(static_cast<int>(GetLastError()), std::system_category());
+#else
+            std::error_code ec(errno, std::generic_category());
+#endif
+            throw std::system_error(ec, "mapped_file: " + context);
+        }
+
+        void close() {
+#ifdef _WIN32
+            if (data_) UnmapViewOfFile(data_);
+            if (mapping_) CloseHandle(mapping_);
+            if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+            mapping_ = nullptr;
+            file_ = INVALID_HANDLE_VALUE;
+#else
+            if (data_) ::munmap(const_cast<std::byte*>(data_), size_);
+            if (fd_ >= 0) ::close(fd_);
+            fd_ = -1;
+#endif
+            data_ = nullptr;
+        }
+
+#ifdef _WIN32
+        HANDLE file_ = INVALID_HANDLE_VALUE;
+        HANDLE mapping_ = nullptr;
+#else
+        int fd_ = -1;
+#endif
+        const std::byte* data_ = nullptr;
+        std::size_t size_ = 0;
+    };
+
+} // namespace framework
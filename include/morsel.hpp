@@ -0,0 +1,59 @@
+#pragma once
+
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <future>
+#include <vector>
+
+namespace framework {
+
+    // Parallel operators cut their rows into morsels that the pool's workers claim one at
+    // a time from a shared counter, so a worker that finishes early takes more and skewed
+    // morsels even out. Each worker keeps its own state (partial aggregates, hash pieces,
+    // output masks) which the operator merges once every morsel is done. A multiple of 64,
+    // so morsels start on whole mask and validity words.
+    inline constexpr size_t morsel_rows = 1 << 16;
+
+    namespace detail {
+        // Runs f(0) .. f(tasks - 1), on the pool when there is more than one
+        template<typename F>
+        void run_tasks(thread_pool* pool, size_t tasks, F&& f) {
+            if (tasks < 2) {
+                f(size_t{ 0 });
+                return;
+            }
+            std::vector<std::future<void>> done;
+            for (size_t t = 0; t < tasks; ++t) done.push_back(pool->enqueue([&f, t] { f(t); }));
+            for (auto& fut : done) fut.wait();
+            for (auto& fut : done) fut.get();
+        }
+
+        // Workers worth starting for rows rows: one without a pool, otherwise no more than
+        // the pool has or there are morsels
+        inline size_t morsel_workers(thread_pool* pool, size_t rows) {
+            if (!pool) return 1;
+            return std::clamp<size_t>((rows + morsel_rows - 1) / morsel_rows, 1, pool->size());
+        }
+
+        // Calls f(worker, i) for every i in [0, count), each worker claiming the next i not
+        // yet taken, so every worker sees its i in ascending order
+        template<typename F>
+        void for_each_claimed(thread_pool* pool, size_t workers, size_t count, F&& f) {
+            std::atomic<size_t> next{ 0 };
+            run_tasks(pool, workers, [&](size_t w) {
+                for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < count;) f(w, i);
+            });
+        }
+
+        // Calls f(worker, begin, end) for every morsel of [0, rows)
+        template<typename F>
+        void for_each_morsel(thread_pool* pool, size_t workers, size_t rows, F&& f) {
+            for_each_claimed(pool, workers, (rows + morsel_rows - 1) / morsel_rows, [&](size_t w, size_t m) {
+                f(w, m * morsel_rows, std::min(rows, (m + 1) * morsel_rows));
+            });
+        }
+    }
+
+} // namespace framework
@@ -0,0 +1,311 @@
+#pragma once
+
+#include "columnar_file.hpp"
+#include "csv.hpp"
+#include "data_frame.hpp"
+#include "expression.hpp"
+#include "group_by.hpp"
+#include "morsel.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace framework {
+
+    namespace detail {
+        inline std::string join_names(const std::vector<std::string>& names) {
+            std::string out = "[";
+            for (size_t i = 0; i < names.size(); ++i) out += (i ? ", " : "") + names[i];
+            return out + "]";
+        }
+
+        // Whether a block with these statistics cannot hold a row where `column op literal`
+        // (or `literal op column`) is true. Anything else, or NaN statistics, keeps the block.
+        inline bool rules_out(const expr_node& n, const std::string& column, const columnar::block_stats& stats) {
+            if (n.op < expr_op::eq || n.op > expr_op::ge || std::isnan(stats.min) || std::isnan(stats.max)) return false;
+            const expr_node *c = n.lhs.get(), *l = n.rhs.get();
+            expr_op op = n.op;
+            if (c->op == expr_op::literal) {
+                std::swap(c, l);
+                switch (op) { // v < col  ==  col > v
+                case expr_op::lt: op = expr_op::gt; break;
+                case expr_op::le: op = expr_op::ge; break;
+                case expr_op::gt: op = expr_op::lt; break;
+                case expr_op::ge: op = expr_op::le; break;
+                default: break;
+                }
+            }
+            if (c->op != expr_op::column || c->column != column || l->op != expr_op::literal) return false;
+            double v;
+            if (auto* i = std::get_if<int>(&l->value)) v = *i;
+            else if (auto* d = std::get_if<double>(&l->value)) v = *d;
+            else return false;
+            switch (op) {
+            case expr_op::eq: return v < stats.min || v > stats.max;
+            case expr_op::ne: return stats.min == v && stats.max == v;
+            case expr_op::lt: return stats.min >= v;
+            case expr_op::le: return stats.min > v;
+            case expr_op::gt: return stats.max <= v;
+            case expr_op::ge: return stats.max < v;
+            default: return false;
+            }
+        }
+
+        // Block min/max of a mapped numeric column, if it has them
+        inline std::optional<std::pair<std::span<const columnar::block_stats>, size_t>> block_stats_of(const IColumn& col) {
+            if (auto* m = dynamic_cast<const mapped_column<int>*>(&col)) return std::make_pair(m->block_stats(), m->block_rows());
+            if (auto* m = dynamic_cast<const mapped_column<double>*>(&col)) return std::make_pair(m->block_stats(), m->block_rows());
+            return std::nullopt;
+        }
+    }
+
+    // Logical plan over an in-memory frame, a columnar file or a CSV file, e.g.
+    //   query::scan_columnar("trades.fwc").filter(col("px") > 10.0)
+    //       .group_by({"symbol"}, {sum("qty"), count()}).collect();
+    // Nothing is read until collect(). Filters and selects ahead of the first group_by are
+    // pushed into the scan: only the columns the plan uses are parsed (CSV) or touched
+    // (mapped), and mapped blocks whose min/max statistics rule out a conjunct of the filter
+    // are skipped without reading them. explain() prints the plan that collect() runs.
+    // collect(pool) runs the scan's filter, its gathers and each later step on the pool.
+    class query {
+    public:
+        static query from(data_frame df) {
+            query q;
+            q.kind_ = source_kind::frame;
+            q.frame_ = std::move(df);
+            return q;
+        }
+
+        static query scan_columnar(std::filesystem::path path) {
+            query q;
+            q.kind_ = source_kind::columnar;
+            q.path_ = std::move(path);
+            return q;
+        }
+
+        static query scan_csv(std::filesystem::path path, csv_options opts = {}) {
+            query q;
+            q.kind_ = source_kind::csv;
+            q.path_ = std::move(path);
+            q.csv_ = std::move(opts);
+            return q;
+        }
+
+        query filter(expr condition) const { return then(step{ step_kind::filter, std::move(condition), {}, {} }); }
+        query select(std::vector<std::string> columns) const { return then(step{ step_kind::select, std::nullopt, std::move(columns), {} }); }
+        query group_by(std::vector<std::string> keys, std::vector<aggregate> specs) const {
+            return then(step{ step_kind::group_by, std::nullopt, std::move(keys), std::move(specs) });
+        }
+
+        std::string explain() const {
+            auto p = optimize();
+            std::ostringstream out;
+            size_t depth = 0;
+            for (size_t i = p.rest.size(); i-- > 0; ++depth) {
+                const auto& s = p.rest[i];
+                out << std::string(depth * 2, ' ');
+                if (s.kind == step_kind::filter) out << "Filter " << s.condition->to_string() << "\n";
+                else if (s.kind == step_kind::select) out << "Select " << detail::join_names(s.columns) << "\n";
+                else {
+                    std::vector<std::string> names;
+                    for (const auto& a : s.specs) names.push_back(a.output_name());
+                    out << "GroupBy keys=" << detail::join_names(s.columns) << " aggregates=" << detail::join_names(names) << "\n";
+                }
+            }
+            auto indent = std::string(depth * 2, ' ');
+            out << indent << "Scan ";
+            if (kind_ == source_kind::frame) out << "frame (" << frame_.rowCount() << " rows)";
+            else out << (kind_ == source_kind::columnar ? "columnar " : "csv ") << path_;
+            out << " columns=" << (p.scan_columns ? detail::join_names(*p.scan_columns) : "*") << "\n";
+            if (!p.conjuncts.empty()) {
+                out << indent << "  pushed filter: " << conjunction(p.conjuncts).to_string() << "\n";
+                if (kind_ == source_kind::columnar) {
+                    auto df = data_frame::open_mmap(path_);
+                    auto ranges = kept_ranges(df, p.conjuncts);
+                    if (ranges.blocks) out << indent << "  block skipping: " << ranges.kept << " of " << ranges.blocks << " blocks kept\n";
+                }
+            }
+            if (p.output && p.output != p.scan_columns) out << indent << "  output: " << detail::join_names(*p.output) << "\n";
+            return out.str();
+        }
+
+        data_frame collect(thread_pool* pool = nullptr) const {
+            auto p = optimize();
+            data_frame source;
+            switch (kind_) {
+            case source_kind::frame: source = frame_; break;
+            case source_kind::columnar: source = data_frame::open_mmap(path_); break;
+            case source_kind::csv: {
+                auto opts = csv_;
+                if (p.scan_columns) opts.columns = *p.scan_columns;
+                if (!opts.pool) opts.pool = pool;
+                source = read_csv(path_, opts);
+                break;
+            }
+            }
+            const auto output = p.output ? *p.output : source.column_names();
+
+            data_frame out;
+            if (p.conjuncts.empty()) {
+                out = source.select(output);
+            }
+            else {
+                // The kept ranges cut into morsels, claimed by the pool's workers
+                std::vector<std::pair<size_t, size_t>> morsels;
+                for (auto [begin, end] : kept_ranges(source, p.conjuncts).ranges)
+                    for (; begin < end; begin += morsel_rows) morsels.emplace_back(begin, std::min(end, begin + morsel_rows));
+                const size_t workers = pool ? std::clamp<size_t>(morsels.size(), 1, pool->size()) : 1;
+                auto roots = detail::compile_workers(conjunction(p.conjuncts).node(), source, workers);
+                std::vector<std::uint64_t> mask(kernels::mask_words(source.rowCount()), 0);
+                detail::for_each_claimed(pool, workers, morsels.size(), [&](size_t w, size_t m) {
+                    detail::expr_mask(*roots[w], morsels[m].first, morsels[m].second, mask.data());
+                });
+                auto rows = kernels::mask_to_indices(mask.data(), source.rowCount());
+                std::vector<std::shared_ptr<IColumn>> gathered(output.size());
+                auto gather = [&](size_t c) { gathered[c] = source.column_at(source.column_position(output[c])).gather(rows); };
+                if (pool && rows.size() >= morsel_rows) detail::run_tasks(pool, output.size(), gather);
+                else for (size_t c = 0; c < output.size(); ++c) gather(c);
+                for (size_t c = 0; c < output.size(); ++c) out.add_column(output[c], std::move(gathered[c]));
+            }
+
+            for (const auto& s : p.rest) {
+                if (s.kind == step_kind::filter) out = out.filter(*s.condition, pool).materialize();
+                else if (s.kind == step_kind::select) out = out.select(s.columns);
+                else out = out.group_by(s.columns).agg(s.specs, pool);
+            }
+            return out;
+        }
+
+    private:
+        enum class source_kind { frame, columnar, csv };
+        enum class step_kind { filter, select, group_by };
+
+        struct step {
+            step_kind kind;
+            std::optional<expr> condition;
+            std::vector<std::string> columns; // select: columns, group_by: keys
+            std::vector<aggregate> specs;
+        };
+
+        // What the scan reads and does, and what runs on its result. Column lists are empty
+        // optionals for "every source column".
+        struct plan {
+            std::optional<std::vector<std::string>> scan_columns;
+            std::vector<expr> conjuncts;
+            std::optional<std::vector<std::string>> output;
+            std::vector<step> rest;
+        };
+
+        struct row_ranges {
+            std::vector<std::pair<size_t, size_t>> ranges;
+            size_t blocks = 0; // 0 when no statistics applied
+            size_t kept = 0;
+        };
+
+        query then(step s) const {
+            query q = *this;
+            q.steps_.push_back(std::move(s));
+            return q;
+        }
+
+        static expr conjunction(const std::vector<expr>& conjuncts) {
+            expr e = conjuncts.front();
+            for (size_t i = 1; i < conjuncts.size(); ++i) e = e && conjuncts[i];
+            return e;
+        }
+
+        static void require(const std::optional<std::vector<std::string>>& available, const std::vector<std::string>& names) {
+            if (!available) return;
+            for (const auto& name : names)
+                if (std::find(available->begin(), available->end(), name) == available->end())
+                    throw std::runtime_error("Unknown column: " + name);
+        }
+
+        plan optimize() const {
+            plan p;
+            size_t i = 0;
+            for (; i < steps_.size() && steps_[i].kind != step_kind::group_by; ++i) {
+                const auto& s = steps_[i];
+                if (s.kind == step_kind::filter) {
+                    std::vector<std::string> used;
+                    detail::expr_columns(s.condition->node(), used);
+                    require(p.output, used);
+                    for (auto& c : s.condition->conjuncts()) p.conjuncts.push_back(std::move(c));
+                }
+                else {
+                    require(p.output, s.columns);
+                    p.output = s.columns;
+                }
+            }
+            p.rest.assign(steps_.begin() + static_cast<std::ptrdiff_t>(i), steps_.end());
+
+            // A group_by only needs its keys and aggregated columns from the scan
+            if (!p.rest.empty()) {
+                const auto& g = p.rest.front();
+                std::vector<std::string> needed = g.columns;
+                for (const auto& a : g.specs)
+                    if (!a.column.empty() && std::find(needed.begin(), needed.end(), a.column) == needed.end()) needed.push_back(a.column);
+                require(p.output, needed);
+                p.output = needed;
+            }
+
+            if (p.output) {
+                auto columns = *p.output;
+                for (const auto& c : p.conjuncts) detail::expr_columns(c.node(), columns);
+                p.scan_columns = std::move(columns);
+            }
+            return p;
+        }
+
+        // Row ranges worth evaluating: blocks not ruled out by any conjunct's statistics
+        static row_ranges kept_ranges(const data_frame& df, const std::vector<expr>& conjuncts) {
+            row_ranges r;
+            const size_t rows = df.rowCount();
+            std::vector<std::pair<const detail::expr_node*, std::span<const columnar::block_stats>>> tests;
+            size_t block_rows = 0;
+            for (const auto& c : conjuncts) {
+                std::vector<std::string> used;
+                detail::expr_columns(c.node(), used);
+                if (used.size() != 1 || !df.has_column(used[0])) continue;
+                auto stats = detail::block_stats_of(df.column_at(df.column_position(used[0])));
+                // Batches start on whole validity words, so blocks must too
+                if (!stats || stats->second % 64 || (block_rows && stats->second != block_rows)) continue;
+                block_rows = stats->second;
+                tests.emplace_back(&c.node(), stats->first);
+            }
+            if (tests.empty()) {
+                if (rows) r.ranges.emplace_back(0, rows);
+                return r;
+            }
+
+            r.blocks = (rows + block_rows - 1) / block_rows;
+            for (size_t b = 0; b < r.blocks; ++b) {
+                bool keep = true;
+                for (const auto& [node, stats] : tests) {
+                    std::vector<std::string> used;
+                    detail::expr_columns(*node, used);
+                    if (b < stats.size() && detail::rules_out(*node, used[0], stats[b])) { keep = false; break; }
+                }
+                if (!keep) continue;
+                ++r.kept;
+                size_t begin = b * block_rows, end = std::min(rows, begin + block_rows);
+                if (!r.ranges.empty() && r.ranges.back().second == begin) r.ranges.back().second = end;
+                else r.ranges.emplace_back(begin, end);
+            }
+            return r;
+        }
+
+        source_kind kind_ = source_kind::frame;
+        data_frame frame_;
+        std::filesystem::path path_;
+        csv_options csv_;
+        std::vector<step> steps_;
+    };
+
+} // namespace framework
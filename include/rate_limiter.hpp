@@ -0,0 +1,262 @@
+#pragma once
+
+#include "timer_service.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace framework {
+
+    namespace detail {
+        inline std::int64_t steady_ns() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
+
+    // Lock-free token bucket, implemented as GCRA: the whole state is a single atomic
+    // "theoretical arrival time", so an uncontended acquire is one load and one CAS.
+    class rate_limiter {
+    public:
+        rate_limiter(double permits_per_second, std::size_t burst) {
+            if (permits_per_second <= 0.0 || burst == 0) throw std::invalid_argument("rate_limiter: rate and burst must be positive");
+            interval_ns_ = std::max<std::int64_t>(1, static_cast<std::int64_t>(1e9 / permits_per_second));
+            capacity_ns_ = interval_ns_ * static_cast<std::int64_t>(burst);
+            tat_.store(detail::steady_ns(), std::memory_order_relaxed);
+        }
+
+        bool try_acquire(std::size_t permits = 1) {
+            const std::int64_t now = detail::steady_ns();
+            const std::int64_t cost = interval_ns_ * static_cast<std::int64_t>(permits);
+            std::int64_t tat = tat_.load(std::memory_order_relaxed);
+            for (;;) {
+                std::int64_t next = std::max(tat, now) + cost;
+                if (next - now > capacity_ns_) return false;
+                if (tat_.compare_exchange_weak(tat, next, std::memory_order_relaxed)) return true;
+            }
+        }
+
+        // Time until `permits` could be acquired (zero if available now)
+        std::chrono::nanoseconds wait_time(std::size_t permits = 1) const {
+            const std::int64_t now = detail::steady_ns();
+            const std::int64_t cost = interval_ns_ * static_cast<std::int64_t>(permits);
+            std::int64_t next = std::max(tat_.load(std::memory_order_relaxed), now) + cost;
+            return std::chrono::nanoseconds(std::max<std::int64_t>(0, next - now - capacity_ns_));
+        }
+
+        // Whole tokens currently in the bucket
+        std::size_t available() const {
+            const std::int64_t now = detail::steady_ns();
+            std::int64_t used = std::max<std::int64_t>(0, tat_.load(std::memory_order_relaxed) - now);
+            return static_cast<std::size_t>((capacity_ns_ - used) / interval_ns_);
+        }
+
+    private:
+        std::int64_t interval_ns_;
+        std::int64_t capacity_ns_;
+        std::atomic<std::int64_t> tat_;
+    };
+
+    // Sliding-window counter: the window is split into sub-windows, each one atomic word
+    // packing (epoch << 32 | count). Acquire increments first and rolls back on overflow,
+    // so the limit is never exceeded even under contention.
+    class sliding_window_limiter {
+    public:
+        sliding_window_limiter(std::uint32_t limit, std::chrono::nanoseconds window, std::size_t slots = 16)
+            : limit_(limit), slots_(slots) {
+            if (limit == 0 || slots == 0 || window.count() < static_cast<std::int64_t>(slots))
+                throw std::invalid_argument("sliding_window_limiter: invalid limit/window");
+            slot_ns_ = window.count() / static_cast<std::int64_t>(slots);
+        }
+
+        bool try_acquire(std::uint32_t permits = 1) {
+            const std::uint64_t epoch = current_epoch();
+            auto& slot = slots_[epoch % slots_.size()];
+            std::uint64_t word = slot.load(std::memory_order_relaxed);
+            for (;;) {
+                std::uint64_t next = epoch_of(word) == static_cast<std::uint32_t>(epoch)
+                    ? word + permits
+                    : pack(epoch, permits);
+                if (slot.compare_exchange_weak(word, next, std::memory_order_acq_rel)) break;
+            }
+            if (count_at(epoch) <= limit_) return true;
+
+            // Roll back, unless the slot already moved on to a newer epoch
+            word = slot.load(std::memory_order_relaxed);
+            while (epoch_of(word) == static_cast<std::uint32_t>(epoch)
+                && !slot.compare_exchange_weak(word, word - permits, std::memory_order_acq_rel)) {
+            }
+            return false;
+        }
+
+        // Permits granted within the current window
+        std::uint64_t count() const { return count_at(current_epoch()); }
+
+    private:
+        static std::uint64_t pack(std::uint64_t epoch, std::uint32_t n) { return (epoch << 32) | n; }
+        static std::uint32_t epoch_of(std::uint64_t word) { return static_cast<std::uint32_t>(word >> 32); }
+
+        std::uint64_t current_epoch() const { return static_cast<std::uint64_t>(detail::steady_ns() / slot_ns_); }
+
+        std::uint64_t count_at(std::uint64_t epoch) const {
+            std::uint64_t total = 0;
+            for (const auto& s : slots_) {
+                std::uint64_t word = s.load(std::memory_order_acquire);
+                std::uint32_t age = static_cast<std::uint32_t>(epoch) - epoch_of(word);
+                if (age < slots_.size()) total += static_cast<std::uint32_t>(word);
+            }
+            return total;
+        }
+
+        std::uint32_t limit_;
+        std::int64_t slot_ns_;
+        std::vector<std::atomic<std::uint64_t>> slots_;
+    };
+
+    // Runs fn once, `delay` after the last call of a burst. Calls only store a deadline;
+    // a timer on the shared timer_service is armed for the first call of each burst and
+    // re-arms itself while the deadline keeps moving.
+    class debouncer {
+    public:
+        debouncer(std::chrono::nanoseconds delay, std::function<void()> fn, timer_service& timers = timer_service::shared())
+            : state_(std::make_shared<state>(delay.count(), std::move(fn), timers)) {
+        }
+
+        ~debouncer() {
+            state_->closed.store(true, std::memory_order_release);
+            cancel();
+        }
+
+        debouncer(const debouncer&) = delete;
+        debouncer& operator=(const debouncer&) = delete;
+
+        void operator()() {
+            state_->deadline.store(detail::steady_ns() + state_->delay_ns, std::memory_order_release);
+            if (!state_->armed.exchange(true, std::memory_order_acq_rel)) arm(state_, state_->generation.load(std::memory_order_acquire));
+        }
+
+        // Drop a pending invocation; the next call starts a new burst. Timers of the dropped
+        // burst still in flight see a newer generation and do nothing. A run that has already
+        // started is not waited for and may still be in fn when this returns.
+        void cancel() {
+            state_->generation.fetch_add(1, std::memory_order_acq_rel);
+            state_->timers.cancel(state_->timer.load(std::memory_order_acquire));
+            state_->armed.store(false, std::memory_order_release);
+        }
+
+    private:
+        struct state {
+            state(std::int64_t d, std::function<void()> f, timer_service& t) : delay_ns(d), fn(std::move(f)), timers(t) {}
+            std::int64_t delay_ns;
+            std::function<void()> fn;
+            timer_service& timers;
+            std::atomic<std::int64_t> deadline{ 0 };
+            std::atomic<bool> armed{ false };
+            std::atomic<std::uint64_t> generation{ 0 }; // bumped by cancel()
+            std::atomic<bool> closed{ false };          // set once by the destructor
+            std::atomic<timer_id> timer{ 0 };
+        };
+
+        static void arm(const std::shared_ptr<state>& s, std::uint64_t generation) {
+            auto at = timer_service::clock::time_point(std::chrono::nanoseconds(s->deadline.load(std::memory_order_acquire)));
+            s->timer.store(s->timers.schedule_at(at, [s, generation] { on_timer(s, generation); }), std::memory_order_release);
+        }
+
+        static void on_timer(const std::shared_ptr<state>& s, std::uint64_t generation) {
+            if (s->closed.load(std::memory_order_acquire) || s->generation.load(std::memory_order_acquire) != generation) return;
+            std::int64_t deadline = s->deadline.load(std::memory_order_acquire);
+            if (detail::steady_ns() < deadline) {
+                arm(s, generation);
+                return;
+            }
+            s->armed.store(false, std::memory_order_release);
+            // A call that saw armed == true just before the store would otherwise be lost
+            if (s->deadline.load(std::memory_order_acquire) != deadline && !s->armed.exchange(true, std::memory_order_acq_rel))
+                arm(s, generation);
+            s->fn();
+        }
+
+        std::shared_ptr<state> state_;
+    };
+
+    // Runs fn at most once per interval. The leading call runs inline; with `trailing`,
+    // calls suppressed during the interval collapse into one run when it ends.
+    class throttler {
+    public:
+        throttler(std::chrono::nanoseconds interval, std::function<void()> fn, bool trailing = true,
+            timer_service& timers = timer_service::shared())
+            : state_(std::make_shared<state>(interval.count(), std::move(fn), trailing, timers)) {
+        }
+
+        ~throttler() {
+            state_->cancelled.store(true, std::memory_order_release);
+            state_->timers.cancel(state_->timer.load(std::memory_order_acquire));
+        }
+
+        throttler(const throttler&) = delete;
+        throttler& operator=(const throttler&) = delete;
+
+        // Returns true when fn ran on this call
+        bool operator()() {
+            auto& s = *state_;
+            const std::int64_t now = detail::steady_ns();
+            std::int64_t next = s.next_allowed.load(std::memory_order_relaxed);
+            if (now >= next && s.next_allowed.compare_exchange_strong(next, now + s.interval_ns, std::memory_order_acq_rel)) {
+                // This run covers the calls suppressed before it
+                s.pending.store(false, std::memory_order_release);
+                s.fn();
+                return true;
+            }
+            if (s.trailing) {
+                s.pending.store(true, std::memory_order_release);
+                if (!s.armed.exchange(true, std::memory_order_acq_rel)) arm(state_);
+            }
+            return false;
+        }
+
+    private:
+        struct state {
+            state(std::int64_t i, std::function<void()> f, bool t, timer_service& ts) : interval_ns(i), fn(std::move(f)), trailing(t), timers(ts) {}
+            std::int64_t interval_ns;
+            std::function<void()> fn;
+            bool trailing;
+            timer_service& timers;
+            std::atomic<std::int64_t> next_allowed{ 0 };
+            std::atomic<bool> pending{ false };
+            std::atomic<bool> armed{ false };
+            std::atomic<bool> cancelled{ false };
+            std::atomic<timer_id> timer{ 0 };
+        };
+
+        static void arm(const std::shared_ptr<state>& s) {
+            auto at = timer_service::clock::time_point(std::chrono::nanoseconds(s->next_allowed.load(std::memory_order_acquire)));
+            s->timer.store(s->timers.schedule_at(at, [s] { on_timer(s); }), std::memory_order_release);
+        }
+
+        // Claims the interval like a leading call, so a call landing on the boundary and the
+        // timer cannot both run fn; when a call got there first, waits for its interval
+        static void on_timer(const std::shared_ptr<state>& s) {
+            s->armed.store(false, std::memory_order_release);
+            std::int64_t now, next;
+            do {
+                if (s->cancelled.load(std::memory_order_acquire) || !s->pending.load(std::memory_order_acquire)) return;
+                now = detail::steady_ns();
+                next = s->next_allowed.load(std::memory_order_acquire);
+                if (now < next) {
+                    if (!s->armed.exchange(true, std::memory_order_acq_rel)) arm(s);
+                    return;
+                }
+            } while (!s->next_allowed.compare_exchange_strong(next, now + s->interval_ns, std::memory_order_acq_rel));
+            s->pending.store(false, std::memory_order_release);
+            s->fn();
+        }
+
+        std::shared_ptr<state> state_;
+    };
+
+} // namespace framework
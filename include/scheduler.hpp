@@ -1,75 +1,414 @@
+#pragma once
+
 #include "datetime.hpp"
+#include "job_store.hpp"
+#include "scheduler_stats.hpp"
+#include "thread_pool.hpp"
+#include "timer_service.hpp"
+#include <algorithm>
+#include <deque>
 #include <functional>
-#include <stop_token>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
-#include <vector>
+#include <unordered_map>
 #include <chrono>
 #include <iostream>
 
 namespace framework {
 
+    // All jobs share one timer_service (a single timerfd/epoll pair on Linux) instead of a
+    // sleeping thread per job. Tasks run on a few worker threads of the scheduler's own,
+    // started on the first fire, so a slow task holds up neither the timer thread nor the
+    // other jobs; setExecutor() substitutes a pool of the caller's.
+    // Exceptions escaping a task are caught and counted as failures in snapshot().
+    //
+    // Jobs scheduled by handler name can be persisted to a job_store: call registerHandler()
+    // for every name first, then enablePersistence() to replay the log into the timer queue,
+    // before any job is scheduled so replayed ids cannot collide with live ones.
     class Scheduler {
     public:
+        using clock = timer_service::clock;
+        using job_id = std::uint64_t;
+
+        explicit Scheduler(timer_service::mode mode = timer_service::mode::own_thread)
+            : timers_(mode) {
+        }
+
+        ~Scheduler() {
+            stopAll();
+            {
+                std::scoped_lock lock(mutex_);
+                timers_.cancel(maintenance_);
+                maintenance_ = 0;
+            }
+            timers_.stop();
+            // The queue is FIFO: once this runs, every fired task has started, and the
+            // workers finish those before they join
+            if (workers_) workers_->enqueue([] {}).wait();
+            std::scoped_lock lock(mutex_);
+            if (store_) store_->flush();
+        }
+
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+
         // Run task every interval
-        void runEvery(std::chrono::milliseconds interval, std::function<void()> task) {
-            std::jthread t([interval, task](std::stop_token st) {
-                while (!st.stop_requested()) {
-                    auto next = std::chrono::steady_clock::now() + interval;
-                    task();
-                    std::this_thread::sleep_until(next);
-                }
-                });
-            threads_.push_back(std::move(t));
+        job_id runEvery(std::chrono::milliseconds interval, std::function<void()> task) {
+            return submit(job_kind::every, interval, clock::now(), std::move(task), {});
         }
 
         // Run task at a specific datetime every day (same hour/minute each day)
-        void runDailyAt(const datetime& dt, std::function<void()> task) {
-            std::jthread t([dt, task](std::stop_token st) {
-                using namespace std::chrono;
-                while (!st.stop_requested()) {
-                    auto now = system_clock::now();
-                    std::time_t tnow = system_clock::to_time_t(now);
-                    std::tm tm_now;
+        job_id runDailyAt(const datetime& dt, std::function<void()> task) {
+            auto tod = timeOfDay(dt);
+            return submit(job_kind::daily, tod, toSteady(nextDaily(tod, std::chrono::system_clock::now())), std::move(task), {});
+        }
+
+        // Run task at a specific datetime once
+        job_id runAt(const datetime& dt, std::function<void()> task) {
+            return submit(job_kind::once, {}, toSteady(dt.time_point()), std::move(task), {});
+        }
+
+        // Named-handler variants; persisted when enablePersistence() is active
+        job_id runEvery(std::chrono::milliseconds interval, const std::string& handler) {
+            return submit(job_kind::every, interval, clock::now(), lookup(handler), handler);
+        }
+
+        job_id runDailyAt(const datetime& dt, const std::string& handler) {
+            auto tod = timeOfDay(dt);
+            return submit(job_kind::daily, tod, toSteady(nextDaily(tod, std::chrono::system_clock::now())), lookup(handler), handler);
+        }
+
+        job_id runAt(const datetime& dt, const std::string& handler) {
+            return submit(job_kind::once, {}, toSteady(dt.time_point()), lookup(handler), handler);
+        }
+
+        void registerHandler(const std::string& name, std::function<void()> task) {
+            std::scoped_lock lock(mutex_);
+            handlers_[name] = std::move(task);
+        }
+
+        // Open (or create) the job log, re-arm every persisted job in one pass over the file and
+        // keep the log flushed and compacted every flushInterval. Handlers must be registered.
+        void enablePersistence(const std::string& path, misfire_policy policy = misfire_policy::fire_now,
+            std::chrono::milliseconds flushInterval = std::chrono::seconds(1)) {
+            std::scoped_lock lock(mutex_);
+            if (store_) throw std::runtime_error("Scheduler: persistence already enabled");
+            if (!jobs_.empty()) throw std::runtime_error("Scheduler: enable persistence before scheduling jobs");
+            auto store = std::make_unique<job_store>(path);
+            auto records = store->load();
+
+            for (const auto& r : records) {
+                if (!handlers_.contains(r.handler))
+                    throw std::runtime_error("Scheduler: no handler registered for persisted job '" + r.handler + "'");
+            }
+
+            store_ = std::move(store);
+            const auto now = std::chrono::system_clock::now();
+            for (auto& r : records) {
+                next_job_ = std::max(next_job_, r.id + 1);
+                auto next = std::chrono::system_clock::time_point(
+                    std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(r.next_fire_ns)));
+                const bool misfired = next < now;
+                if (misfired) {
+                    if (policy == misfire_policy::fire_now) {
+                        next = now;
+                    }
+                    else if (r.kind == job_kind::once) {
+                        store_->remove(r.id);
+                        continue;
+                    }
+                    else if (r.kind == job_kind::every) {
+                        auto period = std::chrono::nanoseconds(std::max<std::int64_t>(r.spec_ns, 1));
+                        next += std::chrono::duration_cast<std::chrono::system_clock::duration>(period * ((now - next) / period + 1));
+                    }
+                    else {
+                        next = nextDaily(std::chrono::nanoseconds(r.spec_ns), now);
+                    }
+                }
+                auto& j = jobs_[r.id];
+                j.task = handlers_.at(r.handler);
+                j.handler = std::move(r.handler);
+                j.kind = r.kind;
+                j.spec = std::chrono::nanoseconds(r.spec_ns);
+                ++persisted_;
+                arm(r.id, toSteady(next), misfired);
+            }
+
+            flush_interval_ = flushInterval;
+            maintenance_ = timers_.schedule_after(flush_interval_, [this] { maintain(); });
+        }
+
+        // Cancelling a persisted job also removes it from the log
+        bool cancel(job_id id) {
+            std::scoped_lock lock(mutex_);
+            auto it = jobs_.find(id);
+            if (it == jobs_.end()) return false;
+            timers_.cancel(it->second.timer);
+            forget(it);
+            return true;
+        }
+
+        // Stops every job in this process; persisted jobs stay in the log for the next start
+        void stopAll() {
+            std::scoped_lock lock(mutex_);
+            for (auto& [id, j] : jobs_) {
+                timers_.cancel(j.timer);
+                // Compaction keeps rewriting them, so jobs persisted later are still maintained
+                if (!j.handler.empty()) stopped_.push_back(record(id, j));
+                retire(id, j);
+            }
+            jobs_.clear();
+            if (store_) store_->flush();
+        }
+
+        // Allowed lateness per fire; lets the timer backend coalesce nearby deadlines
+        void setTimerSlack(std::chrono::nanoseconds slack) {
+            std::scoped_lock lock(mutex_);
+            slack_ = std::chrono::duration_cast<clock::duration>(slack);
+        }
+
+        // Run tasks on a pool instead of the scheduler's workers (pool must outlive the
+        // scheduler); nullptr goes back to the workers
+        void setExecutor(thread_pool* pool) {
+            std::scoped_lock lock(mutex_);
+            executor_ = pool;
+        }
+
+        // Reactor integration for timer_service::mode::external
+        int native_handle() const noexcept { return timers_.native_handle(); }
+        std::size_t dispatch() { return timers_.dispatch(); }
+
+        timer_service& timers() noexcept { return timers_; }
+
+        // Lateness/duration histograms over every run, plus per-job counters when perJob is set:
+        // every active job and the last completed_kept jobs that finished or were cancelled
+        scheduler_snapshot snapshot(bool perJob = true) const {
+            scheduler_snapshot s;
+            s.lateness = metrics_->lateness.snapshot();
+            s.duration = metrics_->duration.snapshot();
+            s.runs = s.duration.count;
+            s.failures = metrics_->failures.load(std::memory_order_relaxed);
+
+            std::scoped_lock lock(mutex_);
+            s.active_jobs = jobs_.size();
+            if (perJob) {
+                s.jobs.reserve(jobs_.size() + completed_.size());
+                for (const auto& [id, j] : jobs_) s.jobs.push_back(j.stats->stats(id, j.handler));
+                for (const auto& c : completed_) {
+                    s.jobs.push_back(c.stats->stats(c.id, c.handler));
+                    s.jobs.back().completed = true;
+                }
+                std::sort(s.jobs.begin(), s.jobs.end(), [](const job_stats& a, const job_stats& b) { return a.id < b.id; });
+            }
+            return s;
+        }
+
+        static constexpr std::size_t completed_kept = 256;
+
+    private:
+        struct metrics {
+            latency_histogram lateness;
+            latency_histogram duration;
+            std::atomic<std::uint64_t> failures{ 0 };
+        };
+
+        struct job {
+            std::function<void()> task;
+            job_kind kind = job_kind::once;
+            std::chrono::nanoseconds spec{}; // every: period; daily: local time of day
+            std::string handler;             // non-empty for persisted jobs
+            timer_id timer = 0;
+            clock::time_point deadline{};
+            std::shared_ptr<job_counters> stats = std::make_shared<job_counters>();
+        };
+
+        // Counters of a job no longer scheduled; a one-shot job's run may still record into them
+        struct completed_job {
+            job_id id;
+            std::string handler;
+            std::shared_ptr<job_counters> stats;
+        };
+
+        static clock::time_point toSteady(std::chrono::system_clock::time_point tp) {
+            return clock::now() + std::chrono::duration_cast<clock::duration>(tp - std::chrono::system_clock::now());
+        }
+
+        static std::chrono::system_clock::time_point toSystem(clock::time_point tp) {
+            return std::chrono::system_clock::now() + std::chrono::duration_cast<std::chrono::system_clock::duration>(tp - clock::now());
+        }
+
+        static std::chrono::nanoseconds timeOfDay(const datetime& dt) {
+            return std::chrono::hours(dt.hour()) + std::chrono::minutes(dt.minute()) + std::chrono::seconds(dt.second());
+        }
+
+        static std::chrono::system_clock::time_point nextDaily(std::chrono::nanoseconds tod, std::chrono::system_clock::time_point now) {
+            using namespace std::chrono;
+            std::time_t tnow = system_clock::to_time_t(now);
+            std::tm tm_now;
 #ifdef _WIN32
-                    localtime_s(&tm_now, &tnow);
+            localtime_s(&tm_now, &tnow);
 #else
-                    localtime_r(&tnow, &tm_now);
+            localtime_r(&tnow, &tm_now);
 #endif
-                    tm_now.tm_hour = dt.hour();
-                    tm_now.tm_min = dt.minute();
-                    tm_now.tm_sec = dt.second();
+            hh_mm_ss hms{ duration_cast<seconds>(tod) };
+            tm_now.tm_hour = static_cast<int>(hms.hours().count());
+            tm_now.tm_min = static_cast<int>(hms.minutes().count());
+            tm_now.tm_sec = static_cast<int>(hms.seconds().count());
 
-                    auto next = system_clock::from_time_t(std::mktime(&tm_now));
-                    if (next <= now) next += hours(24);
+            auto next = system_clock::from_time_t(std::mktime(&tm_now));
+            if (next <= now) next += hours(24);
+            return next;
+        }
 
-                    std::this_thread::sleep_until(next);
-                    if (st.stop_requested()) break;
+        std::function<void()> lookup(const std::string& handler) {
+            std::scoped_lock lock(mutex_);
+            auto it = handlers_.find(handler);
+            if (it == handlers_.end()) throw std::runtime_error("Scheduler: unknown handler '" + handler + "'");
+            return it->second;
+        }
 
-                    task();
-                }
-                });
-            threads_.push_back(std::move(t));
+        job_id submit(job_kind kind, std::chrono::nanoseconds spec, clock::time_point first,
+            std::function<void()> task, std::string handler) {
+            std::scoped_lock lock(mutex_);
+            job_id id = next_job_++;
+            auto& j = jobs_[id];
+            j.task = std::move(task);
+            j.kind = kind;
+            j.spec = spec;
+            if (store_ && !handler.empty()) {
+                j.handler = std::move(handler);
+                ++persisted_;
+            }
+            arm(id, first);
+            return id;
         }
 
-        // Run task at a specific datetime once
-        void runAt(const datetime& dt, std::function<void()> task) {
-            std::jthread t([dt, task](std::stop_token st) {
-                auto next = dt.time_point();
-                std::this_thread::sleep_until(next);
-                if (!st.stop_requested()) {
+        // Caller holds mutex_
+        void arm(job_id id, clock::time_point deadline, bool persist = true) {
+            auto& j = jobs_.at(id);
+            j.deadline = deadline;
+            j.timer = timers_.schedule_at(deadline, [this, id, deadline] { fire(id, deadline); }, slack_);
+            if (persist && !j.handler.empty()) store_->put(record(id, j));
+        }
+
+        job_record record(job_id id, const job& j) const {
+            return job_record{ id, j.kind,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(toSystem(j.deadline).time_since_epoch()).count(),
+                j.spec.count(), j.handler };
+        }
+
+        // Caller holds mutex_
+        void retire(job_id id, const job& j) {
+            if (completed_.size() == completed_kept) completed_.pop_front();
+            completed_.push_back(completed_job{ id, j.handler, j.stats });
+        }
+
+        // Caller holds mutex_
+        void forget(std::unordered_map<job_id, job>::iterator it) {
+            if (!it->second.handler.empty()) {
+                store_->remove(it->first);
+                --persisted_;
+            }
+            retire(it->first, it->second);
+            jobs_.erase(it);
+        }
+
+        void fire(job_id id, clock::time_point deadline) {
+            std::function<void()> task;
+            std::shared_ptr<job_counters> counters;
+            thread_pool* pool;
+            {
+                std::scoped_lock lock(mutex_);
+                auto it = jobs_.find(id);
+                if (it == jobs_.end()) return;
+                pool = executor_ ? executor_ : workers();
+                counters = it->second.stats;
+                switch (it->second.kind) {
+                case job_kind::every: {
+                    task = it->second.task;
+                    // Periods missed during a stall or suspend are skipped, not replayed back to back
+                    auto period = std::max(std::chrono::duration_cast<clock::duration>(it->second.spec), clock::duration(1));
+                    auto next = deadline + period;
+                    if (auto now = clock::now(); next <= now) next += period * ((now - next) / period + 1);
+                    arm(id, next);
+                    break;
+                }
+                case job_kind::daily:
+                    task = it->second.task;
+                    // Strictly after now, so a fire that lands a hair early cannot repeat the same day
+                    arm(id, toSteady(nextDaily(it->second.spec, std::chrono::system_clock::now() + std::chrono::seconds(1))));
+                    break;
+                case job_kind::once:
+                    task = std::move(it->second.task);
+                    forget(it);
+                    break;
+                }
+            }
+            auto run = [task = std::move(task), counters, m = metrics_, deadline] {
+                auto start = clock::now();
+                bool failed = false;
+                try {
                     task();
                 }
-                });
-            threads_.push_back(std::move(t));
+                catch (...) {
+                    failed = true;
+                    m->failures.fetch_add(1, std::memory_order_relaxed);
+                }
+                auto lateness = std::chrono::duration_cast<std::chrono::nanoseconds>(start - deadline);
+                auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start);
+                m->lateness.record(lateness);
+                m->duration.record(duration);
+                counters->record(lateness, duration, failed);
+            };
+            try {
+                pool->enqueue(std::move(run));
+            }
+            catch (const std::runtime_error&) {
+                // The executor has stopped: the run is skipped and counted as failed
+                metrics_->failures.fetch_add(1, std::memory_order_relaxed);
+                counters->record(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - deadline),
+                    std::chrono::nanoseconds::zero(), true);
+            }
         }
 
-        void stopAll() {
-            for (auto& t : threads_) t.request_stop();
-            threads_.clear();
+        // Caller holds mutex_
+        thread_pool* workers() {
+            if (!workers_) workers_ = std::make_unique<thread_pool>(std::max(4u, std::thread::hardware_concurrency()));
+            return workers_.get();
         }
 
-    private:
-        std::vector<std::jthread> threads_;
+        void maintain() {
+            std::scoped_lock lock(mutex_);
+            if (!store_ || maintenance_ == 0) return;
+            store_->flush();
+            if (store_->should_compact(persisted_)) {
+                std::vector<job_record> live(stopped_);
+                live.reserve(persisted_);
+                for (const auto& [id, j] : jobs_) {
+                    if (!j.handler.empty()) live.push_back(record(id, j));
+                }
+                store_->compact(live);
+            }
+            maintenance_ = timers_.schedule_after(flush_interval_, [this] { maintain(); });
+        }
+
+        std::unordered_map<job_id, job> jobs_;
+        std::unordered_map<std::string, std::function<void()>> handlers_;
+        mutable std::mutex mutex_;
+        std::shared_ptr<metrics> metrics_ = std::make_shared<metrics>();
+        job_id next_job_ = 1;
+        clock::duration slack_ = clock::duration::zero();
+        thread_pool* executor_ = nullptr;
+        std::unique_ptr<job_store> store_;
+        std::size_t persisted_ = 0;         // records in the log: live persisted jobs plus stopped_
+        std::vector<job_record> stopped_;   // persisted jobs stopAll() took out of this process
+        std::deque<completed_job> completed_;
+        std::chrono::milliseconds flush_interval_{ 1000 };
+        timer_id maintenance_ = 0;
+        std::unique_ptr<thread_pool> workers_; // outlives timers_, whose thread enqueues onto it
+        timer_service timers_;
     };
 
 } // namespace framework
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace framework {
+
+    namespace detail {
+        inline void atomic_max(std::atomic<std::int64_t>& target, std::int64_t v) {
+            std::int64_t cur = target.load(std::memory_order_relaxed);
+            while (v > cur && !target.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+        }
+    }
+
+    // Point-in-time copy of a latency_histogram; plain values, cheap to merge and inspect
+    struct histogram_snapshot {
+        static constexpr std::size_t sub_bits = 3;
+        static constexpr std::size_t sub_count = std::size_t{ 1 } << sub_bits;
+        static constexpr std::size_t bucket_count = (64 - sub_bits + 1) * sub_count;
+
+        std::array<std::uint64_t, bucket_count> buckets{};
+        std::uint64_t count = 0;
+        std::int64_t sum = 0;
+        std::int64_t max = 0;
+
+        // Bucket for a nanosecond value: exact below 8, then 8 linear steps per power of two
+        static std::size_t bucket_of(std::uint64_t v) {
+            if (v < sub_count) return static_cast<std::size_t>(v);
+            unsigned e = static_cast<unsigned>(std::bit_width(v)) - 1;
+            return (e - sub_bits + 1) * sub_count + static_cast<std::size_t>((v >> (e - sub_bits)) & (sub_count - 1));
+        }
+
+        static std::uint64_t lower_bound(std::size_t bucket) {
+            if (bucket < sub_count) return bucket;
+            unsigned e = static_cast<unsigned>(bucket / sub_count) + sub_bits - 1;
+            return (sub_count + bucket % sub_count) << (e - sub_bits);
+        }
+
+        double mean() const { return count ? static_cast<double>(sum) / static_cast<double>(count) : 0.0; }
+
+        // Upper edge of the bucket holding the p-th percentile (p in [0, 100]); relative error < 12.5%
+        std::chrono::nanoseconds percentile(double p) const {
+            if (count == 0) return std::chrono::nanoseconds(0);
+            auto rank = static_cast<std::uint64_t>(std::clamp(p, 0.0, 100.0) / 100.0 * static_cast<double>(count - 1)) + 1;
+            std::uint64_t seen = 0;
+            for (std::size_t b = 0; b < bucket_count; ++b) {
+                seen += buckets[b];
+                if (seen >= rank) {
+                    auto upper = b + 1 < bucket_count ? lower_bound(b + 1) - 1 : lower_bound(b);
+                    return std::chrono::nanoseconds(std::min<std::int64_t>(static_cast<std::int64_t>(upper), max));
+                }
+            }
+            return std::chrono::nanoseconds(max);
+        }
+
+        histogram_snapshot& merge(const histogram_snapshot& other) {
+            for (std::size_t b = 0; b < bucket_count; ++b) buckets[b] += other.buckets[b];
+            count += other.count;
+            sum += other.sum;
+            max = std::max(max, other.max);
+            return *this;
+        }
+    };
+
+    // Lock-free log-linear histogram of nanosecond durations; record() is a few relaxed atomics
+    class latency_histogram {
+    public:
+        void record(std::chrono::nanoseconds d) {
+            std::int64_t v = std::max<std::int64_t>(0, d.count());
+            buckets_[histogram_snapshot::bucket_of(static_cast<std::uint64_t>(v))].fetch_add(1, std::memory_order_relaxed);
+            count_.fetch_add(1, std::memory_order_relaxed);
+            sum_.fetch_add(v, std::memory_order_relaxed);
+            detail::atomic_max(max_, v);
+        }
+
+        histogram_snapshot snapshot() const {
+            histogram_snapshot s;
+            for (std::size_t b = 0; b < histogram_snapshot::bucket_count; ++b)
+                s.buckets[b] = buckets_[b].load(std::memory_order_relaxed);
+            s.count = count_.load(std::memory_order_relaxed);
+            s.sum = sum_.load(std::memory_order_relaxed);
+            s.max = max_.load(std::memory_order_relaxed);
+            return s;
+        }
+
+    private:
+        std::array<std::atomic<std::uint64_t>, histogram_snapshot::bucket_count> buckets_{};
+        std::atomic<std::uint64_t> count_{ 0 };
+        std::atomic<std::int64_t> sum_{ 0 };
+        std::atomic<std::int64_t> max_{ 0 };
+    };
+
+    // Per-job run statistics as reported by Scheduler::snapshot()
+    struct job_stats {
+        std::uint64_t id = 0;
+        std::string handler; // empty for jobs scheduled with a callable
+        std::uint64_t runs = 0;
+        std::uint64_t failures = 0;
+        std::chrono::nanoseconds last_lateness{ 0 };
+        std::chrono::nanoseconds max_lateness{ 0 };
+        std::chrono::nanoseconds total_lateness{ 0 };
+        std::chrono::nanoseconds last_duration{ 0 };
+        std::chrono::nanoseconds max_duration{ 0 };
+        std::chrono::nanoseconds total_duration{ 0 };
+        bool completed = false; // the job finished or was cancelled
+    };
+
+    // Live counters behind job_stats; updated from whichever thread ran the job
+    struct job_counters {
+        std::atomic<std::uint64_t> runs{ 0 };
+        std::atomic<std::uint64_t> failures{ 0 };
+        std::atomic<std::int64_t> last_lateness{ 0 };
+        std::atomic<std::int64_t> max_lateness{ 0 };
+        std::atomic<std::int64_t> total_lateness{ 0 };
+        std::atomic<std::int64_t> last_duration{ 0 };
+        std::atomic<std::int64_t> max_duration{ 0 };
+        std::atomic<std::int64_t> total_duration{ 0 };
+
+        void record(std::chrono::nanoseconds lateness, std::chrono::nanoseconds duration, bool failed) {
+            runs.fetch_add(1, std::memory_order_relaxed);
+            if (failed) failures.fetch_add(1, std::memory_order_relaxed);
+            last_lateness.store(lateness.count(), std::memory_order_relaxed);
+            detail::atomic_max(max_lateness, lateness.count());
+            total_lateness.fetch_add(lateness.count(), std::memory_order_relaxed);
+            last_duration.store(duration.count(), std::memory_order_relaxed);
+            detail::atomic_max(max_duration, duration.count());
+            total_duration.fetch_add(duration.count(), std::memory_order_relaxed);
+        }
+
+        job_stats stats(std::uint64_t id, const std::string& handler) const {
+            using ns = std::chrono::nanoseconds;
+            return job_stats{ id, handler,
+                runs.load(std::memory_order_relaxed), failures.load(std::memory_order_relaxed),
+                ns(last_lateness.load(std::memory_order_relaxed)), ns(max_lateness.load(std::memory_order_relaxed)),
+                ns(total_lateness.load(std::memory_order_relaxed)),
+                ns(last_duration.load(std::memory_order_relaxed)), ns(max_duration.load(std::memory_order_relaxed)),
+                ns(total_duration.load(std::memory_order_relaxed)) };
+        }
+    };
+
+    // Aggregate scheduler metrics. Lateness is measured from the scheduled deadline to the
+    // moment the task starts running, so executor queueing delay is included.
+    struct scheduler_snapshot {
+        histogram_snapshot lateness;
+        histogram_snapshot duration;
+        std::uint64_t runs = 0;
+        std::uint64_t failures = 0;
+        std::size_t active_jobs = 0;
+        std::vector<job_stats> jobs; // active jobs and the most recently completed ones, by id
+    };
+
+} // namespace framework
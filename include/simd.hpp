@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FRAMEWORK_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define FRAMEWORK_TARGET_SSE2
+#define FRAMEWORK_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define FRAMEWORK_TARGET_SSE2 __attribute__((target("sse2")))
+#define FRAMEWORK_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Runtime CPU feature dispatch for the columnar kernels. Every kernel ships a scalar version;
+// x86 builds add SSE2 and AVX2 versions compiled per function, so the binary runs anywhere
+// and picks the widest one the CPU (and OS) supports the first time a kernel is called.
+namespace framework::simd {
+
+    enum class level { scalar, sse2, avx2 };
+
+    inline level detect() {
+#ifdef FRAMEWORK_SIMD_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+        int regs[4];
+        __cpuid(regs, 0);
+        const int max_leaf = regs[0];
+        __cpuid(regs, 1);
+        const bool sse2 = (regs[3] >> 26) & 1;
+        const bool osxsave = (regs[2] >> 27) & 1;
+        const bool avx = (regs[2] >> 28) & 1;
+        bool avx2 = false;
+        if (max_leaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) {
+            __cpuidex(regs, 7, 0);
+            avx2 = (regs[1] >> 5) & 1;
+        }
+#else
+        __builtin_cpu_init();
+        const bool sse2 = __builtin_cpu_supports("sse2");
+        const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+        if (avx2) return level::avx2;
+        if (sse2) return level::sse2;
+#endif
+        return level::scalar;
+    }
+
+    namespace detail {
+        inline std::atomic<level>& setting() {
+            static std::atomic<level> current{ detect() };
+            return current;
+        }
+    }
+
+    inline level active() { return detail::setting().load(std::memory_order_relaxed); }
+
+    // Cap dispatch at `max` (e.g. to compare against scalar); cannot raise it above detect()
+    inline void limit(level max) {
+        level hw = detect();
+        detail::setting().store(max < hw ? max : hw, std::memory_order_relaxed);
+    }
+
+    // Widest available implementation; null entries fall through to the next narrower one
+    template<typename Fn>
+    Fn select(std::type_identity_t<Fn> avx2, std::type_identity_t<Fn> sse2, Fn scalar) {
+        switch (active()) {
+        case level::avx2:
+            if (avx2) return avx2;
+            [[fallthrough]];
+        case level::sse2:
+            if (sse2) return sse2;
+            [[fallthrough]];
+        default:
+            return scalar;
+        }
+    }
+
+} // namespace framework::simd
+
+// Expands to the avx2/sse2/scalar variants of detail::name for simd::select
+#ifdef FRAMEWORK_SIMD_X86
+#define FRAMEWORK_SIMD_VARIANTS(name) detail::name##_avx2, detail::name##_sse2, detail::name##_scalar
+#else
+#define FRAMEWORK_SIMD_VARIANTS(name) nullptr, nullptr, detail::name##_scalar
+#endif
@@ -0,0 +1,584 @@
+#pragma once
+
+#include "data_frame.hpp"
+#include "key_columns.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace framework {
+
+    // Approximate aggregates in bounded memory and one pass: hyperloglog (distinct count),
+    // tdigest (quantiles), count_min and heavy_hitters (frequencies). Sketches built over
+    // different threads or partitions merge into the sketch of all their values, and
+    // serialize() / deserialize() round-trip them as little-endian bytes. grouped_frame::agg()
+    // runs them per group through approx_count_distinct() and approx_quantile().
+    namespace detail {
+        // Hash of a sketched value. Strings use FNV-1a rather than std::hash so serialized
+        // sketches merge across builds and platforms.
+        template<typename T>
+        std::uint64_t sketch_hash(const T& v) {
+            if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+                std::uint64_t h = 0xcbf29ce484222325ULL;
+                for (unsigned char c : std::string_view(v)) h = (h ^ c) * 0x100000001b3ULL;
+                return mix64(h);
+            }
+            else if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>) {
+                return mix64(static_cast<std::uint64_t>(static_cast<std::int64_t>(v)));
+            }
+            else {
+                return mix64(key_hash(v));
+            }
+        }
+
+        class sketch_writer {
+            std::string out_;
+        public:
+            explicit sketch_writer(const char (&magic)[5]) : out_(magic, 4) {}
+
+            template<typename T>
+            void put(const T& v) {
+                static_assert(std::is_trivially_copyable_v<T>);
+                out_.append(reinterpret_cast<const char*>(&v), sizeof(T));
+            }
+            void put_bytes(const void* data, size_t n) { out_.append(static_cast<const char*>(data), n); }
+
+            std::string take() { return std::move(out_); }
+        };
+
+        class sketch_reader {
+            std::string_view in_;
+        public:
+            sketch_reader(std::string_view in, const char (&magic)[5]) : in_(in) {
+                if (in_.substr(0, 4) != std::string_view(magic, 4)) throw std::runtime_error("Not a " + std::string(magic, 4) + " sketch");
+                in_.remove_prefix(4);
+            }
+
+            template<typename T>
+            T get() {
+                T v;
+                get_bytes(&v, sizeof(T));
+                return v;
+            }
+            void get_bytes(void* data, size_t n) {
+                if (in_.size() < n) throw std::runtime_error("Corrupt sketch");
+                std::memcpy(data, in_.data(), n);
+                in_.remove_prefix(n);
+            }
+            std::string_view get_view(size_t n) {
+                if (in_.size() < n) throw std::runtime_error("Corrupt sketch");
+                auto v = in_.substr(0, n);
+                in_.remove_prefix(n);
+                return v;
+            }
+
+            // Everything not read yet
+            std::string_view rest() {
+                auto v = in_;
+                in_ = {};
+                return v;
+            }
+
+            void finish() const {
+                if (!in_.empty()) throw std::runtime_error("Corrupt sketch");
+            }
+        };
+    }
+
+    // HyperLogLog over 2^precision registers, standard error about 1.04 / sqrt(2^precision)
+    // (1.6% at the default 12). Small sketches keep (register, rank) pairs sorted in a
+    // sparse list and switch to the dense registers once that would no longer be smaller,
+    // so a group with few values costs a few bytes. The estimate is Ertl's improved
+    // estimator, unbiased from zero up without linear-counting switchovers.
+    class hyperloglog {
+        std::uint8_t p_;
+        std::vector<std::uint32_t> sparse_; // register << 8 | rank, by register
+        std::vector<std::uint8_t> dense_;   // empty while sparse
+
+        size_t registers() const { return size_t{ 1 } << p_; }
+
+        void set(std::uint32_t reg, std::uint8_t rank) {
+            if (!dense_.empty()) {
+                dense_[reg] = std::max(dense_[reg], rank);
+                return;
+            }
+            auto it = std::lower_bound(sparse_.begin(), sparse_.end(), reg << 8);
+            if (it != sparse_.end() && (*it >> 8) == reg) {
+                if ((*it & 255) < rank) *it = reg << 8 | rank;
+                return;
+            }
+            sparse_.insert(it, reg << 8 | rank);
+            if (sparse_.size() * sizeof(std::uint32_t) > registers()) {
+                dense_.assign(registers(), 0);
+                for (auto e : sparse_) dense_[e >> 8] = static_cast<std::uint8_t>(e & 255);
+                sparse_ = {};
+            }
+        }
+
+        static double sigma(double x) {
+            if (x == 1) return std::numeric_limits<double>::infinity();
+            double y = 1, z = x, previous;
+            do {
+                x *= x;
+                previous = z;
+                z += x * y;
+                y += y;
+            } while (z != previous);
+            return z;
+        }
+
+        static double tau(double x) {
+            if (x == 0 || x == 1) return 0;
+            double y = 1, z = 1 - x, previous;
+            do {
+                x = std::sqrt(x);
+                previous = z;
+                y *= 0.5;
+                z -= (1 - x) * (1 - x) * y;
+            } while (z != previous);
+            return z / 3;
+        }
+
+    public:
+        explicit hyperloglog(unsigned precision = 12) : p_(static_cast<std::uint8_t>(precision)) {
+            if (precision < 4 || precision > 18) throw std::runtime_error("HyperLogLog precision must be 4..18");
+        }
+
+        unsigned precision() const { return p_; }
+
+        void add_hash(std::uint64_t hash) {
+            const unsigned q = 64 - p_;
+            std::uint64_t rest = hash << p_;
+            unsigned rank = rest ? std::countl_zero(rest) + 1 : q + 1;
+            set(static_cast<std::uint32_t>(hash >> q), static_cast<std::uint8_t>(std::min(rank, q + 1)));
+        }
+
+        template<typename T>
+        void add(const T& v) { add_hash(detail::sketch_hash(v)); }
+
+        void merge(const hyperloglog& other) {
+            if (other.p_ != p_) throw std::runtime_error("Cannot merge HyperLogLogs of different precision");
+            if (!other.dense_.empty()) {
+                if (dense_.empty()) {
+                    auto sparse = std::move(sparse_);
+                    sparse_ = {};
+                    dense_ = other.dense_;
+                    for (auto e : sparse) set(e >> 8, static_cast<std::uint8_t>(e & 255));
+                }
+                else {
+                    for (size_t r = 0; r < dense_.size(); ++r) dense_[r] = std::max(dense_[r], other.dense_[r]);
+                }
+                return;
+            }
+            for (auto e : other.sparse_) set(e >> 8, static_cast<std::uint8_t>(e & 255));
+        }
+
+        double estimate() const {
+            const unsigned q = 64 - p_;
+            const double m = static_cast<double>(registers());
+            std::vector<double> counts(q + 2, 0);
+            if (dense_.empty()) {
+                counts[0] = m - static_cast<double>(sparse_.size());
+                for (auto e : sparse_) ++counts[e & 255];
+            }
+            else {
+                for (auto r : dense_) ++counts[r];
+            }
+            if (counts[0] == m) return 0;
+            double z = m * tau(1 - counts[q + 1] / m);
+            for (unsigned k = q; k >= 1; --k) z = 0.5 * (z + counts[k]);
+            z += m * sigma(counts[0] / m);
+            return m * m / (2 * std::numbers::ln2 * z);
+        }
+
+        std::uint64_t count() const { return static_cast<std::uint64_t>(std::llround(estimate())); }
+
+        // "HLL1", precision, then the sparse entries or the dense registers
+        std::string serialize() const {
+            detail::sketch_writer out("HLL1");
+            out.put(p_);
+            out.put(static_cast<std::uint8_t>(dense_.empty() ? 0 : 1));
+            if (dense_.empty()) {
+                out.put(static_cast<std::uint32_t>(sparse_.size()));
+                out.put_bytes(sparse_.data(), sparse_.size() * sizeof(std::uint32_t));
+            }
+            else {
+                out.put_bytes(dense_.data(), dense_.size());
+            }
+            return out.take();
+        }
+
+        static hyperloglog deserialize(std::string_view bytes) {
+            detail::sketch_reader in(bytes, "HLL1");
+            auto p = in.get<std::uint8_t>();
+            if (p < 4 || p > 18) throw std::runtime_error("Corrupt sketch");
+            hyperloglog h(p);
+            if (in.get<std::uint8_t>()) {
+                h.dense_.resize(h.registers());
+                in.get_bytes(h.dense_.data(), h.dense_.size());
+                for (auto r : h.dense_)
+                    if (r > 64 - p + 1) throw std::runtime_error("Corrupt sketch");
+            }
+            else {
+                h.sparse_.resize(in.get<std::uint32_t>());
+                if (h.sparse_.size() * sizeof(std::uint32_t) > h.registers()) throw std::runtime_error("Corrupt sketch");
+                in.get_bytes(h.sparse_.data(), h.sparse_.size() * sizeof(std::uint32_t));
+                for (size_t i = 0; i < h.sparse_.size(); ++i) {
+                    auto e = h.sparse_[i];
+                    if ((e >> 8) >= h.registers() || (e & 255) == 0 || (e & 255) > 64u - p + 1 || (i && e >> 8 <= h.sparse_[i - 1] >> 8))
+                        throw std::runtime_error("Corrupt sketch");
+                }
+            }
+            in.finish();
+            return h;
+        }
+    };
+
+    // Merging t-digest (Dunning): values are buffered, then sorted and merged into centroids
+    // whose size is bounded by the arcsine scale function, so the tails stay nearly exact
+    // while the middle is summarized. At most about compression centroids are kept; quantile
+    // error is typically well under 1% of rank, far less near 0 and 1. NaN is ignored.
+    class tdigest {
+    public:
+        struct centroid {
+            double mean;
+            double weight;
+        };
+
+        explicit tdigest(double compression = 100) : compression_(compression) {
+            if (!(compression >= 10 && compression <= 10000)) throw std::runtime_error("t-digest compression must be 10..10000");
+        }
+
+        double compression() const { return compression_; }
+        double count() const { return total_; }
+        double min() const { return total_ ? min_ : std::numeric_limits<double>::quiet_NaN(); }
+        double max() const { return total_ ? max_ : std::numeric_limits<double>::quiet_NaN(); }
+
+        void add(double x, double weight = 1) {
+            if (std::isnan(x) || !(weight > 0)) return;
+            min_ = total_ ? std::min(min_, x) : x;
+            max_ = total_ ? std::max(max_, x) : x;
+            total_ += weight;
+            buffer_.push_back(centroid{ x, weight });
+            if (buffer_.size() >= buffer_limit()) compress();
+        }
+
+        void merge(const tdigest& other) {
+            if (!other.total_) return;
+            min_ = total_ ? std::min(min_, other.min_) : other.min_;
+            max_ = total_ ? std::max(max_, other.max_) : other.max_;
+            total_ += other.total_;
+            buffer_.insert(buffer_.end(), other.centroids_.begin(), other.centroids_.end());
+            buffer_.insert(buffer_.end(), other.buffer_.begin(), other.buffer_.end());
+            if (buffer_.size() >= buffer_limit()) compress();
+        }
+
+        // Folds the buffered values into the centroids
+        void compress() {
+            if (buffer_.empty()) return;
+            centroids_ = merged();
+            buffer_.clear();
+        }
+
+        // Value at rank q * count(), interpolated between centroid midpoints; NaN when empty
+        double quantile(double q) const {
+            if (!total_) return std::numeric_limits<double>::quiet_NaN();
+            q = std::clamp(q, 0.0, 1.0);
+            std::vector<centroid> pending;
+            if (!buffer_.empty()) pending = merged();
+            const auto& cs = buffer_.empty() ? centroids_ : pending;
+            const double target = q * total_;
+            if (target <= 0) return min_;
+            if (target >= total_) return max_;
+
+            // Below the first centroid's midpoint: from min, a singleton being exactly min
+            const auto& first = cs.front();
+            if (target < first.weight / 2) {
+                if (first.weight == 1) return min_;
+                return min_ + (first.mean - min_) * target / (first.weight / 2);
+            }
+            double cumulative = 0;
+            for (size_t i = 0; i + 1 < cs.size(); ++i) {
+                double left = cumulative + cs[i].weight / 2;
+                double right = cumulative + cs[i].weight + cs[i + 1].weight / 2;
+                if (target <= right) {
+                    // Singletons hold their value exactly rather than spreading over the gap
+                    if (cs[i].weight == 1 && target - left < 0.5) return cs[i].mean;
+                    if (cs[i + 1].weight == 1 && right - target <= 0.5) return cs[i + 1].mean;
+                    return cs[i].mean + (cs[i + 1].mean - cs[i].mean) * (target - left) / (right - left);
+                }
+                cumulative += cs[i].weight;
+            }
+            const auto& last = cs.back();
+            if (last.weight == 1) return max_;
+            double left = total_ - last.weight / 2;
+            return last.mean + (max_ - last.mean) * (target - left) / (last.weight / 2);
+        }
+
+        // "TDG1", compression, count, min, max, then the centroids
+        std::string serialize() const {
+            std::vector<centroid> pending;
+            if (!buffer_.empty()) pending = merged();
+            const auto& cs = buffer_.empty() ? centroids_ : pending;
+            detail::sketch_writer out("TDG1");
+            out.put(compression_);
+            out.put(total_);
+            out.put(min_);
+            out.put(max_);
+            out.put(static_cast<std::uint32_t>(cs.size()));
+            out.put_bytes(cs.data(), cs.size() * sizeof(centroid));
+            return out.take();
+        }
+
+        static tdigest deserialize(std::string_view bytes) {
+            detail::sketch_reader in(bytes, "TDG1");
+            tdigest t(in.get<double>());
+            t.total_ = in.get<double>();
+            t.min_ = in.get<double>();
+            t.max_ = in.get<double>();
+            auto n = in.get<std::uint32_t>();
+            if (n > bytes.size() / sizeof(centroid)) throw std::runtime_error("Corrupt sketch");
+            t.centroids_.resize(n);
+            in.get_bytes(t.centroids_.data(), t.centroids_.size() * sizeof(centroid));
+            in.finish();
+            double weight = 0;
+            for (const auto& c : t.centroids_) {
+                if (!(c.weight > 0) || std::isnan(c.mean)) throw std::runtime_error("Corrupt sketch");
+                weight += c.weight;
+            }
+            if (!(std::abs(weight - t.total_) <= 1e-9 * std::max(1.0, t.total_))) throw std::runtime_error("Corrupt sketch");
+            return t;
+        }
+
+    private:
+        double compression_;
+        double total_ = 0, min_ = 0, max_ = 0;
+        std::vector<centroid> centroids_, buffer_;
+
+        size_t buffer_limit() const { return static_cast<size_t>(5 * compression_); }
+
+        // k1 scale: k(q) = compression / 2pi * asin(2q - 1); a centroid spans at most one unit of k
+        double k_of(double q) const { return compression_ / (2 * std::numbers::pi) * std::asin(2 * q - 1); }
+        double q_of(double k) const { return (std::sin(k * 2 * std::numbers::pi / compression_) + 1) / 2; }
+
+        std::vector<centroid> merged() const {
+            std::vector<centroid> all;
+            all.reserve(centroids_.size() + buffer_.size());
+            all.insert(all.end(), centroids_.begin(), centroids_.end());
+            all.insert(all.end(), buffer_.begin(), buffer_.end());
+            std::sort(all.begin(), all.end(), [](const centroid& a, const centroid& b) { return a.mean < b.mean; });
+
+            std::vector<centroid> out;
+            if (all.empty()) return out;
+            out.push_back(all[0]);
+            double before = 0; // weight ahead of the centroid being built
+            double limit = q_of(k_of(0) + 1) * total_;
+            for (size_t i = 1; i < all.size(); ++i) {
+                auto& current = out.back();
+                if (before + current.weight + all[i].weight <= limit) {
+                    current.weight += all[i].weight;
+                    current.mean += (all[i].mean - current.mean) * all[i].weight / current.weight;
+                    continue;
+                }
+                before += current.weight;
+                limit = q_of(std::min(k_of(before / total_) + 1, compression_ / 4)) * total_;
+                out.push_back(all[i]);
+            }
+            return out;
+        }
+    };
+
+    // Count-min sketch: depth rows of width counters, each value counted in one counter per
+    // row. estimate() is never below the true count and, with probability 1 - delta, at most
+    // epsilon * total() above it for a sketch made by with_error(epsilon, delta).
+    class count_min {
+        size_t width_, depth_;
+        std::uint64_t total_ = 0;
+        std::vector<std::uint64_t> counts_; // row-major, depth x width
+
+        // Counter of row i, from a rehash per row: double hashing modulo the width would let
+        // two values that share both residues collide in every row
+        size_t column(std::uint64_t hash, size_t i) const {
+            return static_cast<size_t>(detail::mix64(hash + (i + 1) * 0x9e3779b97f4a7c15ULL) % width_);
+        }
+
+    public:
+        count_min(size_t width = 2048, size_t depth = 5) : width_(width), depth_(depth), counts_(width * depth) {
+            if (width == 0 || depth == 0 || depth > 64) throw std::runtime_error("count-min needs width >= 1 and depth 1..64");
+        }
+
+        // Width e / epsilon and depth ln(1 / delta)
+        static count_min with_error(double epsilon, double delta) {
+            if (!(epsilon > 0 && epsilon < 1) || !(delta > 0 && delta < 1)) throw std::runtime_error("count-min error bounds must be in (0, 1)");
+            return count_min(static_cast<size_t>(std::ceil(std::numbers::e / epsilon)), static_cast<size_t>(std::ceil(std::log(1 / delta))));
+        }
+
+        size_t width() const { return width_; }
+        size_t depth() const { return depth_; }
+        std::uint64_t total() const { return total_; }
+
+        void add_hash(std::uint64_t hash, std::uint64_t count = 1) {
+            for (size_t i = 0; i < depth_; ++i) counts_[i * width_ + column(hash, i)] += count;
+            total_ += count;
+        }
+
+        std::uint64_t estimate_hash(std::uint64_t hash) const {
+            std::uint64_t best = std::numeric_limits<std::uint64_t>::max();
+            for (size_t i = 0; i < depth_; ++i) best = std::min(best, counts_[i * width_ + column(hash, i)]);
+            return best;
+        }
+
+        template<typename T>
+        void add(const T& v, std::uint64_t count = 1) { add_hash(detail::sketch_hash(v), count); }
+
+        template<typename T>
+        std::uint64_t estimate(const T& v) const { return estimate_hash(detail::sketch_hash(v)); }
+
+        void merge(const count_min& other) {
+            if (other.width_ != width_ || other.depth_ != depth_) throw std::runtime_error("Cannot merge count-min sketches of different shape");
+            for (size_t i = 0; i < counts_.size(); ++i) counts_[i] += other.counts_[i];
+            total_ += other.total_;
+        }
+
+        // "CMS1", width, depth, total, then the counters
+        std::string serialize() const {
+            detail::sketch_writer out("CMS1");
+            out.put(static_cast<std::uint64_t>(width_));
+            out.put(static_cast<std::uint64_t>(depth_));
+            out.put(total_);
+            out.put_bytes(counts_.data(), counts_.size() * sizeof(std::uint64_t));
+            return out.take();
+        }
+
+        static count_min deserialize(std::string_view bytes) {
+            detail::sketch_reader in(bytes, "CMS1");
+            auto width = in.get<std::uint64_t>(), depth = in.get<std::uint64_t>();
+            if (width == 0 || depth == 0 || depth > 64 || width > (bytes.size() / 8) / depth) throw std::runtime_error("Corrupt sketch");
+            count_min c(static_cast<size_t>(width), static_cast<size_t>(depth));
+            c.total_ = in.get<std::uint64_t>();
+            in.get_bytes(c.counts_.data(), c.counts_.size() * sizeof(std::uint64_t));
+            in.finish();
+            return c;
+        }
+    };
+
+    // The k most frequent values: a count-min sketch of every value plus the k candidates
+    // with the highest estimates so far. Values of type int, int64, double, timestamp or
+    // string.
+    template<typename T>
+    class heavy_hitters {
+        struct hasher {
+            size_t operator()(const T& v) const { return static_cast<size_t>(detail::sketch_hash(v)); }
+        };
+
+        size_t k_;
+        count_min counts_;
+        std::unordered_map<T, std::uint64_t, hasher> candidates_;
+        // A lower bound on the smallest candidate estimate once there are k: estimates only
+        // grow, so values at or below it are skipped without scanning the candidates
+        std::uint64_t floor_ = 0;
+
+        void offer(const T& v, std::uint64_t estimate) {
+            if (auto it = candidates_.find(v); it != candidates_.end()) {
+                it->second = estimate;
+                return;
+            }
+            if (candidates_.size() < k_) {
+                candidates_.emplace(v, estimate);
+                if (candidates_.size() == k_) refresh_floor();
+                return;
+            }
+            if (estimate <= floor_) return;
+            auto smallest = std::min_element(candidates_.begin(), candidates_.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+            if (estimate <= smallest->second) {
+                floor_ = smallest->second;
+                return;
+            }
+            candidates_.erase(smallest);
+            candidates_.emplace(v, estimate);
+            refresh_floor();
+        }
+
+        void refresh_floor() {
+            floor_ = std::numeric_limits<std::uint64_t>::max();
+            for (const auto& [v, n] : candidates_) floor_ = std::min(floor_, n);
+        }
+
+    public:
+        explicit heavy_hitters(size_t k, count_min counts = count_min()) : k_(k), counts_(std::move(counts)) {
+            if (k == 0) throw std::runtime_error("heavy_hitters needs k >= 1");
+        }
+
+        size_t k() const { return k_; }
+        const count_min& counts() const { return counts_; }
+
+        void add(const T& v, std::uint64_t count = 1) {
+            std::uint64_t hash = detail::sketch_hash(v);
+            counts_.add_hash(hash, count);
+            offer(v, counts_.estimate_hash(hash));
+        }
+
+        // Candidates are re-estimated against the merged counts and the top k kept
+        void merge(const heavy_hitters& other) {
+            counts_.merge(other.counts_);
+            std::vector<T> values;
+            for (const auto& [v, n] : candidates_) values.push_back(v);
+            for (const auto& [v, n] : other.candidates_)
+                if (!candidates_.contains(v)) values.push_back(v);
+            candidates_.clear();
+            for (const auto& v : values) offer(v, counts_.estimate(v));
+        }
+
+        // (value, estimated count), most frequent first, ties by value
+        std::vector<std::pair<T, std::uint64_t>> top() const {
+            std::vector<std::pair<T, std::uint64_t>> out(candidates_.begin(), candidates_.end());
+            std::sort(out.begin(), out.end(), [](const auto& a, const auto& b) { return a.second > b.second || (a.second == b.second && a.first < b.first); });
+            return out;
+        }
+
+        // "HHT1", k, the candidate values, then the count-min sketch
+        std::string serialize() const {
+            detail::sketch_writer out("HHT1");
+            out.put(static_cast<std::uint64_t>(k_));
+            out.put(static_cast<std::uint64_t>(candidates_.size()));
+            for (const auto& [v, n] : candidates_) {
+                if constexpr (std::is_same_v<T, std::string>) {
+                    out.put(static_cast<std::uint64_t>(v.size()));
+                    out.put_bytes(v.data(), v.size());
+                }
+                else {
+                    out.put(v);
+                }
+            }
+            auto counts = counts_.serialize();
+            out.put_bytes(counts.data(), counts.size());
+            return out.take();
+        }
+
+        static heavy_hitters deserialize(std::string_view bytes) {
+            detail::sketch_reader in(bytes, "HHT1");
+            auto k = in.get<std::uint64_t>(), n = in.get<std::uint64_t>();
+            if (k == 0 || n > k || n > bytes.size()) throw std::runtime_error("Corrupt sketch");
+            std::vector<T> values;
+            for (std::uint64_t i = 0; i < n; ++i) {
+                if constexpr (std::is_same_v<T, std::string>) values.emplace_back(in.get_view(in.get<std::uint64_t>()));
+                else values.push_back(in.get<T>());
+            }
+            heavy_hitters h(static_cast<size_t>(k), count_min::deserialize(in.rest()));
+            for (const auto& v : values) h.offer(v, h.counts_.estimate(v));
+            return h;
+        }
+    };
+
+} // namespace framework
@@ -0,0 +1,264 @@
+#pragma once
+
+#include "data_frame.hpp"
+#include "morsel.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <vector>
+
+namespace framework {
+
+    namespace detail {
+        // Unsigned words that order like the values: ints with the sign bit flipped, doubles
+        // by their IEEE bits (negatives inverted, -0 == 0, NaN after +inf)
+        inline std::uint64_t order_bits(int v) { return static_cast<std::uint32_t>(v) ^ 0x80000000u; }
+        inline std::uint64_t order_bits(std::int64_t v) { return static_cast<std::uint64_t>(v) ^ (std::uint64_t{ 1 } << 63); }
+        inline std::uint64_t order_bits(timestamp v) { return order_bits(std::int64_t{ v.time_since_epoch().count() }); }
+
+        inline std::uint64_t order_bits(double v) {
+            if (v == 0) v = 0;
+            if (std::isnan(v)) v = std::numeric_limits<double>::quiet_NaN();
+            auto b = std::bit_cast<std::uint64_t>(v);
+            return (b >> 63) ? ~b : b | (std::uint64_t{ 1 } << 63);
+        }
+
+        // One sort key flattened so rows compare without data_value. Numeric, bool and
+        // dictionary keys become order words in bits (inverted when descending; dictionary
+        // codes go through the rank of their string), plain strings compare in place.
+        struct sort_column {
+            std::vector<std::uint64_t> bits;
+            std::span<const std::string> strings;
+            const std::uint64_t* validity = nullptr;
+            bool radix = true;
+            bool descending = false;
+
+            bool valid(size_t row) const { return !validity || ((validity[row / 64] >> (row % 64)) & 1); }
+
+            // <0, 0, >0 like string::compare; nulls after every value in either order
+            int compare(size_t a, size_t b) const {
+                if (validity) {
+                    bool va = valid(a), vb = valid(b);
+                    if (va != vb) return va ? -1 : 1;
+                    if (!va) return 0;
+                }
+                if (radix) return bits[a] < bits[b] ? -1 : bits[a] > bits[b];
+                int c = strings[a].compare(strings[b]);
+                return descending ? -c : c;
+            }
+        };
+
+        inline sort_column make_sort_column(const data_frame& df, const sort_key& key) {
+            const IColumn& col = df.column_at(df.column_position(key.column));
+            const size_t rows = col.size();
+            sort_column s;
+            s.validity = col.validity();
+            s.descending = key.order == desc;
+
+            if (auto* d = dynamic_cast<const dictionary_column*>(&col)) {
+                const auto& dict = d->dictionary();
+                std::vector<int> order(dict.size());
+                std::iota(order.begin(), order.end(), 0);
+                std::sort(order.begin(), order.end(), [&](int a, int b) { return dict[a] < dict[b]; });
+                std::vector<std::uint64_t> rank(dict.size());
+                for (size_t i = 0; i < order.size(); ++i) rank[order[i]] = i;
+                s.bits.reserve(rows);
+                for (int code : d->codes()) s.bits.push_back(rank[code]);
+            }
+            else {
+                switch (col.type()) {
+                case data_type::int32:
+                    for (int v : df.column<int>(key.column)) s.bits.push_back(order_bits(v));
+                    break;
+                case data_type::float64:
+                    for (double v : df.column<double>(key.column)) s.bits.push_back(order_bits(v));
+                    break;
+                case data_type::int64:
+                    for (std::int64_t v : df.column<std::int64_t>(key.column)) s.bits.push_back(order_bits(v));
+                    break;
+                case data_type::timestamp:
+                    for (timestamp v : df.column<timestamp>(key.column)) s.bits.push_back(order_bits(v));
+                    break;
+                case data_type::boolean:
+                    for (size_t r = 0; r < rows; ++r) s.bits.push_back(std::get<bool>(col.get(r)));
+                    break;
+                case data_type::string:
+                    s.strings = df.column<std::string>(key.column);
+                    s.radix = false;
+                    return s;
+                }
+            }
+            for (size_t r = 0; r < rows; ++r) {
+                if (!s.valid(r)) s.bits[r] = 0; // nulls tie, keeping their order across radix passes
+                else if (s.descending) s.bits[r] = ~s.bits[r];
+            }
+            return s;
+        }
+
+        struct sort_plan {
+            std::vector<sort_column> keys;
+            bool radix = true;
+
+            sort_plan(const data_frame& df, const std::vector<sort_key>& sort_keys) {
+                for (const auto& k : sort_keys) {
+                    keys.push_back(make_sort_column(df, k));
+                    radix = radix && keys.back().radix;
+                }
+            }
+
+            int compare(size_t a, size_t b) const {
+                for (const auto& k : keys)
+                    if (int c = k.compare(a, b)) return c;
+                return 0;
+            }
+            bool less(size_t a, size_t b) const { return compare(a, b) < 0; }
+        };
+
+        inline constexpr size_t sort_min_rows_per_task = 1 << 16;
+
+        // Stable LSD radix sort of rows by one key, 8 bits per pass. One read histograms all
+        // eight digits, so passes where every row has the same digit are skipped. With more
+        // than one task each pass counts its slices again (the previous pass moved rows
+        // between them) and every slice scatters behind the ones before it in each bucket.
+        inline void radix_sort_rows(std::span<size_t> rows, const sort_column& key, thread_pool* pool, size_t tasks) {
+            using histogram = std::array<size_t, 256>;
+            const size_t n = rows.size();
+            std::vector<std::uint64_t> k(n), k_out(n);
+            std::vector<size_t> r(n), r_out(n);
+            std::vector<std::array<histogram, 8>> digits(tasks);
+            std::vector<histogram> counts(tasks);
+            auto slice = [&](size_t t) { return std::pair{ n * t / tasks, n * (t + 1) / tasks }; };
+
+            run_tasks(pool, tasks, [&](size_t t) {
+                auto [begin, end] = slice(t);
+                auto& h = digits[t];
+                for (size_t i = begin; i < end; ++i) {
+                    r[i] = rows[i];
+                    k[i] = key.bits[rows[i]];
+                    for (int d = 0; d < 8; ++d) ++h[d][(k[i] >> (8 * d)) & 255];
+                }
+            });
+            for (size_t t = 1; t < tasks; ++t)
+                for (int d = 0; d < 8; ++d)
+                    for (size_t b = 0; b < 256; ++b) digits[0][d][b] += digits[t][d][b];
+
+            for (int d = 0; d < 8 && n; ++d) {
+                if (digits[0][d][(k[0] >> (8 * d)) & 255] == n) continue;
+                if (tasks < 2) counts[0] = digits[0][d];
+                else run_tasks(pool, tasks, [&](size_t t) {
+                    auto [begin, end] = slice(t);
+                    counts[t].fill(0);
+                    for (size_t i = begin; i < end; ++i) ++counts[t][(k[i] >> (8 * d)) & 255];
+                });
+
+                size_t offset = 0;
+                for (size_t b = 0; b < 256; ++b)
+                    for (auto& c : counts) {
+                        size_t count = c[b];
+                        c[b] = offset;
+                        offset += count;
+                    }
+                run_tasks(pool, tasks, [&](size_t t) {
+                    auto [begin, end] = slice(t);
+                    auto& c = counts[t];
+                    for (size_t i = begin; i < end; ++i) {
+                        size_t at = c[(k[i] >> (8 * d)) & 255]++;
+                        k_out[at] = k[i];
+                        r_out[at] = r[i];
+                    }
+                });
+                k.swap(k_out);
+                r.swap(r_out);
+            }
+            if (key.validity) std::stable_partition(r.begin(), r.end(), [&](size_t row) { return key.valid(row); });
+            std::copy(r.begin(), r.end(), rows.begin());
+        }
+
+        // Comparison sort of each slice, then rounds of pairwise merges, each round's merges
+        // in parallel
+        inline void merge_sort_rows(std::vector<size_t>& rows, const sort_plan& plan, thread_pool* pool, size_t tasks) {
+            auto less = [&plan](size_t a, size_t b) { return plan.less(a, b); };
+            std::vector<size_t> bounds;
+            for (size_t t = 0; t <= tasks; ++t) bounds.push_back(rows.size() * t / tasks);
+            run_tasks(pool, tasks, [&](size_t t) {
+                std::stable_sort(rows.begin() + bounds[t], rows.begin() + bounds[t + 1], less);
+            });
+
+            std::vector<size_t> merged(rows.size());
+            while (bounds.size() > 2) {
+                std::vector<size_t> next{ 0 };
+                for (size_t i = 2; i < bounds.size(); i += 2) next.push_back(bounds[i]);
+                if (next.back() != bounds.back()) next.push_back(bounds.back());
+                run_tasks(pool, next.size() - 1, [&](size_t t) {
+                    size_t begin = bounds[2 * t], mid = bounds[2 * t + 1], end = next[t + 1];
+                    std::merge(rows.begin() + begin, rows.begin() + mid, rows.begin() + mid, rows.begin() + end,
+                        merged.begin() + begin, less);
+                });
+                rows.swap(merged);
+                bounds = std::move(next);
+            }
+        }
+    }
+
+    // Numeric, bool and dictionary keys are radix sorted, one stable pass per key from the
+    // last; any plain string key switches to a merge sort. With a pool both run across its
+    // workers. Must not be called from one of the pool's own workers.
+    inline std::vector<size_t> data_frame::sort_indices(const std::vector<sort_key>& keys, thread_pool* pool) const {
+        detail::sort_plan plan(*this, keys);
+        const size_t rows = rowCount();
+        std::vector<size_t> perm(rows);
+        std::iota(perm.begin(), perm.end(), size_t{ 0 });
+
+        size_t tasks = pool ? std::clamp<size_t>(rows / detail::sort_min_rows_per_task, 1, pool->size()) : 1;
+        if (plan.radix) {
+            for (size_t k = plan.keys.size(); k-- > 0;) detail::radix_sort_rows(perm, plan.keys[k], pool, tasks);
+        }
+        else {
+            detail::merge_sort_rows(perm, plan, pool, tasks);
+        }
+        return perm;
+    }
+
+    inline data_frame data_frame::sort_by(const std::vector<sort_key>& keys, thread_pool* pool) const {
+        auto rows = sort_indices(keys, pool);
+        std::vector<std::shared_ptr<IColumn>> gathered(columns_.size());
+        auto gather = [&](size_t c) { gathered[c] = columns_[c]->gather(rows); };
+        if (pool && rows.size() >= detail::sort_min_rows_per_task) detail::run_tasks(pool, columns_.size(), gather);
+        else for (size_t c = 0; c < columns_.size(); ++c) gather(c);
+
+        data_frame out;
+        auto names = column_names();
+        for (size_t c = 0; c < columns_.size(); ++c) out.add_column(names[c], std::move(gathered[c]));
+        return out;
+    }
+
+    // nth_element partitions off the first k rows in O(n), then only those k are sorted.
+    // Ties break by row number, so the result matches the head of sort_by().
+    inline data_frame data_frame::top_k(const std::vector<sort_key>& keys, size_t k) const {
+        detail::sort_plan plan(*this, keys);
+        std::vector<size_t> rows(rowCount());
+        std::iota(rows.begin(), rows.end(), size_t{ 0 });
+        k = std::min(k, rows.size());
+
+        auto less = [&plan](size_t a, size_t b) {
+            int c = plan.compare(a, b);
+            return c ? c < 0 : a < b;
+        };
+        if (k < rows.size()) std::nth_element(rows.begin(), rows.begin() + static_cast<std::ptrdiff_t>(k), rows.end(), less);
+        rows.resize(k);
+        std::sort(rows.begin(), rows.end(), less);
+
+        data_frame out;
+        auto names = column_names();
+        for (size_t c = 0; c < columns_.size(); ++c) out.add_column(names[c], columns_[c]->gather(rows));
+        return out;
+    }
+
+} // namespace framework
@@ -61,6 +61,8 @@ namespace framework {
             start(new_size);
         }
 
+        size_t size() const { return threads_.size(); }
+
     private:
         void start(size_t thread_count) {
             stop_requested_.store(false, std::memory_order_release);
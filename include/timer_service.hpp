@@ -0,0 +1,291 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stop_token>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+namespace framework {
+
+    using timer_id = std::uint64_t;
+
+    // Timer queue driven by a single wakeup source.
+    // On Linux the queue arms one timerfd registered with an epoll instance; the epoll fd is
+    // exposed through native_handle() so the queue can be multiplexed into an existing reactor
+    // (mode::external: poll the fd for readability, then call dispatch()).
+    // Elsewhere the owning thread sleeps on a condition variable.
+    //
+    // Every timer carries a slack: it may fire up to `slack` after its deadline, never before.
+    // The armed wakeup is the earliest deadline + slack among the timers that would be due by
+    // then, so timers with overlapping windows are coalesced into a single wakeup.
+    class timer_service {
+    public:
+        using clock = std::chrono::steady_clock;
+        using callback = std::function<void()>;
+
+        enum class mode { own_thread, external };
+
+        explicit timer_service(mode m = mode::own_thread) {
+#ifdef __linux__
+            timer_fd_ = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+            if (timer_fd_ < 0 || wake_fd_ < 0 || epoll_fd_ < 0) {
+                int err = errno;
+                close_fds();
+                throw std::system_error(err, std::system_category(), "timer_service: fd creation failed");
+            }
+            for (int fd : { timer_fd_, wake_fd_ }) {
+                epoll_event ev{};
+                ev.events = EPOLLIN;
+                ev.data.fd = fd;
+                if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+                    int err = errno;
+                    close_fds();
+                    throw std::system_error(err, std::system_category(), "timer_service: epoll_ctl failed");
+                }
+            }
+#endif
+            if (m == mode::own_thread) {
+                thread_ = std::jthread([this](std::stop_token st) { run(st); });
+            }
+        }
+
+        ~timer_service() {
+            stop();
+#ifdef __linux__
+            close_fds();
+#endif
+        }
+
+        timer_service(const timer_service&) = delete;
+        timer_service& operator=(const timer_service&) = delete;
+
+        // Process-wide service with its own thread, for utilities that should not spawn threads
+        static timer_service& shared() {
+            static timer_service instance;
+            return instance;
+        }
+
+        // Ids start at 1; once stop() has been called the timer is dropped and 0 is returned,
+        // so callbacks that re-arm themselves during shutdown need no special case
+        timer_id schedule_at(clock::time_point deadline, callback cb, clock::duration slack = clock::duration::zero()) {
+            std::scoped_lock lock(mutex_);
+            if (stopping_) return 0;
+            timer_id id = next_id_++;
+            slack = std::max(slack, clock::duration::zero());
+            queue_.emplace(key{ deadline, id }, entry{ slack, std::move(cb) });
+            index_.emplace(id, deadline);
+
+            auto latest = saturating_add(deadline, slack);
+            if (latest < armed_) arm_locked(latest);
+            return id;
+        }
+
+        timer_id schedule_after(clock::duration delay, callback cb, clock::duration slack = clock::duration::zero()) {
+            return schedule_at(clock::now() + delay, std::move(cb), slack);
+        }
+
+        // Returns false when the timer already fired or was cancelled
+        bool cancel(timer_id id) {
+            std::scoped_lock lock(mutex_);
+            auto it = index_.find(id);
+            if (it == index_.end()) return false;
+            queue_.erase(key{ it->second, id });
+            index_.erase(it);
+            // The armed wakeup is left alone; an early wakeup simply finds nothing due.
+            return true;
+        }
+
+        // Fire every timer whose deadline has passed and re-arm. Callbacks run on the caller's
+        // thread without the queue lock held, so they may schedule or cancel timers. An
+        // exception escaping a callback is counted in failures() and the batch goes on.
+        std::size_t dispatch() {
+#ifdef __linux__
+            std::uint64_t ticks;
+            while (::read(timer_fd_, &ticks, sizeof(ticks)) > 0) {}
+#endif
+            std::vector<callback> due;
+            {
+                std::scoped_lock lock(mutex_);
+                auto now = clock::now();
+                while (!queue_.empty() && queue_.begin()->first.deadline <= now) {
+                    auto node = queue_.extract(queue_.begin());
+                    index_.erase(node.key().id);
+                    due.push_back(std::move(node.mapped().cb));
+                }
+                armed_ = clock::time_point::max();
+                arm_locked(next_wakeup_locked());
+            }
+            for (auto& cb : due) {
+                try {
+                    cb();
+                }
+                catch (...) {
+                    failures_.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            return due.size();
+        }
+
+        // Callbacks that exited by throwing
+        std::uint64_t failures() const noexcept { return failures_.load(std::memory_order_relaxed); }
+
+        // Wakeup the queue is currently armed for (time_point::max() when idle)
+        clock::time_point next_wakeup() const {
+            std::scoped_lock lock(mutex_);
+            return next_wakeup_locked();
+        }
+
+        std::size_t pending() const {
+            std::scoped_lock lock(mutex_);
+            return queue_.size();
+        }
+
+        // Pollable descriptor that becomes readable when timers are due; -1 where unsupported
+        int native_handle() const noexcept {
+#ifdef __linux__
+            return epoll_fd_;
+#else
+            return -1;
+#endif
+        }
+
+        // Stop the owning thread and drop every pending timer
+        void stop() {
+            {
+                std::scoped_lock lock(mutex_);
+                stopping_ = true;
+                queue_.clear();
+                index_.clear();
+            }
+            thread_.request_stop();
+            wake();
+            if (thread_.joinable() && thread_.get_id() != std::this_thread::get_id()) thread_.join();
+        }
+
+    private:
+        struct key {
+            clock::time_point deadline;
+            timer_id id;
+            auto operator<=>(const key&) const = default;
+        };
+
+        struct entry {
+            clock::duration slack;
+            callback cb;
+        };
+
+        static clock::time_point saturating_add(clock::time_point tp, clock::duration d) {
+            return tp > clock::time_point::max() - d ? clock::time_point::max() : tp + d;
+        }
+
+        // Earliest deadline + slack over the timers that are due by that point; O(timers fired)
+        clock::time_point next_wakeup_locked() const {
+            auto wake_at = clock::time_point::max();
+            for (const auto& [k, e] : queue_) {
+                if (k.deadline > wake_at) break;
+                wake_at = std::min(wake_at, saturating_add(k.deadline, e.slack));
+            }
+            return wake_at;
+        }
+
+        void arm_locked(clock::time_point at) {
+            armed_ = at;
+#ifdef __linux__
+            itimerspec spec{};
+            if (at != clock::time_point::max()) {
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(at.time_since_epoch()).count();
+                if (ns <= 0) ns = 1; // a zero it_value would disarm the timer
+                spec.it_value.tv_sec = static_cast<time_t>(ns / 1'000'000'000);
+                spec.it_value.tv_nsec = static_cast<long>(ns % 1'000'000'000);
+            }
+            ::timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+#else
+            cv_.notify_one();
+#endif
+        }
+
+        void wake() {
+#ifdef __linux__
+            std::uint64_t one = 1;
+            [[maybe_unused]] auto n = ::write(wake_fd_, &one, sizeof(one));
+#else
+            cv_.notify_one();
+#endif
+        }
+
+        void run(std::stop_token st) {
+#ifdef __linux__
+            epoll_event events[2];
+            while (!st.stop_requested()) {
+                int n = ::epoll_wait(epoll_fd_, events, 2, -1);
+                if (n < 0) {
+                    if (errno == EINTR) continue;
+                    break;
+                }
+                for (int i = 0; i < n; ++i) {
+                    if (events[i].data.fd == wake_fd_) {
+                        std::uint64_t count;
+                        [[maybe_unused]] auto r = ::read(wake_fd_, &count, sizeof(count));
+                    }
+                }
+                if (!st.stop_requested()) dispatch();
+            }
+#else
+            std::unique_lock lock(mutex_);
+            while (!st.stop_requested() && !stopping_) {
+                auto wake_at = armed_;
+                if (wake_at == clock::time_point::max()) cv_.wait(lock);
+                else cv_.wait_until(lock, wake_at);
+                if (st.stop_requested() || stopping_ || clock::now() < armed_) continue;
+                lock.unlock();
+                dispatch();
+                lock.lock();
+            }
+#endif
+        }
+
+#ifdef __linux__
+        void close_fds() {
+            for (int* fd : { &epoll_fd_, &timer_fd_, &wake_fd_ }) {
+                if (*fd >= 0) ::close(*fd);
+                *fd = -1;
+            }
+        }
+
+        int timer_fd_ = -1;
+        int wake_fd_ = -1;
+        int epoll_fd_ = -1;
+#else
+        std::condition_variable cv_;
+#endif
+
+        std::map<key, entry> queue_;
+        std::unordered_map<timer_id, clock::time_point> index_;
+        mutable std::mutex mutex_;
+        timer_id next_id_ = 1;
+        clock::time_point armed_ = clock::time_point::max();
+        bool stopping_ = false;
+        std::atomic<std::uint64_t> failures_{ 0 };
+        std::jthread thread_;
+    };
+
+} // namespace framework
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "data_frame.hpp"
+#include "group_by.hpp"
+#include "key_columns.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace framework {
+
+    namespace detail {
+        inline std::int64_t ticks(std::int64_t v) { return v; }
+        inline std::int64_t ticks(timestamp v) { return v.time_since_epoch().count(); }
+
+        // Calls f with the values of a time column (timestamp or int64) once it is known to
+        // have no nulls and to be sorted ascending
+        template<typename F>
+        void visit_time_column(const data_frame& df, const std::string& name, const char* op, F&& f) {
+            const IColumn& col = df.column_at(df.column_position(name));
+            if (col.type() != data_type::timestamp && col.type() != data_type::int64)
+                throw std::runtime_error(std::string(op) + " needs a timestamp or int64 column: " + name);
+            if (kernels::count_valid(col.validity(), col.size()) != col.size())
+                throw std::runtime_error(std::string(op) + " column has nulls: " + name);
+            visit_column(col, [&](const auto& typed) {
+                using T = typename std::decay_t<decltype(typed)>::value_type;
+                if constexpr (std::is_same_v<T, std::int64_t> || std::is_same_v<T, timestamp>) {
+                    auto values = typed.values();
+                    for (size_t i = 1; i < values.size(); ++i)
+                        if (values[i] < values[i - 1]) throw std::runtime_error(std::string(op) + " needs " + name + " sorted ascending");
+                    f(values);
+                }
+            });
+        }
+
+        // Start of the interval holding t, intervals counted from 0 (the epoch)
+        inline std::int64_t bucket_start(std::int64_t t, std::int64_t interval) {
+            std::int64_t q = t / interval;
+            if (t % interval < 0) --q;
+            return q * interval;
+        }
+    }
+
+    // Result of data_frame::resample(); agg() runs the aggregation
+    class resampled_frame {
+        data_frame source_;
+        std::string column_;
+        std::chrono::nanoseconds interval_;
+        std::vector<std::string> keys_;
+
+    public:
+        resampled_frame(data_frame source, std::string column, std::chrono::nanoseconds interval, std::vector<std::string> keys)
+            : source_(std::move(source)), column_(std::move(column)), interval_(interval), keys_(std::move(keys)) {
+            if (interval_.count() <= 0) throw std::runtime_error("resample interval must be positive");
+            source_.column_position(column_);
+            for (const auto& k : keys_) source_.column_position(k);
+        }
+
+        // One row per non-empty bucket, or per bucket and key: the bucket start (under the
+        // time column's name), the keys, then one column per aggregate. Rows come in time
+        // order, keys within a bucket in order of first appearance. Bucket edges are found
+        // in one pass over the sorted times; keys are hashed into a table that is cleared
+        // at every edge, so it only ever holds one bucket's groups.
+        data_frame agg(const std::vector<aggregate>& specs) const {
+            const size_t rows = source_.rowCount();
+            const std::int64_t step = interval_.count();
+            std::optional<detail::key_columns> keys;
+            std::optional<detail::group_table> table;
+            if (!keys_.empty()) {
+                keys.emplace(source_, keys_);
+                table.emplace(*keys);
+            }
+            std::vector<std::unique_ptr<detail::group_accumulator>> accumulators;
+            for (const auto& spec : specs) accumulators.push_back(detail::make_accumulator(spec, source_));
+
+            std::vector<std::int64_t> starts; // per group
+            std::vector<size_t> first_rows;
+            std::shared_ptr<IColumn> bucket_column;
+            detail::visit_time_column(source_, column_, "resample", [&](auto times) {
+                using T = typename decltype(times)::value_type;
+                constexpr size_t batch = 1024;
+                std::uint64_t hashes[batch];
+                std::uint32_t groups[batch];
+                std::int64_t start = 0, end = 0;
+                size_t base = 0; // first group of the current bucket
+                for (size_t b = 0; b < rows; b += batch) {
+                    size_t n = std::min(batch, rows - b);
+                    if (keys) keys->hash(b, n, hashes);
+                    for (size_t i = 0; i < n; ++i) {
+                        std::int64_t t = detail::ticks(times[b + i]);
+                        if (b + i == 0 || t >= end) {
+                            start = detail::bucket_start(t, step);
+                            end = start > std::numeric_limits<std::int64_t>::max() - step ? std::numeric_limits<std::int64_t>::max() : start + step;
+                            base = first_rows.size();
+                            if (table) table->clear();
+                        }
+                        size_t g = table ? base + table->insert(hashes[i], b + i) : base;
+                        if (g == first_rows.size()) {
+                            if (g >= std::numeric_limits<std::uint32_t>::max()) throw std::runtime_error("Too many groups");
+                            starts.push_back(start);
+                            first_rows.push_back(b + i);
+                        }
+                        groups[i] = static_cast<std::uint32_t>(g);
+                    }
+                    for (auto& acc : accumulators) acc->update(b, std::span<const std::uint32_t>(groups, n), first_rows.size());
+                }
+
+                auto col = std::make_shared<data_column<T>>(column_);
+                col->data.reserve(starts.size());
+                for (std::int64_t s : starts) {
+                    if constexpr (std::is_same_v<T, timestamp>) col->data.push_back(timestamp(std::chrono::nanoseconds(s)));
+                    else col->data.push_back(s);
+                }
+                bucket_column = col;
+            });
+
+            data_frame out;
+            out.add_column(column_, bucket_column);
+            for (const auto& k : keys_)
+                out.add_column(k, source_.column_at(source_.column_position(k)).gather(first_rows));
+            for (size_t a = 0; a < specs.size(); ++a) {
+                auto name = specs[a].output_name();
+                out.add_column(name, accumulators[a]->finish(name));
+            }
+            return out;
+        }
+    };
+
+    inline resampled_frame data_frame::resample(const std::string& column, std::chrono::nanoseconds interval, std::vector<std::string> keys) const {
+        return resampled_frame(*this, column, interval, std::move(keys));
+    }
+
+    // Backward as-of join: every left row, in order, with the right columns of the last right
+    // row whose time is <= its own (null when there is none, or when it lies more than
+    // tolerance back; for int64 columns tolerance counts in the column's own units). Both
+    // frames must be sorted on `on`, which is then swept once with two cursors; with by keys
+    // the sweep keeps the last right row per key. Right `on` and by columns are not repeated.
+    inline data_frame data_frame::join_asof(const data_frame& right, const std::string& on, const std::vector<std::string>& by,
+        std::optional<std::chrono::nanoseconds> tolerance) const {
+        if (column_at(column_position(on)).type() != right.column_at(right.column_position(on)).type())
+            throw std::runtime_error("join_asof column type mismatch: " + on);
+        const size_t nl = rowCount(), nr = right.rowCount();
+
+        // Right rows numbered by key group, left rows by the right group with an equal key
+        std::vector<std::uint32_t> right_group, left_group;
+        size_t groups = 1;
+        if (!by.empty()) {
+            detail::key_columns rk(right, by), lk(*this, by, &rk);
+            if (!lk.compatible(rk)) throw std::runtime_error("Join key type mismatch");
+            std::vector<std::uint64_t> rh(nr), lh(nl);
+            rk.hash(0, nr, rh.data());
+            lk.hash(0, nl, lh.data());
+            detail::group_table table(rk);
+            right_group.resize(nr);
+            for (size_t r = 0; r < nr; ++r) right_group[r] = table.insert(rh[r], r);
+            left_group.resize(nl);
+            for (size_t l = 0; l < nl; ++l) left_group[l] = table.find(lh[l], lk, l);
+            groups = table.size();
+        }
+
+        std::vector<size_t> match(nl, no_row);
+        detail::visit_time_column(*this, on, "join_asof", [&](auto left_times) {
+            detail::visit_time_column(right, on, "join_asof", [&](auto right_times) {
+                std::vector<size_t> last(groups, no_row);
+                size_t j = 0;
+                for (size_t i = 0; i < nl; ++i) {
+                    std::int64_t t = detail::ticks(left_times[i]);
+                    for (; j < nr && detail::ticks(right_times[j]) <= t; ++j) last[by.empty() ? 0 : right_group[j]] = j;
+                    std::uint32_t g = by.empty() ? 0 : left_group[i];
+                    if (g == detail::group_table::no_group || last[g] == no_row) continue;
+                    if (tolerance && t - detail::ticks(right_times[last[g]]) > tolerance->count()) continue;
+                    match[i] = last[g];
+                }
+            });
+        });
+
+        data_frame out;
+        auto left_names = column_names();
+        for (size_t c = 0; c < left_names.size(); ++c) out.add_column(left_names[c], columns_[c]);
+        auto right_names = right.column_names();
+        for (size_t c = 0; c < right_names.size(); ++c) {
+            if (right_names[c] == on || std::find(by.begin(), by.end(), right_names[c]) != by.end()) continue;
+            auto name = out.has_column(right_names[c]) ? right_names[c] + "_right" : right_names[c];
+            out.add_column(name, right.column_at(c).gather(match));
+        }
+        return out;
+    }
+
+} // namespace framework
@@ -0,0 +1,371 @@
+#pragma once
+
+#include "data_frame.hpp"
+#include "group_by.hpp"
+#include "key_columns.hpp"
+#include "sort.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace framework {
+
+    enum class window_kind { rolling_sum, rolling_mean, rolling_var, rolling_std, rolling_min, rolling_max, ewm_mean, cumsum, lag, lead };
+
+    // One output column of windowed_frame::apply(): rolling_mean("px", 20), lag("px", 1), ...
+    struct window_fn {
+        window_kind kind;
+        std::string column;
+        size_t size = 0;        // rows in a rolling window; the offset of lag/lead
+        size_t min_periods = 0; // valid values a rolling window needs for a result (0: size)
+        double alpha = 0;       // ewm_mean smoothing factor in (0, 1]
+        std::string alias;
+
+        // Rename the output column (default "<column>_<kind>", with the size for rolling and lag/lead)
+        window_fn as(std::string name) const {
+            window_fn out = *this;
+            out.alias = std::move(name);
+            return out;
+        }
+
+        std::string output_name() const {
+            if (!alias.empty()) return alias;
+            static constexpr const char* names[] = { "rolling_sum", "rolling_mean", "rolling_var", "rolling_std",
+                "rolling_min", "rolling_max", "ewm_mean", "cumsum", "lag", "lead" };
+            std::string out = column + "_" + names[static_cast<int>(kind)];
+            if (kind != window_kind::ewm_mean && kind != window_kind::cumsum) out += std::to_string(size);
+            return out;
+        }
+    };
+
+    inline window_fn rolling_sum(std::string column, size_t n, size_t min_periods = 0) { return { window_kind::rolling_sum, std::move(column), n, min_periods, 0, {} }; }
+    inline window_fn rolling_mean(std::string column, size_t n, size_t min_periods = 0) { return { window_kind::rolling_mean, std::move(column), n, min_periods, 0, {} }; }
+    // Sample variance / standard deviation (ddof 1)
+    inline window_fn rolling_var(std::string column, size_t n, size_t min_periods = 0) { return { window_kind::rolling_var, std::move(column), n, min_periods, 0, {} }; }
+    inline window_fn rolling_std(std::string column, size_t n, size_t min_periods = 0) { return { window_kind::rolling_std, std::move(column), n, min_periods, 0, {} }; }
+    inline window_fn rolling_min(std::string column, size_t n, size_t min_periods = 0) { return { window_kind::rolling_min, std::move(column), n, min_periods, 0, {} }; }
+    inline window_fn rolling_max(std::string column, size_t n, size_t min_periods = 0) { return { window_kind::rolling_max, std::move(column), n, min_periods, 0, {} }; }
+    // y = alpha * x + (1 - alpha) * y_prev, starting at the first valid value
+    inline window_fn ewm_mean(std::string column, double alpha) { return { window_kind::ewm_mean, std::move(column), 0, 0, alpha, {} }; }
+    inline window_fn cumsum(std::string column) { return { window_kind::cumsum, std::move(column), 0, 0, 0, {} }; }
+    // Value k rows back / ahead in the partition, of any column type
+    inline window_fn lag(std::string column, size_t k = 1) { return { window_kind::lag, std::move(column), k, 0, 0, {} }; }
+    inline window_fn lead(std::string column, size_t k = 1) { return { window_kind::lead, std::move(column), k, 0, 0, {} }; }
+
+    namespace detail {
+        // Neumaier-compensated running sum; adding -x removes x again without drift
+        struct compensated_sum {
+            double sum = 0, c = 0;
+            void add(double x) {
+                double t = sum + x;
+                c += std::abs(sum) >= std::abs(x) ? (sum - t) + x : (x - t) + sum;
+                sum = t;
+            }
+            double value() const { return sum + c; }
+            void reset() { sum = c = 0; }
+        };
+
+        // NaN and infinite values in a window, kept out of the running sums and moments: adding
+        // -inf cannot take +inf back out, and a NaN would poison every later window
+        struct non_finite_count {
+            size_t nan = 0, pos = 0, neg = 0;
+
+            // Counts x in (step 1) or out (step -1) of the window; false when x is finite
+            bool update(double x, int step) {
+                if (std::isfinite(x)) return false;
+                size_t& n = x != x ? nan : x > 0 ? pos : neg;
+                n += step;
+                return true;
+            }
+            bool any() const { return nan || pos || neg; }
+            // The sum of the window's values once any() holds
+            double sum() const {
+                if (nan || (pos && neg)) return std::numeric_limits<double>::quiet_NaN();
+                return pos ? std::numeric_limits<double>::infinity() : -std::numeric_limits<double>::infinity();
+            }
+        };
+
+        // Where the results of one numeric window function go; valid is one byte per row so
+        // that partitions can be written from several threads
+        struct window_output {
+            double* values;
+            std::uint8_t* valid;
+        };
+
+        // Runs fn over the rows of one partition, rows(i) being its i-th row of n in order.
+        // Every kind is a single forward pass: sums and moments are updated by the value
+        // entering and the one leaving the window, min/max keep a monotonic deque.
+        template<typename T, typename Rows>
+        void window_pass(const window_fn& fn, std::span<const T> x, const std::uint64_t* validity, Rows rows, size_t n, window_output out) {
+            auto valid = [&](size_t r) { return !validity || ((validity[r / 64] >> (r % 64)) & 1); };
+            auto emit = [&](size_t r, bool ok, double v) {
+                out.valid[r] = ok;
+                out.values[r] = ok ? v : 0.0;
+            };
+            const size_t w = fn.size;
+            const size_t need = std::max<size_t>(fn.min_periods ? fn.min_periods : w, 1);
+
+            switch (fn.kind) {
+            case window_kind::rolling_sum:
+            case window_kind::rolling_mean: {
+                compensated_sum s;
+                non_finite_count special;
+                size_t count = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    size_t r = rows(i);
+                    if (valid(r)) {
+                        double v = static_cast<double>(x[r]);
+                        if (!special.update(v, 1)) s.add(v);
+                        ++count;
+                    }
+                    if (i >= w) {
+                        size_t old = rows(i - w);
+                        if (valid(old)) {
+                            double v = static_cast<double>(x[old]);
+                            if (!special.update(v, -1)) s.add(-v);
+                            --count;
+                        }
+                        if (count == 0) s.reset();
+                    }
+                    double sum = special.any() ? special.sum() : s.value();
+                    double v = fn.kind == window_kind::rolling_sum ? sum : sum / static_cast<double>(count);
+                    emit(r, count >= need, v);
+                }
+                break;
+            }
+            case window_kind::rolling_var:
+            case window_kind::rolling_std: {
+                // Welford's update run forwards for the entering value and backwards for the
+                // leaving one, over the finite values; any other value makes the window NaN
+                double mean = 0, m2 = 0;
+                non_finite_count special;
+                size_t count = 0, finite = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    size_t r = rows(i);
+                    if (valid(r)) {
+                        double v = static_cast<double>(x[r]);
+                        ++count;
+                        if (!special.update(v, 1)) {
+                            double d = v - mean;
+                            mean += d / static_cast<double>(++finite);
+                            m2 += d * (v - mean);
+                        }
+                    }
+                    if (i >= w) {
+                        size_t old = rows(i - w);
+                        if (valid(old)) {
+                            double v = static_cast<double>(x[old]);
+                            --count;
+                            if (!special.update(v, -1)) {
+                                if (--finite == 0) { mean = m2 = 0; }
+                                else {
+                                    double d = v - mean;
+                                    mean -= d / static_cast<double>(finite);
+                                    m2 -= d * (v - mean);
+                                }
+                            }
+                        }
+                    }
+                    double var = special.any() ? std::numeric_limits<double>::quiet_NaN()
+                        : count > 1 ? std::max(m2, 0.0) / static_cast<double>(count - 1) : 0.0;
+                    emit(r, count >= need && count > 1, fn.kind == window_kind::rolling_std ? std::sqrt(var) : var);
+                }
+                break;
+            }
+            case window_kind::rolling_min:
+            case window_kind::rolling_max: {
+                // Positions whose values are strictly monotonic from the front (the extreme)
+                std::deque<size_t> q;
+                const bool is_max = fn.kind == window_kind::rolling_max;
+                auto beats = [&](T a, T b) { return is_max ? a >= b : a <= b; };
+                size_t count = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    size_t r = rows(i);
+                    if (valid(r)) {
+                        while (!q.empty() && beats(x[r], x[rows(q.back())])) q.pop_back();
+                        q.push_back(i);
+                        ++count;
+                    }
+                    if (i >= w) {
+                        if (valid(rows(i - w))) --count;
+                        if (!q.empty() && q.front() == i - w) q.pop_front();
+                    }
+                    emit(r, count >= need && !q.empty(), q.empty() ? 0.0 : static_cast<double>(x[rows(q.front())]));
+                }
+                break;
+            }
+            case window_kind::ewm_mean: {
+                double y = 0;
+                bool started = false;
+                for (size_t i = 0; i < n; ++i) {
+                    size_t r = rows(i);
+                    if (!valid(r)) { emit(r, false, 0); continue; }
+                    double v = static_cast<double>(x[r]);
+                    y = started ? y + fn.alpha * (v - y) : v;
+                    started = true;
+                    emit(r, true, y);
+                }
+                break;
+            }
+            case window_kind::cumsum: {
+                compensated_sum s;
+                for (size_t i = 0; i < n; ++i) {
+                    size_t r = rows(i);
+                    bool ok = valid(r);
+                    if (ok) s.add(static_cast<double>(x[r]));
+                    emit(r, ok, s.value());
+                }
+                break;
+            }
+            case window_kind::lag:
+            case window_kind::lead:
+                break;
+            }
+        }
+
+        // lag/lead as gather indices: rows[i] takes the row k before / after it
+        template<typename Rows>
+        void shift_pass(const window_fn& fn, Rows rows, size_t n, size_t* from) {
+            const size_t k = fn.size;
+            for (size_t i = 0; i < n; ++i) {
+                if (fn.kind == window_kind::lag) from[rows(i)] = i >= k ? rows(i - k) : no_row;
+                else from[rows(i)] = k < n - i ? rows(i + k) : no_row;
+            }
+        }
+    }
+
+    // Result of data_frame::window(); apply() computes window functions over each partition
+    // (rows with equal keys, in row order; the whole frame without keys). The output is the
+    // source's columns (shared) plus one column per function: float64 for the numeric
+    // functions, which skip nulls and give null where a window holds too few values, and
+    // the source column's type for lag/lead, null past either end of the partition.
+    class windowed_frame {
+        data_frame source_;
+        std::vector<std::string> keys_;
+
+    public:
+        // Below this many rows per worker the serial path is faster than splitting
+        static constexpr size_t min_rows_per_task = 1 << 16;
+
+        windowed_frame(data_frame source, std::vector<std::string> keys)
+            : source_(std::move(source)), keys_(std::move(keys)) {
+            for (const auto& k : keys_) source_.column_position(k);
+        }
+
+        // With a pool, partitions are spread over its workers, each computing every function
+        // for its partitions. Must not be called from one of the pool's own workers.
+        data_frame apply(const std::vector<window_fn>& specs, thread_pool* pool = nullptr) const {
+            const size_t rows = source_.rowCount();
+            for (const auto& fn : specs) {
+                const IColumn& col = source_.column_at(source_.column_position(fn.column));
+                bool shift = fn.kind == window_kind::lag || fn.kind == window_kind::lead;
+                bool numeric = col.type() == data_type::int32 || col.type() == data_type::float64 || col.type() == data_type::int64;
+                if (!shift && !numeric) throw std::runtime_error("Window function needs a numeric column: " + fn.column);
+                if (!shift && fn.kind != window_kind::ewm_mean && fn.kind != window_kind::cumsum && fn.size == 0)
+                    throw std::runtime_error("Rolling window size must be positive");
+                if (fn.kind == window_kind::ewm_mean && !(fn.alpha > 0 && fn.alpha <= 1))
+                    throw std::runtime_error("ewm_mean alpha must be in (0, 1]");
+            }
+
+            // Partition rows: a stable counting sort by group, so each partition is in row order
+            std::vector<size_t> order, offsets{ 0, rows };
+            if (!keys_.empty()) {
+                detail::key_columns keys(source_, keys_);
+                detail::group_table table(keys);
+                std::vector<std::uint32_t> group(rows);
+                constexpr size_t batch = 1024;
+                std::uint64_t hashes[batch];
+                for (size_t b = 0; b < rows; b += batch) {
+                    size_t n = std::min(batch, rows - b);
+                    keys.hash(b, n, hashes);
+                    for (size_t i = 0; i < n; ++i) group[b + i] = table.insert(hashes[i], b + i);
+                }
+                offsets.assign(table.size() + 1, 0);
+                for (auto g : group) ++offsets[g + 1];
+                std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+                std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+                order.resize(rows);
+                for (size_t r = 0; r < rows; ++r) order[cursor[group[r]]++] = r;
+            }
+            const size_t partitions = offsets.size() - 1;
+
+            std::vector<std::vector<double>> values(specs.size());
+            std::vector<std::vector<std::uint8_t>> valid(specs.size());
+            std::vector<std::vector<size_t>> from(specs.size());
+            for (size_t s = 0; s < specs.size(); ++s) {
+                if (specs[s].kind == window_kind::lag || specs[s].kind == window_kind::lead) from[s].resize(rows);
+                else {
+                    values[s].resize(rows);
+                    valid[s].resize(rows);
+                }
+            }
+
+            auto run_partition = [&](size_t p) {
+                const size_t begin = offsets[p], n = offsets[p + 1] - begin;
+                for (size_t s = 0; s < specs.size(); ++s) {
+                    const auto& fn = specs[s];
+                    auto each = [&](auto rows_of) {
+                        if (fn.kind == window_kind::lag || fn.kind == window_kind::lead) {
+                            detail::shift_pass(fn, rows_of, n, from[s].data());
+                            return;
+                        }
+                        const IColumn& col = source_.column_at(source_.column_position(fn.column));
+                        visit_column(col, [&](const auto& typed) {
+                            using T = typename std::decay_t<decltype(typed)>::value_type;
+                            if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>)
+                                detail::window_pass<T>(fn, typed.values(), col.validity(), rows_of, n,
+                                    detail::window_output{ values[s].data(), valid[s].data() });
+                        });
+                    };
+                    if (order.empty()) each([begin](size_t i) { return begin + i; });
+                    else each([at = order.data() + begin](size_t i) { return at[i]; });
+                }
+            };
+
+            size_t tasks = pool && partitions > 1 ? std::clamp<size_t>(rows / min_rows_per_task, 1, pool->size()) : 1;
+            if (tasks < 2) {
+                for (size_t p = 0; p < partitions; ++p) run_partition(p);
+            }
+            else {
+                // Contiguous runs of partitions holding about rows / tasks rows each
+                std::vector<size_t> first(tasks + 1, partitions);
+                first[0] = 0;
+                for (size_t p = 0, t = 1; p < partitions && t < tasks; ++p)
+                    while (t < tasks && offsets[p] >= rows * t / tasks) first[t++] = p;
+                detail::run_tasks(pool, tasks, [&](size_t t) {
+                    for (size_t p = first[t]; p < first[t + 1]; ++p) run_partition(p);
+                });
+            }
+
+            data_frame out = source_;
+            for (size_t s = 0; s < specs.size(); ++s) {
+                auto name = specs[s].output_name();
+                if (!from[s].empty()) {
+                    out.add_column(name, source_.column_at(source_.column_position(specs[s].column)).gather(from[s]));
+                    continue;
+                }
+                auto col = std::make_shared<data_column<double>>(name);
+                col->data = std::move(values[s]);
+                for (size_t r = 0; r < rows; ++r)
+                    if (!valid[s][r]) col->set_null(r);
+                out.add_column(name, col);
+            }
+            return out;
+        }
+    };
+
+    inline windowed_frame data_frame::window(std::vector<std::string> partition_by) const {
+        return windowed_frame(*this, std::move(partition_by));
+    }
+
+} // namespace framework